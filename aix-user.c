@@ -4,25 +4,91 @@
  * Made by Theldus, 2025
  */
 
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <unicorn/unicorn.h>
 
+#include "bbcount.h"
+#include "flightrec.h"
 #include "gdb.h"
 #include "loader.h"
+#include "ltrace.h"
 #include "mm.h"
+#include "overhead.h"
+#include "profile.h"
+#include "record.h"
+#include "stats.h"
+#include "timeline.h"
 #include "unix.h"
 #include "insn_emu.h"
 
 /* Command-line arguments. */
 struct args args = {
-	.lib_path      = ".",
-	.trace_syscall = 0,
-	.trace_loader  = 0,
-	.gdb_port      = 1234,
-	.enable_gdb    = 0,
+	.lib_path         = ".",
+	.trace_syscall    = 0,
+	.trace_loader     = 0,
+	.syscall_stats    = 0,
+	.gdb_port         = 1234,
+	.enable_gdb       = 0,
+	.gdb_attach       = 0,
+	.stats            = 0,
+	.stats_json       = NULL,
+	.trace_out        = NULL,
+	.profile          = NULL,
+	.profile_hz       = PROFILE_DEFAULT_HZ,
+	.bbcount          = NULL,
+	.ltrace           = 0,
+	.ltrace_log       = NULL,
+	.heap_profile     = NULL,
+	.overhead         = 0,
+	.overhead_json    = NULL,
+	.no_flightrec     = 0,
+	.flightrec_blocks = 0,
+	.record           = NULL,
+	.replay           = NULL,
+	.insn_stats       = 0,
+};
+
+/* Long-only options. */
+#define OPT_STATS      256
+#define OPT_STATS_JSON 257
+#define OPT_TRACE_OUT  258
+#define OPT_PROFILE    259
+#define OPT_PROFILE_HZ 260
+#define OPT_BBCOUNT    261
+#define OPT_LTRACE     262
+#define OPT_LTRACE_LOG 263
+#define OPT_HEAP_PROF  264
+#define OPT_OVERHEAD   265
+#define OPT_OVH_JSON   266
+#define OPT_NO_FLIGHT  267
+#define OPT_RECORD     268
+#define OPT_REPLAY     269
+#define OPT_FR_BLOCKS  270
+#define OPT_INSN_STATS 271
+
+static const struct option long_options[] = {
+	{"stats",            no_argument,       NULL, OPT_STATS},
+	{"stats-json",       required_argument, NULL, OPT_STATS_JSON},
+	{"trace-out",        required_argument, NULL, OPT_TRACE_OUT},
+	{"profile",          required_argument, NULL, OPT_PROFILE},
+	{"profile-hz",       required_argument, NULL, OPT_PROFILE_HZ},
+	{"bbcount",          required_argument, NULL, OPT_BBCOUNT},
+	{"ltrace",           no_argument,       NULL, OPT_LTRACE},
+	{"ltrace-log",       required_argument, NULL, OPT_LTRACE_LOG},
+	{"heap-profile",     required_argument, NULL, OPT_HEAP_PROF},
+	{"overhead",         no_argument,       NULL, OPT_OVERHEAD},
+	{"overhead-json",    required_argument, NULL, OPT_OVH_JSON},
+	{"no-flightrec",     no_argument,       NULL, OPT_NO_FLIGHT},
+	{"flightrec-blocks", no_argument,       NULL, OPT_FR_BLOCKS},
+	{"record",           required_argument, NULL, OPT_RECORD},
+	{"replay",           required_argument, NULL, OPT_REPLAY},
+	{"insn-stats",       no_argument,       NULL, OPT_INSN_STATS},
+	{"help",             no_argument,       NULL, 'h'},
+	{NULL,               0,                 NULL, 0}
 };
 
 /* XCOFF file info. */
@@ -41,16 +107,71 @@ static void usage(const char *prgname)
 	fprintf(stderr, "Usage: %s [options] program [arguments...]\n", prgname);
 	fprintf(stderr,
 		"Options:\n"
-		"  -L <path> Set library search path (default: current directory)\n"
+		"  -L <path> Set library search path, colon-separated (default:\n"
+		"            current directory), searched before LIBPATH and\n"
+		"            the paths embedded in the binary\n"
 		"  -s        Enable syscall trace\n"
 		"  -l        Enable loader/binder/milicode/syscall trace\n"
+		"  -c        Count time, calls and errors of each syscall, and\n"
+		"            print a summary at exit (like 'strace -c')\n"
 		"  -d        Enable GDB server\n"
+		"  -a        Enable GDB server, but run immediately: GDB may\n"
+		"            attach (or interrupt with Ctrl+C) at any time\n"
 		"  -g <port> GDB server port (default: 1234)\n"
+		"  -i <file> Symbol index (see aix-symindex), used to locate\n"
+		"            libraries and to diagnose unresolved symbols\n"
+		"  --stats   Print loader statistics (per-module time of each\n"
+		"            loader phase, and counters) at exit\n"
+		"  --stats-json <file>\n"
+		"            Save the loader statistics as JSON into <file>\n"
+		"  --trace-out <file>\n"
+		"            Save a timeline of the loader phases, syscalls,\n"
+		"            emulated instructions and GDB pauses into <file>\n"
+		"            (Chrome trace-event format, open with Perfetto)\n"
+		"  --profile <file>\n"
+		"            Sample the guest stack and save it as folded stacks\n"
+		"            (for flamegraph.pl) into <file>\n"
+		"  --profile-hz <n>\n"
+		"            Sampling rate, 1-%d samples/s (default: %d)\n"
+		"  --bbcount <file>\n"
+		"            Count the executions of each basic block, save the\n"
+		"            coverage (drcov format) into <file>, and print the\n"
+		"            hottest functions and the instruction mix at exit\n"
+		"  --ltrace  Count and time the calls between modules (imported\n"
+		"            functions), and print a summary at exit\n"
+		"  --ltrace-log <file>\n"
+		"            Same as --ltrace, but also log each call and\n"
+		"            return into <file>\n"
+		"  --heap-profile <file>\n"
+		"            Save each brk/sbrk break change (time, size and\n"
+		"            caller) into <file> (CSV), and print the heap\n"
+		"            high-water mark and top growth sites at exit\n"
+		"  --overhead\n"
+		"            Print at exit how the run time (wall and CPU) was\n"
+		"            split between guest code, hooks, host syscalls and\n"
+		"            GDB pauses, and how many times each hook fired\n"
+		"  --overhead-json <file>\n"
+		"            Save the overhead breakdown as JSON into <file>\n"
+		"  --no-flightrec\n"
+		"            Disable the flight recorder (last syscalls and\n"
+		"            loader events, dumped on crashes)\n"
+		"  --flightrec-blocks\n"
+		"            Also record the last executed basic blocks (hooks\n"
+		"            every block, slower)\n"
+		"  --record <file>\n"
+		"            Record every syscall (arguments, data returned,\n"
+		"            errno and return value) into <file>\n"
+		"  --replay <file>\n"
+		"            Serve the syscalls from a --record <file>, without\n"
+		"            touching the host; abort on the first divergence\n"
+		"  --insn-stats\n"
+		"            Print at exit how many times each unsupported\n"
+		"            instruction was emulated\n"
 		"  -h        Show this help\n\n"
 		"Example:\n"
 		"  %s -L /usr/lib ./my_aix_program arg1 arg2\n"
 		"  %s -s -l ./my_aix_program\n",
-		prgname, prgname);
+		PROFILE_MAX_HZ, PROFILE_DEFAULT_HZ, prgname, prgname);
 	exit(EXIT_FAILURE);
 }
 
@@ -70,7 +191,8 @@ static void parse_args(int *argc, char ***argv)
 	char **orig_argv = *argv;
 
 	/* Parse options. */
-	while ((c = getopt(*argc, *argv, "hL:slg:d")) != -1)
+	while ((c = getopt_long(*argc, *argv, "hL:slcg:dai:", long_options,
+		NULL)) != -1)
 	{
 		switch (c) {
 		case 'h':
@@ -85,6 +207,9 @@ static void parse_args(int *argc, char ***argv)
 		case 'l':
 			args.trace_loader = 1;
 			break;
+		case 'c':
+			args.syscall_stats = 1;
+			break;
 		case 'g':
 			args.gdb_port = atoi(optarg);
 			if (args.gdb_port <= 0 || args.gdb_port > 65535) {
@@ -95,6 +220,65 @@ static void parse_args(int *argc, char ***argv)
 		case 'd':
 			args.enable_gdb = 1;
 			break;
+		case 'a':
+			args.enable_gdb = 1;
+			args.gdb_attach = 1;
+			break;
+		case 'i':
+			args.symindex = optarg;
+			break;
+		case OPT_STATS:
+			args.stats = 1;
+			break;
+		case OPT_STATS_JSON:
+			args.stats_json = optarg;
+			break;
+		case OPT_TRACE_OUT:
+			args.trace_out = optarg;
+			break;
+		case OPT_PROFILE:
+			args.profile = optarg;
+			break;
+		case OPT_PROFILE_HZ:
+			args.profile_hz = atoi(optarg);
+			if (args.profile_hz <= 0 || args.profile_hz > PROFILE_MAX_HZ) {
+				fprintf(stderr, "Invalid sampling rate: %s\n", optarg);
+				usage((*argv)[0]);
+			}
+			break;
+		case OPT_BBCOUNT:
+			args.bbcount = optarg;
+			break;
+		case OPT_LTRACE_LOG:
+			args.ltrace_log = optarg;
+			/* fall through */
+		case OPT_LTRACE:
+			args.ltrace = 1;
+			break;
+		case OPT_HEAP_PROF:
+			args.heap_profile = optarg;
+			break;
+		case OPT_OVERHEAD:
+			args.overhead = 1;
+			break;
+		case OPT_OVH_JSON:
+			args.overhead_json = optarg;
+			break;
+		case OPT_NO_FLIGHT:
+			args.no_flightrec = 1;
+			break;
+		case OPT_FR_BLOCKS:
+			args.flightrec_blocks = 1;
+			break;
+		case OPT_RECORD:
+			args.record = optarg;
+			break;
+		case OPT_REPLAY:
+			args.replay = optarg;
+			break;
+		case OPT_INSN_STATS:
+			args.insn_stats = 1;
+			break;
 		default:
 			usage((*argv)[0]);
 			break;
@@ -118,24 +302,42 @@ static void parse_args(int *argc, char ***argv)
 /* Main =). */
 int main(int argc, char **argv, char **envp)
 {
+	const char **guest_argv;
+	const char **guest_envp;
 	const char *program;
+	int guest_argc;
 	u32 entry_point;
+	u32 pc;
 	uc_hook trace;
 	uc_err err;
+	int resume;
 
 	/* Parse command-line arguments. */
 	parse_args(&argc, &argv);
 	program = argv[0];
+	stats_init(args.stats, args.stats_json);
+	timeline_init(args.trace_out, program);
 
 	/* Initialize our AIX+PPC emulator =). */
 	err = uc_open(UC_ARCH_PPC, UC_MODE_PPC32|UC_MODE_BIG_ENDIAN, &uc);
 	if (err)
 		errx(1, "Unable to create VM: %s\n", uc_strerror(err));
 
+	if (!args.no_flightrec)
+		flightrec_init(uc, args.flightrec_blocks);
+
+	/* On --replay, the guest gets the recorded argv/envp. */
+	guest_argc = argc;
+	guest_argv = (const char **)argv;
+	guest_envp = (const char **)envp;
+	rr_init(args.record, args.replay, &guest_argc, &guest_argv, &guest_envp);
+
 	mm_init(uc);
-	mm_init_stack(argc, (const char **)argv, (const char **)envp);
+	mm_init_stack(guest_argc, guest_argv, guest_envp);
 	unix_init(uc);
 	insn_emu_init(uc);
+	if (args.ltrace)
+		ltrace_init(uc, args.ltrace_log);
 
 	/* Load executable. */
 	lcoff = load_xcoff_file(uc, program, NULL, 1);
@@ -144,19 +346,47 @@ int main(int argc, char **argv, char **envp)
 
 	/* Init GDB stub (if requested). */
 	if (args.enable_gdb) {
-		if (gdb_init(uc, args.gdb_port) < 0)
+		if (gdb_init(uc, args.gdb_port, args.gdb_attach) < 0)
 			errx(1, "Unable to start GDB server!\n");
 	}
 
 	entry_point = xcoff_get_entrypoint(&lcoff->xcoff);
-	err = uc_emu_start(uc, entry_point, (1ULL<<48), 0, 0);
-	if (err) {
-		printf("FAILED with error: %s\n", uc_strerror(err));
-		if (err == UC_ERR_EXCEPTION) {
-			printf("  -> Exception occurred\n");
-			register_dump(uc);
+	pc = entry_point;
+	stats_loaded();
+	profile_init(uc, args.profile, args.profile_hz);
+	bbcount_init(uc, args.bbcount);
+	ltrace_start();
+	overhead_init(args.overhead, args.overhead_json);
+
+	/*
+	 * The program only ends via exit syscall, so if the emulation returns,
+	 * it was stopped on purpose (e.g., GDB interrupt or profiler sample):
+	 * resume from the current PC.
+	 */
+	for (;;) {
+		if (timeline_enabled)
+			timeline_run_begin(pc);
+		OVH_BEGIN(OVH_GUEST);
+		err = uc_emu_start(uc, pc, (1ULL<<48), 0, 0);
+		OVH_END();
+		if (timeline_enabled)
+			timeline_run_end();
+		if (err) {
+			printf("FAILED with error: %s\n", uc_strerror(err));
+			if (err == UC_ERR_EXCEPTION) {
+				printf("  -> Exception occurred\n");
+				register_dump(uc);
+			}
+			return 1;
 		}
-		return 1;
+
+		resume = 0;
+		if (args.enable_gdb && gdb_handle_stop(uc, &pc))
+			resume = 1;
+		if (profile_enabled && profile_handle_stop(uc, &pc))
+			resume = 1;
+		if (!resume)
+			break;
 	}
 	return 0;
 }
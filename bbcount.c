@@ -0,0 +1,452 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bbcount.h"
+#include "loader.h"
+#include "mm.h"
+#include "overhead.h"
+#include "sym.h"
+
+/* Amount of entries shown on the hot lists. */
+#define BB_TOP_FUNCS 25
+#define BB_TOP_OPS   30
+
+/* Executed block. */
+struct bb {
+	u32 addr;
+	u32 size;    /* Block size, in bytes.        */
+	u64 count;   /* Executions, 0 = empty slot.  */
+};
+
+/* Function, on the hot list. */
+struct bb_func {
+	const char *module;
+	const char *name;
+	u64 insns;   /* Executed instructions.       */
+	u64 calls;   /* Executions of its blocks.    */
+};
+
+/* Opcode, on the instruction mix. */
+struct bb_op {
+	u32 key;     /* Primary opcode << 10 | XO.   */
+	u64 count;
+};
+
+static struct {
+	uc_engine *uc;
+	const char *file;
+	uc_hook hook;
+	struct bb *tbl;    /* Open addressing, linear probing. */
+	u32 capacity;      /* Power of 2.                      */
+	u32 nbbs;
+} bbc;
+
+/* Primary opcode mnemonics. */
+static const char *const op_names[64] = {
+	[2]  = "tdi",    [3]  = "twi",    [7]  = "mulli",  [8]  = "subfic",
+	[10] = "cmpli",  [11] = "cmpi",   [12] = "addic",  [13] = "addic.",
+	[14] = "addi",   [15] = "addis",  [16] = "bc",     [17] = "sc",
+	[18] = "b",      [20] = "rlwimi", [21] = "rlwinm", [23] = "rlwnm",
+	[24] = "ori",    [25] = "oris",   [26] = "xori",   [27] = "xoris",
+	[28] = "andi.",  [29] = "andis.", [32] = "lwz",    [33] = "lwzu",
+	[34] = "lbz",    [35] = "lbzu",   [36] = "stw",    [37] = "stwu",
+	[38] = "stb",    [39] = "stbu",   [40] = "lhz",    [41] = "lhzu",
+	[42] = "lha",    [43] = "lhau",   [44] = "sth",    [45] = "sthu",
+	[46] = "lmw",    [47] = "stmw",   [48] = "lfs",    [49] = "lfsu",
+	[50] = "lfd",    [51] = "lfdu",   [52] = "stfs",   [53] = "stfsu",
+	[54] = "stfd",   [55] = "stfdu",  [58] = "ld",     [62] = "std",
+};
+
+/* Extended opcode (XO) mnemonics. */
+struct xo_name {
+	u32 op;
+	u32 xo;
+	const char *name;
+};
+
+static const struct xo_name xo_names[] = {
+	{19,    0, "mcrf"},  {19,   16, "bclr"},   {19,  150, "isync"},
+	{19,  193, "crxor"}, {19,  289, "creqv"},  {19,  449, "cror"},
+	{19,  528, "bcctr"},
+	{31,    0, "cmp"},   {31,    4, "tw"},     {31,    8, "subfc"},
+	{31,   10, "addc"},  {31,   11, "mulhwu"}, {31,   19, "mfcr"},
+	{31,   20, "lwarx"}, {31,   23, "lwzx"},   {31,   24, "slw"},
+	{31,   26, "cntlzw"},{31,   28, "and"},    {31,   32, "cmpl"},
+	{31,   40, "subf"},  {31,   55, "lwzux"},  {31,   60, "andc"},
+	{31,   75, "mulhw"}, {31,   86, "dcbf"},   {31,   87, "lbzx"},
+	{31,  104, "neg"},   {31,  124, "nor"},    {31,  136, "subfe"},
+	{31,  138, "adde"},  {31,  144, "mtcrf"},  {31,  150, "stwcx."},
+	{31,  151, "stwx"},  {31,  183, "stwux"},  {31,  200, "subfze"},
+	{31,  202, "addze"}, {31,  215, "stbx"},   {31,  234, "addme"},
+	{31,  235, "mullw"}, {31,  266, "add"},    {31,  279, "lhzx"},
+	{31,  316, "xor"},   {31,  339, "mfspr"},  {31,  343, "lhax"},
+	{31,  407, "sthx"},  {31,  412, "orc"},    {31,  444, "or"},
+	{31,  459, "divwu"}, {31,  467, "mtspr"},  {31,  476, "nand"},
+	{31,  491, "divw"},  {31,  536, "srw"},    {31,  598, "sync"},
+	{31,  792, "sraw"},  {31,  824, "srawi"},  {31,  922, "extsh"},
+	{31,  954, "extsb"}, {31, 1014, "dcbz"},
+};
+
+/**
+ * @brief Hash a block address.
+ */
+static inline u32 bb_hash(u32 addr) {
+	return (addr >> 2) * 2654435761u;
+}
+
+/**
+ * @brief Double the block table.
+ */
+static void grow_table(void)
+{
+	struct bb *old, *b;
+	u32 old_cap, i, j;
+
+	old     = bbc.tbl;
+	old_cap = bbc.capacity;
+
+	bbc.capacity = old_cap ? old_cap * 2 : 65536;
+	bbc.tbl      = calloc(bbc.capacity, sizeof(*bbc.tbl));
+	if (!bbc.tbl)
+		errx(1, "Unable to allocate block table!\n");
+
+	for (i = 0; i < old_cap; i++) {
+		if (!old[i].count)
+			continue;
+		j = bb_hash(old[i].addr) & (bbc.capacity - 1);
+		for (b = &bbc.tbl[j]; b->count; b = &bbc.tbl[j])
+			j = (j + 1) & (bbc.capacity - 1);
+		*b = old[i];
+	}
+	free(old);
+}
+
+/**
+ * @brief Block hook: count the execution of the block @p addr.
+ */
+static void hook_block(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	struct bb *b;
+	u32 i;
+	((void)uc);
+	((void)user_data);
+
+	OVH_HOOK(OVH_HOOK_BBCOUNT);
+	i = bb_hash(addr) & (bbc.capacity - 1);
+	for (b = &bbc.tbl[i]; b->count; b = &bbc.tbl[i]) {
+		if (b->addr == (u32)addr) {
+			b->count++;
+			if (size > b->size)
+				b->size = size;
+			OVH_END();
+			return;
+		}
+		i = (i + 1) & (bbc.capacity - 1);
+	}
+
+	b->addr  = addr;
+	b->size  = size;
+	b->count = 1;
+	if (++bbc.nbbs * 2 > bbc.capacity)
+		grow_table();
+	OVH_END();
+}
+
+/**
+ * @brief Find which of the @p nmods modules ([base, end)) contains
+ * @p addr.
+ *
+ * @return Returns the module id, or @p nmods if none.
+ */
+static u32 find_mod(u32 addr, const u32 *base, const u32 *end, u32 nmods)
+{
+	u32 i;
+	for (i = 0; i < nmods; i++)
+		if (addr >= base[i] && addr < end[i])
+			break;
+	return i;
+}
+
+/**
+ * @brief Save the coverage in the drcov (v2) format: a module table
+ * (the .text of each loaded module, plus the milicodes) and a binary
+ * table of the executed blocks, relative to their module.
+ */
+static void save_drcov(void)
+{
+	const struct loaded_coff *lc;
+	struct { u32 start; u16 size; u16 id; } __attribute__((packed)) ent;
+	u32 nmods, i, j, n;
+	u32 *base, *end;
+	FILE *f;
+
+	for (nmods = 1, lc = loaded_modules; lc; lc = lc->next)
+		nmods++;
+
+	base = calloc(nmods, sizeof(*base));
+	end  = calloc(nmods, sizeof(*end));
+	if (!base || !end)
+		errx(1, "Unable to allocate module table!\n");
+
+	f = fopen(bbc.file, "wb");
+	if (!f) {
+		warn("Unable to open coverage file (%s)!\n", bbc.file);
+		goto out;
+	}
+
+	fprintf(f, "DRCOV VERSION: 2\nDRCOV FLAVOR: aix-user\n"
+		"Module Table: version 2, count %u\n"
+		"Columns: id, base, end, entry, checksum, timestamp, path\n", nmods);
+
+	for (i = 0, lc = loaded_modules; lc; lc = lc->next, i++) {
+		base[i] = lc->text_start;
+		end[i]  = lc->text_start + lc->xcoff.aux.o_tsize;
+		fprintf(f, "%3u, 0x%08x, 0x%08x, 0x0000000000000000, 0x00000000, "
+			"0x00000000, %s\n", i, base[i], end[i], lc->name);
+	}
+	base[i] = UNIX_MILI_ADDR;
+	end[i]  = UNIX_MILI_ADDR + UNIX_MILI_SIZE;
+	fprintf(f, "%3u, 0x%08x, 0x%08x, 0x0000000000000000, 0x00000000, "
+		"0x00000000, [milicode]\n", i, base[i], end[i]);
+
+	/* Blocks out of any module are left out. */
+	for (i = 0, n = 0; i < bbc.capacity; i++)
+		if (bbc.tbl[i].count &&
+			find_mod(bbc.tbl[i].addr, base, end, nmods) < nmods)
+		{
+			n++;
+		}
+
+	fprintf(f, "BB Table: %u bbs\n", n);
+	for (i = 0; i < bbc.capacity; i++) {
+		if (!bbc.tbl[i].count)
+			continue;
+		j = find_mod(bbc.tbl[i].addr, base, end, nmods);
+		if (j == nmods)
+			continue;
+		ent.start = htole32(bbc.tbl[i].addr - base[j]);
+		ent.size  = htole16(min(bbc.tbl[i].size, 0xFFFF));
+		ent.id    = htole16(j);
+		fwrite(&ent, sizeof(ent), 1, f);
+	}
+	fclose(f);
+out:
+	free(base);
+	free(end);
+}
+
+/**
+ * @brief Compare functions by module and name pointers.
+ */
+static int cmp_func_key(const void *a, const void *b)
+{
+	const struct bb_func *fa = a, *fb = b;
+	if (fa->module != fb->module)
+		return ((uintptr_t)fa->module < (uintptr_t)fb->module) ? -1 : 1;
+	if (fa->name != fb->name)
+		return ((uintptr_t)fa->name < (uintptr_t)fb->name) ? -1 : 1;
+	return 0;
+}
+
+/**
+ * @brief Compare functions by executed instructions (descending).
+ */
+static int cmp_func_insns(const void *a, const void *b)
+{
+	const struct bb_func *fa = a, *fb = b;
+	if (fa->insns != fb->insns)
+		return (fa->insns < fb->insns) ? 1 : -1;
+	return 0;
+}
+
+/**
+ * @brief Print the functions that executed the most instructions.
+ *
+ * Each block is accounted to the nearest function below it (see
+ * sym.h), or to its module if none.
+ */
+static void report_funcs(u64 total)
+{
+	struct bb_func *funcs;
+	u32 off, i, n, j;
+
+	funcs = calloc(bbc.nbbs ? bbc.nbbs : 1, sizeof(*funcs));
+	if (!funcs)
+		errx(1, "Unable to allocate hot list!\n");
+
+	for (i = 0, n = 0; i < bbc.capacity; i++) {
+		if (!bbc.tbl[i].count)
+			continue;
+		funcs[n].name  = sym_lookup(bbc.uc, bbc.tbl[i].addr,
+			&funcs[n].module, &off);
+		funcs[n].insns = bbc.tbl[i].count * (bbc.tbl[i].size / 4);
+		funcs[n].calls = bbc.tbl[i].count;
+		n++;
+	}
+
+	/* Merge the blocks of each function. */
+	qsort(funcs, n, sizeof(*funcs), cmp_func_key);
+	for (i = 0, j = 0; i < n; i++) {
+		if (j && !cmp_func_key(&funcs[j - 1], &funcs[i])) {
+			funcs[j - 1].insns += funcs[i].insns;
+			funcs[j - 1].calls += funcs[i].calls;
+		} else
+			funcs[j++] = funcs[i];
+	}
+	n = j;
+	qsort(funcs, n, sizeof(*funcs), cmp_func_insns);
+
+	fprintf(stderr, "\n[bbcount] Hottest functions (%u blocks, %" PRIu64
+		" instructions):\n", bbc.nbbs, total);
+	fprintf(stderr, "[bbcount] %% insns        insns  block execs  function\n");
+	for (i = 0; i < n && i < BB_TOP_FUNCS; i++) {
+		fprintf(stderr, "[bbcount] %7.2f %12" PRIu64 " %12" PRIu64 "  %s%s%s\n",
+			total ? funcs[i].insns * 100.0 / total : 0.0, funcs[i].insns,
+			funcs[i].calls,
+			funcs[i].module ? funcs[i].module : "",
+			funcs[i].module ? "`" : "",
+			funcs[i].name   ? funcs[i].name   : "[unknown]");
+	}
+	free(funcs);
+}
+
+/**
+ * @brief Get the mnemonic of the opcode @p key (primary << 10 | XO)
+ * into @p buff.
+ */
+static const char *op_name(u32 key, char *buff, size_t size)
+{
+	u32 op = key >> 10;
+	u32 xo = key & 0x3FF;
+	size_t i;
+
+	if (op != 19 && op != 31 && op != 59 && op != 63) {
+		if (op_names[op])
+			return op_names[op];
+		snprintf(buff, size, "op%u", op);
+		return buff;
+	}
+
+	/* XO-form (arithmetic) instructions have the OE bit within XO. */
+	for (i = 0; i < sizeof(xo_names) / sizeof(xo_names[0]); i++) {
+		if (xo_names[i].op == op && (xo_names[i].xo == xo ||
+			(op == 31 && xo_names[i].xo == (xo & 0x1FF))))
+		{
+			return xo_names[i].name;
+		}
+	}
+	snprintf(buff, size, "op%u/%u", op, xo);
+	return buff;
+}
+
+/**
+ * @brief Compare opcodes by count (descending).
+ */
+static int cmp_op(const void *a, const void *b)
+{
+	const struct bb_op *oa = a, *ob = b;
+	if (oa->count != ob->count)
+		return (oa->count < ob->count) ? 1 : -1;
+	return (oa->key < ob->key) ? -1 : (oa->key > ob->key);
+}
+
+/**
+ * @brief Print the instruction mix: each distinct block is decoded
+ * once, and its instructions weighted by its executions.
+ */
+static void report_ops(u64 total)
+{
+	struct bb_op *ops;
+	u32 *insns = NULL;
+	u32 i, j, n, op, key;
+	u32 capacity = 0;
+	char buff[16];
+
+	ops = calloc(64 << 10, sizeof(*ops));
+	if (!ops)
+		errx(1, "Unable to allocate instruction mix!\n");
+
+	for (i = 0; i < bbc.capacity; i++) {
+		if (!bbc.tbl[i].count)
+			continue;
+
+		n = bbc.tbl[i].size / 4;
+		if (n > capacity) {
+			capacity = n;
+			insns    = realloc(insns, capacity * sizeof(*insns));
+			if (!insns)
+				errx(1, "Unable to allocate instruction mix!\n");
+		}
+		if (uc_mem_read(bbc.uc, bbc.tbl[i].addr, insns, n * 4))
+			continue;
+
+		for (j = 0; j < n; j++) {
+			op  = ntohl(insns[j]) >> 26;
+			key = op << 10;
+			if (op == 19 || op == 31 || op == 59 || op == 63)
+				key |= (ntohl(insns[j]) >> 1) & 0x3FF;
+			ops[key].key    = key;
+			ops[key].count += bbc.tbl[i].count;
+		}
+	}
+	free(insns);
+
+	qsort(ops, 64 << 10, sizeof(*ops), cmp_op);
+
+	fprintf(stderr, "\n[bbcount] Instruction mix:\n");
+	fprintf(stderr, "[bbcount] %% insns        insns  mnemonic\n");
+	for (i = 0; i < (64 << 10) && i < BB_TOP_OPS && ops[i].count; i++) {
+		fprintf(stderr, "[bbcount] %7.2f %12" PRIu64 "  %s\n",
+			total ? ops[i].count * 100.0 / total : 0.0, ops[i].count,
+			op_name(ops[i].key, buff, sizeof buff));
+	}
+	free(ops);
+}
+
+/**
+ * @brief Emit the reports, called at exit.
+ */
+static void bbcount_report(void)
+{
+	u64 total = 0;
+	u32 i;
+
+	for (i = 0; i < bbc.capacity; i++)
+		total += bbc.tbl[i].count * (bbc.tbl[i].size / 4);
+
+	save_drcov();
+	report_funcs(total);
+	report_ops(total);
+}
+
+/**
+ * @brief Enable the basic-block counter: reports are emitted at exit.
+ *
+ * @param uc   Unicorn context.
+ * @param file drcov output file, or NULL.
+ */
+void bbcount_init(uc_engine *uc, const char *file)
+{
+	if (!file)
+		return;
+
+	bbc.uc   = uc;
+	bbc.file = file;
+	grow_table();
+
+	if (uc_hook_add(uc, &bbc.hook, UC_HOOK_BLOCK, hook_block, NULL, 1, 0))
+		errx(1, "Unable to add block hook!\n");
+
+	atexit(bbcount_report);
+}
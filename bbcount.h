@@ -0,0 +1,21 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef BBCOUNT_H
+#define BBCOUNT_H
+
+/*
+ * Basic-block counter (--bbcount): counts how many times each guest
+ * block was executed, via UC_HOOK_BLOCK. At exit, it saves the
+ * coverage in the drcov format (for Lighthouse, bncov, etc.), and
+ * prints the hottest functions and the instruction mix on stderr.
+ */
+
+#include "util.h"
+
+extern void bbcount_init(uc_engine *uc, const char *file);
+
+#endif /* BBCOUNT_H */
@@ -4,9 +4,11 @@
  * Made by Theldus, 2025
  */
 
+#define _GNU_SOURCE
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,6 +18,22 @@
 
 #include "bigar.h"
 
+/*
+ * Archive cache.
+ *
+ * Archives opened via ar_get() are shared by all users, keyed by
+ * (dev, ino), so importing several members from the same archive
+ * opens, mmaps and indexes it only once. They are kept until exit,
+ * as the loaded modules point into their mappings.
+ */
+struct ar_cache_entry {
+	dev_t dev;
+	ino_t ino;
+	struct big_ar ar;
+	struct ar_cache_entry *next;
+};
+static struct ar_cache_entry *ar_cache;
+
 /**
  * @brief Parse an in-file member header @p hdr to an in-memory member
  * reader @p mem.
@@ -84,30 +102,62 @@ static int member_info(
 }
 
 /**
- * @brief Iterate over all AR members from the referred @p ar. For each of them,
- * calls the callback routine @fn to handle the current member.
+ * @brief Hash a member name of length @p len (FNV-1a).
  *
- * @param ar   Opened AR file to be iterated.
- * @param fn   Callback function to be called over each member.
- * @param data User-defined data passed as argument to @p fn.
+ * @param name Member name (not necessarily null terminated).
+ * @param len  Name length.
+ *
+ * @return Returns the hash value.
+ */
+static u32 member_hash(const char *name, size_t len)
+{
+	u32 h = 2166136261u;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		h ^= (u8)name[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * @brief Build the member index for @p ar, i.e., walk the member list
+ * once, parsing each member header, and hash all members by name.
+ *
+ * Subsequent lookups and iterations use the index only, without
+ * parsing headers again.
+ *
+ * @param ar Opened AR file.
  *
  * @return Returns -1 if error, 0 otherwise.
  */
-int ar_iterate_members(const struct big_ar *ar, const memb_hdlr_fn fn, void *data)
+static int ar_build_index(struct big_ar *ar)
 {
+	struct ar_memb_idx *tmp, *m;
 	struct ar_memb_hdr_mem mem;
 	struct ar_memb_hdr hdr;
 	const char *name_off;
+	u32 capacity;
 	u64 curr_off;
-	int ret;
+	u32 i, h;
+
+	/* Already built. */
+	if (ar->buckets)
+		return 0;
 
+	capacity = 0;
 	curr_off = ar->fl_hdr.fstmoff;
 
 	while (curr_off != 0 && curr_off < ar->file_size) {
+		if (curr_off + sizeof(hdr) > ar->file_size) {
+			warn("Not enough space to read member header!\n");
+			goto err;
+		}
+
 		memcpy(&hdr, ar->buff+curr_off, sizeof(hdr));
 		if (parse_member(&hdr, &mem)) {
 			warn("Unable to parse AR member!\n");
-			return -1;
+			goto err;
 		}
 
 		/* Validate name. */
@@ -115,26 +165,131 @@ int ar_iterate_members(const struct big_ar *ar, const memb_hdlr_fn fn, void *dat
 		curr_off += AR_MEMB_NAME + mem.namlen;
 		if (curr_off >= ar->file_size) {
 			warn("Not enough space to read member name!\n");
-			return -1;
+			goto err;
 		}
 
 		/* Find offset to member data. */
 		curr_off += (curr_off & 1);
 		if (curr_off+2+mem.size > ar->file_size) {
 			warn("Not enough space to read member data!\n");
-			return -1;
+			goto err;
 		}
 
 		/* Only consider non 0-length members. */
 		if (mem.namlen) {
-			if (fn(name_off, ar->buff+curr_off+2, &mem, data) < 0)
-				break;
+			if (ar->nmembers == capacity) {
+				capacity = capacity ? capacity * 2 : 64;
+				tmp = realloc(ar->members, capacity * sizeof(*tmp));
+				if (!tmp) {
+					warn("Unable to allocate member index!\n");
+					goto err;
+				}
+				ar->members = tmp;
+			}
+			m = &ar->members[ar->nmembers++];
+			m->off  = name_off - AR_MEMB_NAME - ar->buff;
+			m->name = name_off;
+			m->data = ar->buff + curr_off + 2;
+			m->hdr  = mem;
+			m->next = 0;
+		}
+
+		/* Avoid looping forever on corrupted archives. */
+		if (ar->nmembers > ar->file_size / AR_MEMB_NAME) {
+			warn("Member list loops!\n");
+			goto err;
 		}
+
 		curr_off = mem.nxtmem;
 	}
+
+	/* Hash buckets: at least twice the amount of members. */
+	ar->nbuckets = 16;
+	while (ar->nbuckets < ar->nmembers * 2)
+		ar->nbuckets <<= 1;
+
+	ar->buckets = calloc(ar->nbuckets, sizeof(u32));
+	if (!ar->buckets) {
+		warn("Unable to allocate member index!\n");
+		goto err;
+	}
+
+	/* Keep the first occurrence first in the chain. */
+	for (i = ar->nmembers; i > 0; i--) {
+		m = &ar->members[i - 1];
+		h = member_hash(m->name, m->hdr.namlen) & (ar->nbuckets - 1);
+		m->next = ar->buckets[h];
+		ar->buckets[h] = i;
+	}
+
+	return 0;
+err:
+	free(ar->members);
+	free(ar->buckets);
+	ar->members  = NULL;
+	ar->buckets  = NULL;
+	ar->nmembers = 0;
+	ar->nbuckets = 0;
+	return -1;
+}
+
+/**
+ * @brief Iterate over all AR members from the referred @p ar. For each of them,
+ * calls the callback routine @fn to handle the current member.
+ *
+ * @param ar   Opened AR file to be iterated.
+ * @param fn   Callback function to be called over each member.
+ * @param data User-defined data passed as argument to @p fn.
+ *
+ * @return Returns -1 if error, 0 otherwise.
+ */
+int ar_iterate_members(struct big_ar *ar, const memb_hdlr_fn fn, void *data)
+{
+	const struct ar_memb_idx *m;
+	u32 i;
+
+	if (ar_build_index(ar) < 0)
+		return -1;
+
+	for (i = 0; i < ar->nmembers; i++) {
+		m = &ar->members[i];
+		if (fn(m->name, m->data, &m->hdr, data) < 0)
+			break;
+	}
 	return 0;
 }
 
+/**
+ * @brief For an already opened AR file (@p ar), find a member by its
+ * name @p mname.
+ *
+ * @param ar    Opened archive.
+ * @param mname Member name, like 'shr.o'.
+ *
+ * @return Returns the member index entry, or NULL if not found.
+ */
+const struct ar_memb_idx *
+ar_find_member(struct big_ar *ar, const char *mname)
+{
+	const struct ar_memb_idx *m;
+	size_t len;
+	u32 i;
+
+	if (!ar || !mname || ar_build_index(ar) < 0)
+		return NULL;
+
+	len = strlen(mname);
+	i   = ar->buckets[member_hash(mname, len) & (ar->nbuckets - 1)];
+
+	while (i) {
+		m = &ar->members[i - 1];
+		if (m->hdr.namlen == len && !memcmp(m->name, mname, len))
+			return m;
+		i = m->next;
+	}
+	return NULL;
+}
+
 /**
  * @brief For an already opened AR file (@p ar), show its member infos.
  *
@@ -150,41 +305,175 @@ int ar_show_info(struct big_ar *ar)
 	return ar_iterate_members(ar, member_info, NULL);
 }
 
-struct member {
-	const char *member_name;
-	const char *buf;
-	size_t size;
-};
+/**
+ * @brief Read a big-endian 64-bit value from @p p.
+ *
+ * @param p Buffer to be read.
+ *
+ * @return Returns the value read.
+ */
+static u64 read_be64(const char *p)
+{
+	const u8 *b = (const u8 *)p;
+	u64 v = 0;
+	int i;
+	for (i = 0; i < 8; i++)
+		v = (v << 8) | b[i];
+	return v;
+}
 
 /**
- * @brief Extracts a single AR member.
+ * @brief Compare two member index entries by header offset, for qsort().
+ */
+static int cmp_member_off(const void *a, const void *b)
+{
+	const struct ar_memb_idx *ma = *(const struct ar_memb_idx * const *)a;
+	const struct ar_memb_idx *mb = *(const struct ar_memb_idx * const *)b;
+	if (ma->off < mb->off)
+		return -1;
+	return (ma->off > mb->off);
+}
+
+/**
+ * @brief Read the 32-bit global symbol table of @p ar (if any), and
+ * hash all symbols by name.
  *
- * @param memb_name Buffer pointing to member name.
- * @param memb_data Buffer pointing to member data, with size mhdr->size.
- * @param mhdr      In-memory member header.
- * @param data      Member structure that holds parameters for the member
- *                  extraction.
+ * The GST is stored as a member (without name), whose data is:
+ * - Number of symbols (N), as 8-byte big-endian
+ * - N member header offsets, as 8-byte big-endian
+ * - N null-terminated symbol names
  *
- * @return Returns 0.
+ * @param ar Opened AR file.
+ *
+ * @return Returns 0 if the GST was read, -1 if error or the archive
+ * have no GST.
  */
-static int member_extract(
-	const char *memb_name,
-	const char *memb_data,
-	const struct ar_memb_hdr_mem *mhdr, void *data)
+static int ar_read_gst(struct big_ar *ar)
 {
-	struct member *m = data;
-	if (!m || !m->member_name)
-		return -1; /* Abort search. */
+	const struct ar_memb_idx **sorted = NULL;
+	const struct ar_memb_idx *pkey, **found;
+	struct ar_memb_idx key;
+	struct ar_memb_hdr_mem mem;
+	struct ar_memb_hdr hdr;
+	const char *data, *name, *end;
+	struct ar_gst_sym *s;
+	u64 off, count, i;
+	u32 h;
 
-	if (mhdr->namlen == strlen(m->member_name) &&
-		!strncmp(memb_name, m->member_name, mhdr->namlen))
-	{
-		m->buf  = memb_data;
-		m->size = mhdr->size;
-		return -1; /* Found it. */
+	if (ar->gst_state)
+		return (ar->gst_state > 0) ? 0 : -1;
+
+	ar->gst_state = -1;
+	off = ar->fl_hdr.gstoff;
+	if (!off || ar_build_index(ar) < 0)
+		return -1;
+
+	/* GST member header. */
+	if (off + sizeof(hdr) > ar->file_size)
+		goto err;
+	memcpy(&hdr, ar->buff + off, sizeof(hdr));
+	if (parse_member(&hdr, &mem))
+		goto err;
+
+	off += AR_MEMB_NAME + mem.namlen;
+	off += (off & 1) + 2;
+	if (off + mem.size > ar->file_size || mem.size < 8)
+		goto err;
+
+	data  = ar->buff + off;
+	end   = data + mem.size;
+	count = read_be64(data);
+	if (count > (mem.size - 8) / 8)
+		goto err;
+
+	ar->syms = calloc(count ? count : 1, sizeof(*ar->syms));
+	sorted   = malloc((ar->nmembers ? ar->nmembers : 1) * sizeof(*sorted));
+	if (!ar->syms || !sorted)
+		goto err;
+
+	/* Members sorted by offset, to map offsets into members. */
+	for (i = 0; i < ar->nmembers; i++)
+		sorted[i] = &ar->members[i];
+	qsort(sorted, ar->nmembers, sizeof(*sorted), cmp_member_off);
+
+	name = data + 8 + count * 8;
+	for (i = 0; i < count; i++) {
+		/* Symbol name. */
+		if (name >= end || !memchr(name, '\0', end - name))
+			goto err;
+
+		/* Member. */
+		key.off = read_be64(data + 8 + i * 8);
+		pkey  = &key;
+		found = bsearch(&pkey, sorted, ar->nmembers, sizeof(*sorted),
+			cmp_member_off);
+
+		if (found) {
+			s = &ar->syms[ar->nsyms++];
+			s->name   = name;
+			s->member = *found - ar->members;
+		}
+		name += strlen(name) + 1;
 	}
 
-	return 0; /* Keep searching. */
+	/* Hash buckets: at least twice the amount of symbols. */
+	ar->nsym_buckets = 16;
+	while (ar->nsym_buckets < ar->nsyms * 2)
+		ar->nsym_buckets <<= 1;
+
+	ar->sym_buckets = calloc(ar->nsym_buckets, sizeof(u32));
+	if (!ar->sym_buckets)
+		goto err;
+
+	/* Keep the first occurrence first in the chain. */
+	for (i = ar->nsyms; i > 0; i--) {
+		s = &ar->syms[i - 1];
+		h = member_hash(s->name, strlen(s->name)) & (ar->nsym_buckets - 1);
+		s->next = ar->sym_buckets[h];
+		ar->sym_buckets[h] = i;
+	}
+
+	free(sorted);
+	ar->gst_state = 1;
+	return 0;
+err:
+	warn("Invalid global symbol table!\n");
+	free(sorted);
+	free(ar->syms);
+	ar->syms  = NULL;
+	ar->nsyms = 0;
+	return -1;
+}
+
+/**
+ * @brief For an already opened AR file (@p ar), find which member exports
+ * the symbol @p sym, accordingly with the archive global symbol table.
+ *
+ * @param ar  Opened archive.
+ * @param sym Symbol name.
+ *
+ * @return Returns the member index entry, or NULL if not found (or if
+ * the archive do not have a global symbol table).
+ */
+const struct ar_memb_idx *
+ar_find_symbol(struct big_ar *ar, const char *sym)
+{
+	const struct ar_gst_sym *s;
+	u32 i;
+
+	if (!ar || !sym || ar_read_gst(ar) < 0)
+		return NULL;
+
+	i = ar->sym_buckets[member_hash(sym, strlen(sym)) &
+		(ar->nsym_buckets - 1)];
+
+	while (i) {
+		s = &ar->syms[i - 1];
+		if (!strcmp(s->name, sym))
+			return &ar->members[s->member];
+		i = s->next;
+	}
+	return NULL;
 }
 
 /**
@@ -205,21 +494,19 @@ static int member_extract(
  * buffer for that.
  */
 const char *
-ar_extract_member(const struct big_ar *ar, const char *mname, size_t *size)
+ar_extract_member(struct big_ar *ar, const char *mname, size_t *size)
 {
-	int ret;
-	struct member m = {0};
+	const struct ar_memb_idx *m;
 
 	if (!ar || !mname || !size)
 		return NULL;
 
-	m.member_name = mname;
-	ret = ar_iterate_members(ar, member_extract, &m);
-	if (ret < 0 || !m.buf)
+	m = ar_find_member(ar, mname);
+	if (!m)
 		return NULL;
 
-	*size = m.size;
-	return m.buf;
+	*size = m->hdr.size;
+	return m->data;
 }
 
 /**
@@ -284,6 +571,7 @@ int ar_open(const char *bin, struct big_ar *ar)
 	if (!ar)
 		return ret;
 
+	memset(ar, 0, sizeof(*ar));
 	ar->fd = open(bin, O_RDONLY);
 	if (ar->fd < 0) {
 		warn("Unable to open file!\n");
@@ -294,6 +582,8 @@ int ar_open(const char *bin, struct big_ar *ar)
 	ar->buff = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, ar->fd, 0);
 	if (ar->buff == MAP_FAILED) {
 		warn("Unable to mmap xcoff file!\n");
+		ar->buff = NULL;
+		close(ar->fd);
 		return ret;
 	}
 
@@ -307,10 +597,329 @@ int ar_open(const char *bin, struct big_ar *ar)
 	return ret;
 }
 
+/* ------------------------------------------------------------------*
+ * Archive writer                                                    *
+ * ------------------------------------------------------------------*/
+
+/**
+ * @brief Write @p len bytes from @p buf to @p fd.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		p   += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/**
+ * @brief Copy @p size bytes from @p in_fd (at offset @p off) to the current
+ * position of @p out_fd, preferably with copy_file_range(), or with plain
+ * reads/writes if not possible.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int copy_data(int in_fd, u64 off, int out_fd, u64 size)
+{
+	char buf[65536];
+	loff_t in_off;
+	ssize_t ret;
+	u64 done;
+
+	in_off = off;
+	done   = 0;
+	while (done < size) {
+		ret = copy_file_range(in_fd, &in_off, out_fd, NULL, size - done, 0);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+
+	while (done < size) {
+		ret = pread(in_fd, buf, min(sizeof buf, size - done), off + done);
+		if (ret <= 0) {
+			if (ret < 0 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (write_all(out_fd, buf, ret) < 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+/**
+ * @brief Size of a member (header + name + data, with paddings) with
+ * name length @p namlen and data size @p size.
+ */
+static u64 member_total_size(size_t namlen, u64 size)
+{
+	u64 len = AR_MEMB_NAME + namlen;
+	len += (len & 1) + 2 + size;
+	return len + (len & 1);
+}
+
+/**
+ * @brief Write a member header (plus name and trailer) to @p fd.
+ *
+ * @param fd     Output file descriptor.
+ * @param name   Member name (might be empty).
+ * @param size   Member data size.
+ * @param nxtmem Next member offset.
+ * @param prvmem Previous member offset.
+ * @param m      Member attributes (date/uid/gid/mode), or NULL.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int write_member_hdr(int fd, const char *name, u64 size, u64 nxtmem,
+	u64 prvmem, const struct ar_wmemb *m)
+{
+	char hdr[AR_MEMB_NAME + 256 + 4];
+	size_t namlen;
+	int len;
+
+	namlen = strlen(name);
+	if (namlen > 255)
+		return -1;
+
+	len = snprintf(hdr, sizeof hdr,
+		"%-20" PRIu64 "%-20" PRIu64 "%-20" PRIu64
+		"%-12" PRIu64 "%-12" PRIu32 "%-12" PRIu32 "%-12" PRIo32
+		"%-4zu%s",
+		size, nxtmem, prvmem,
+		m ? m->date : 0,
+		m ? m->uid  : 0,
+		m ? m->gid  : 0,
+		m ? m->mode : 0644,
+		namlen, name);
+
+	/* Pad, so data starts at even offsets. */
+	if (len & 1)
+		hdr[len++] = '\0';
+	hdr[len++] = '`';
+	hdr[len++] = '\n';
+	return write_all(fd, hdr, len);
+}
+
+/**
+ * @brief Write a single padding byte if @p len is odd.
+ */
+static int write_pad(int fd, u64 len)
+{
+	if (len & 1)
+		return write_all(fd, "", 1);
+	return 0;
+}
+
+/**
+ * @brief Write a new Big-AR archive to @p out, containing the members
+ * @p membs.
+ *
+ * The archive layout is: file header, members (in order), the member
+ * table and then the 32-bit global symbol table (if any member exports
+ * symbols). Member data is copied with copy_file_range() whenever
+ * possible.
+ *
+ * @param out   Output archive path.
+ * @param membs Members to be written.
+ * @param n     Amount of members.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+int ar_write(const char *out, const struct ar_wmemb *membs, u32 n)
+{
+	char fl_hdr[sizeof(struct ar_fl_hdr) + 1];
+	u64 *offs = NULL, memoff, gstoff, off;
+	u64 mt_size, gst_size, nsyms;
+	char num[32], be[8];
+	int fd = -1;
+	size_t len;
+	u32 i, j;
+	int k;
+
+	if (!out || (!membs && n))
+		return -1;
+
+	offs = malloc((n ? n : 1) * sizeof(*offs));
+	if (!offs)
+		return -1;
+
+	/* Layout. */
+	off   = sizeof(struct ar_fl_hdr);
+	nsyms = 0;
+	for (i = 0; i < n; i++) {
+		offs[i] = off;
+		off    += member_total_size(strlen(membs[i].name), membs[i].size);
+		nsyms  += membs[i].nsyms;
+	}
+
+	/* Member table: count, offsets (20 chars each) and names. */
+	memoff  = off;
+	mt_size = 20 + (u64)n * 20;
+	for (i = 0; i < n; i++)
+		mt_size += strlen(membs[i].name) + 1;
+	off += member_total_size(0, mt_size);
+
+	/* GST: count, offsets (8 bytes, big-endian each) and names. */
+	gstoff   = nsyms ? off : 0;
+	gst_size = 8 + nsyms * 8;
+	for (i = 0; i < n; i++)
+		for (j = 0; j < membs[i].nsyms; j++)
+			gst_size += strlen(membs[i].syms[j]) + 1;
+
+	fd = open(out, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0) {
+		warn("Unable to create archive '%s'\n", out);
+		goto err;
+	}
+
+	/* File header. */
+	snprintf(fl_hdr, sizeof fl_hdr,
+		"%s%-20" PRIu64 "%-20" PRIu64 "%-20d%-20" PRIu64 "%-20" PRIu64 "%-20d",
+		AMAGICBIG, memoff, gstoff, 0,
+		n ? offs[0] : 0, n ? offs[n - 1] : 0, 0);
+	if (write_all(fd, fl_hdr, sizeof(struct ar_fl_hdr)) < 0)
+		goto err;
+
+	/* Members. */
+	for (i = 0; i < n; i++) {
+		if (write_member_hdr(fd, membs[i].name, membs[i].size,
+			(i + 1 < n) ? offs[i + 1] : 0, i ? offs[i - 1] : 0,
+			&membs[i]) < 0)
+		{
+			goto err;
+		}
+
+		if (copy_data(membs[i].fd, membs[i].off, fd, membs[i].size) < 0) {
+			warn("Unable to copy member '%s'\n", membs[i].name);
+			goto err;
+		}
+
+		len = AR_MEMB_NAME + strlen(membs[i].name);
+		if (write_pad(fd, len + (len & 1) + 2 + membs[i].size) < 0)
+			goto err;
+	}
+
+	/* Member table. */
+	if (write_member_hdr(fd, "", mt_size, gstoff, n ? offs[n - 1] : 0,
+		NULL) < 0)
+	{
+		goto err;
+	}
+
+	snprintf(num, sizeof num, "%-20u", n);
+	if (write_all(fd, num, 20) < 0)
+		goto err;
+	for (i = 0; i < n; i++) {
+		snprintf(num, sizeof num, "%-20" PRIu64, offs[i]);
+		if (write_all(fd, num, 20) < 0)
+			goto err;
+	}
+	for (i = 0; i < n; i++)
+		if (write_all(fd, membs[i].name, strlen(membs[i].name) + 1) < 0)
+			goto err;
+	if (write_pad(fd, AR_MEMB_NAME + 2 + mt_size) < 0)
+		goto err;
+
+	/* Global symbol table. */
+	if (nsyms) {
+		if (write_member_hdr(fd, "", gst_size, 0, memoff, NULL) < 0)
+			goto err;
+
+		for (k = 0; k < 8; k++)
+			be[k] = (nsyms >> (56 - k * 8)) & 0xFF;
+		if (write_all(fd, be, 8) < 0)
+			goto err;
+
+		for (i = 0; i < n; i++) {
+			for (k = 0; k < 8; k++)
+				be[k] = (offs[i] >> (56 - k * 8)) & 0xFF;
+			for (j = 0; j < membs[i].nsyms; j++)
+				if (write_all(fd, be, 8) < 0)
+					goto err;
+		}
+
+		for (i = 0; i < n; i++) {
+			for (j = 0; j < membs[i].nsyms; j++) {
+				len = strlen(membs[i].syms[j]) + 1;
+				if (write_all(fd, membs[i].syms[j], len) < 0)
+					goto err;
+			}
+		}
+		if (write_pad(fd, AR_MEMB_NAME + 2 + gst_size) < 0)
+			goto err;
+	}
+
+	free(offs);
+	if (close(fd) < 0)
+		return -1;
+	return 0;
+err:
+	warn("Unable to write archive '%s'\n", out);
+	free(offs);
+	if (fd >= 0)
+		close(fd);
+	return -1;
+}
+
+/**
+ * @brief Get a shared handle for the archive @p bin, opening it only if
+ * not already opened.
+ *
+ * @param bin AR-file to be read.
+ *
+ * @return Returns the shared archive, or NULL if error.
+ *
+ * @note The returned handle lives until exit, and must never be
+ * released with ar_close().
+ */
+struct big_ar *ar_get(const char *bin)
+{
+	struct ar_cache_entry *e;
+	struct stat st;
+
+	if (!bin || stat(bin, &st) < 0)
+		return NULL;
+
+	for (e = ar_cache; e; e = e->next) {
+		if (e->dev == st.st_dev && e->ino == st.st_ino)
+			return &e->ar;
+	}
+
+	e = calloc(1, sizeof(*e));
+	if (!e)
+		return NULL;
+
+	if (ar_open(bin, &e->ar) < 0) {
+		ar_close(&e->ar);
+		free(e);
+		return NULL;
+	}
+
+	e->dev    = st.st_dev;
+	e->ino    = st.st_ino;
+	e->next   = ar_cache;
+	ar_cache  = e;
+	return &e->ar;
+}
+
 /**
  * @brief Deallocate all data saved in @p ar
  */
-void ar_close(const struct big_ar *ar)
+void ar_close(struct big_ar *ar)
 {
 	if (!ar)
 		return;
@@ -318,4 +927,9 @@ void ar_close(const struct big_ar *ar)
 		munmap(ar->buff, ar->file_size);
 		close(ar->fd);
 	}
+	free(ar->members);
+	free(ar->buckets);
+	free(ar->syms);
+	free(ar->sym_buckets);
+	memset(ar, 0, sizeof(*ar));
 }
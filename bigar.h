@@ -76,6 +76,27 @@ struct ar_memb_hdr_mem {
 	} _ar_name;
 };
 
+/**
+ * Member index entry: everything needed to access a member, parsed
+ * only once.
+ */
+struct ar_memb_idx {
+	const char *name;            /* Member name (not null terminated). */
+	const char *data;            /* Member data.                       */
+	struct ar_memb_hdr_mem hdr;  /* Parsed member header.              */
+	u64 off;                     /* Member header offset.              */
+	u32 next;                    /* Next in hash chain (idx+1, 0=end). */
+};
+
+/**
+ * Global symbol table (32-bit) entry: symbol name -> member.
+ */
+struct ar_gst_sym {
+	const char *name;            /* Symbol name (null terminated).     */
+	u32 member;                  /* Index into big_ar members.         */
+	u32 next;                    /* Next in hash chain (idx+1, 0=end). */
+};
+
 /**
  * Big AR data
  */ 
@@ -84,6 +105,19 @@ struct big_ar {
 	char   *buff;
 	size_t file_size;
 	struct ar_fl_hdr_mem fl_hdr;
+
+	/* Member index, built on first use. */
+	struct ar_memb_idx *members;  /* Members, in archive order. */
+	u32 nmembers;
+	u32 *buckets;                 /* Hash buckets (idx+1, 0=empty). */
+	u32 nbuckets;                 /* Power of 2. */
+
+	/* Global symbol table, read on first use. */
+	int gst_state;                /* 0: not read, 1: read, -1: none. */
+	struct ar_gst_sym *syms;
+	u32 nsyms;
+	u32 *sym_buckets;
+	u32 nsym_buckets;
 };
 
 /**
@@ -197,12 +231,34 @@ static inline u64 r64(const char *str, size_t len, int *err)
 	return ret;
 }
 
+/**
+ * Member to be written into a new archive, see ar_write().
+ */
+struct ar_wmemb {
+	const char *name;   /* Member name.                         */
+	int  fd;            /* Source file descriptor.              */
+	u64  off;           /* Data offset in the source file.      */
+	u64  size;          /* Data size.                           */
+	u64  date;          /* File date (epoch).                   */
+	u32  uid;           /* File UID.                            */
+	u32  gid;           /* File GID.                            */
+	u32  mode;          /* File mode.                           */
+	const char **syms;  /* Exported symbols, for the GST.       */
+	u32  nsyms;         /* Amount of exported symbols.          */
+};
+
 extern int ar_open(const char *bin, struct big_ar *ar);
-extern void ar_close(const struct big_ar *ar);
+extern int ar_write(const char *out, const struct ar_wmemb *membs, u32 n);
+extern void ar_close(struct big_ar *ar);
+extern struct big_ar *ar_get(const char *bin);
 extern const char *
-ar_extract_member(const struct big_ar *ar, const char *mname, size_t *size);
+ar_extract_member(struct big_ar *ar, const char *mname, size_t *size);
+extern const struct ar_memb_idx *
+ar_find_member(struct big_ar *ar, const char *mname);
+extern const struct ar_memb_idx *
+ar_find_symbol(struct big_ar *ar, const char *sym);
 extern int ar_show_info(struct big_ar *ar);
-extern int ar_iterate_members(const struct big_ar *ar, const memb_hdlr_fn fn,
+extern int ar_iterate_members(struct big_ar *ar, const memb_hdlr_fn fn,
 	void *data);
 
 #endif /* BIGAR_H. */
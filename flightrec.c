@@ -0,0 +1,204 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "flightrec.h"
+#include "overhead.h"
+#include "sym.h"
+
+/* Ring sizes, must be powers of 2. */
+#define FR_SYSCALLS 32
+#define FR_BLOCKS   64
+#define FR_LOADER   32
+
+/* Syscall. */
+struct fr_syscall {
+	const char *name;
+	u32 argv[4];
+	u32 lr;           /* Caller.                          */
+	u32 ret;
+	int done;         /* Returned (ret is valid).         */
+};
+
+/* Loader event. */
+struct fr_loader {
+	const char *event;
+	const char *name; /* Module or symbol.                */
+	u32 addr;         /* .text start, or bound address.   */
+};
+
+int flightrec_enabled;
+
+static struct {
+	uc_engine *uc;
+	uc_hook hook;
+	int blocks;       /* Block ring enabled.              */
+	int dumped;
+
+	/* Amount of entries ever recorded, i.e., next position. */
+	u64 nsys;
+	u64 nbbs;
+	u64 nldr;
+
+	struct fr_syscall sys[FR_SYSCALLS];
+	u32 bbs[FR_BLOCKS];
+	struct fr_loader ldr[FR_LOADER];
+} fr;
+
+/**
+ * @brief Block hook: record the block address.
+ */
+static void hook_block(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	((void)uc);
+	((void)size);
+	((void)user_data);
+	OVH_COUNT(OVH_HOOK_FLIGHTREC);
+	fr.bbs[fr.nbbs++ & (FR_BLOCKS - 1)] = (u32)addr;
+}
+
+/**
+ * @brief Record the syscall @p name, called by @p lr, with its first
+ * 4 arguments @p argv.
+ */
+void flightrec_syscall(const char *name, const u32 *argv, u32 lr)
+{
+	struct fr_syscall *s;
+
+	if (!flightrec_enabled)
+		return;
+
+	s = &fr.sys[fr.nsys++ & (FR_SYSCALLS - 1)];
+	s->name    = name;
+	s->argv[0] = argv[0];
+	s->argv[1] = argv[1];
+	s->argv[2] = argv[2];
+	s->argv[3] = argv[3];
+	s->lr      = lr;
+	s->done    = 0;
+}
+
+/**
+ * @brief Record the return value of the last syscall.
+ */
+void flightrec_syscall_ret(u32 ret)
+{
+	struct fr_syscall *s;
+
+	if (!flightrec_enabled || !fr.nsys)
+		return;
+
+	s = &fr.sys[(fr.nsys - 1) & (FR_SYSCALLS - 1)];
+	if (s->done)
+		return;
+	s->ret  = ret;
+	s->done = 1;
+}
+
+/**
+ * @brief Record the loader event @p event of the module or symbol
+ * @p name (must outlive the program), at @p addr.
+ */
+void flightrec_loader(const char *event, const char *name, u32 addr)
+{
+	struct fr_loader *l;
+
+	if (!flightrec_enabled)
+		return;
+
+	l = &fr.ldr[fr.nldr++ & (FR_LOADER - 1)];
+	l->event = event;
+	l->name  = name;
+	l->addr  = addr;
+}
+
+/**
+ * @brief Get the index of the oldest entry still on a ring of @p size
+ * entries, with @p n entries ever recorded.
+ */
+static inline u64 first_entry(u64 n, u64 size) {
+	return (n > size) ? n - size : 0;
+}
+
+/**
+ * @brief Dump the rings (oldest first) on stderr, symbolized. Only the
+ * first call dumps, as a fault may be reported more than once.
+ */
+void flightrec_dump(void)
+{
+	const struct fr_syscall *s;
+	const struct fr_loader *l;
+	char sym[SYM_FORMAT_LEN];
+	u64 i;
+
+	if (!flightrec_enabled || fr.dumped)
+		return;
+	fr.dumped = 1;
+
+	if (!fr.nldr && !fr.nsys && !fr.nbbs)
+		return;
+
+	fprintf(stderr, "Flight recorder (oldest first):\n");
+
+	fprintf(stderr, "  Last loader events (%" PRIu64 " total):\n", fr.nldr);
+	for (i = first_entry(fr.nldr, FR_LOADER); i < fr.nldr; i++) {
+		l = &fr.ldr[i & (FR_LOADER - 1)];
+		fprintf(stderr, "    %-6s 0x%08x %s\n", l->event, l->addr, l->name);
+	}
+
+	fprintf(stderr, "  Last syscalls (%" PRIu64 " total):\n", fr.nsys);
+	for (i = first_entry(fr.nsys, FR_SYSCALLS); i < fr.nsys; i++) {
+		s = &fr.sys[i & (FR_SYSCALLS - 1)];
+		fprintf(stderr, "    %s(0x%x, 0x%x, 0x%x, 0x%x) = ", s->name,
+			s->argv[0], s->argv[1], s->argv[2], s->argv[3]);
+		if (s->done)
+			fprintf(stderr, "0x%x", s->ret);
+		else
+			fprintf(stderr, "?");
+		fprintf(stderr, ", from %s\n", sym_format(fr.uc, s->lr, sym,
+			sizeof sym));
+	}
+
+	if (!fr.blocks)
+		return;
+
+	fprintf(stderr, "  Last basic blocks (%" PRIu64 " total):\n", fr.nbbs);
+	for (i = first_entry(fr.nbbs, FR_BLOCKS); i < fr.nbbs; i++)
+		fprintf(stderr, "    %s\n", sym_format(fr.uc,
+			fr.bbs[i & (FR_BLOCKS - 1)], sym, sizeof sym));
+}
+
+/**
+ * @brief errx() hook (see util.h): dump the rings before exiting.
+ */
+void errx_hook(void)
+{
+	flightrec_dump();
+}
+
+/**
+ * @brief Enable the flight recorder, before loading the program.
+ *
+ * @param uc     Unicorn context.
+ * @param blocks Also record the last executed basic blocks.
+ */
+void flightrec_init(uc_engine *uc, int blocks)
+{
+	fr.uc = uc;
+	flightrec_enabled = 1;
+
+	if (!blocks)
+		return;
+	if (uc_hook_add(uc, &fr.hook, UC_HOOK_BLOCK, hook_block, NULL, 1, 0)) {
+		warn("Unable to add flight recorder block hook, ignoring it!\n");
+		return;
+	}
+	fr.blocks = 1;
+}
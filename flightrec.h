@@ -0,0 +1,34 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+/*
+ * Flight recorder: fixed-size rings with the last syscalls (name,
+ * arguments, caller and return value) and the last loader events.
+ * Recording is just a few stores into the rings, from handlers that
+ * already run anyway, so it is enabled by default (see --no-flightrec).
+ *
+ * The last executed basic blocks are only recorded with
+ * --flightrec-blocks: it takes a block hook, i.e., a call into the host
+ * on every block executed.
+ *
+ * The rings are dumped, symbolized, once: by register_dump() (i.e., on
+ * any guest fault) or by errx().
+ */
+
+#include "util.h"
+
+extern int flightrec_enabled;
+
+extern void flightrec_init(uc_engine *uc, int blocks);
+extern void flightrec_syscall(const char *name, const u32 *argv, u32 lr);
+extern void flightrec_syscall_ret(u32 ret);
+extern void flightrec_loader(const char *event, const char *name, u32 addr);
+extern void flightrec_dump(void);
+
+#endif /* FLIGHTREC_H */
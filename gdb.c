@@ -5,13 +5,21 @@
  */
 
 #include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unicorn/unicorn.h>
 
 #include "gdb.h"
+#include "insn_emu.h"
+#include "overhead.h"
+#include "stats.h"
+#include "timeline.h"
 
 /* GDB handle states. */
 #define GDB_STATE_START   0x1
@@ -32,23 +40,124 @@
 #define GDB(...)
 #endif
 
-/* Single-step hook. */
-static u32 break_pc       = 0;
+/*
+ * Breakpoints.
+ *
+ * Each breakpoint is a code hook restricted to its own address, so
+ * the remaining code runs without calling into the host at all.
+ */
+#define GDB_MAX_BREAKPOINTS 256
+static struct gdb_breakpoint {
+	u32 addr;
+	uc_hook hook;
+} breakpoints[GDB_MAX_BREAKPOINTS];
+static int nbreakpoints;
+
+/*
+ * Watchpoints.
+ *
+ * Each watchpoint is a memory hook restricted to the watched range, so
+ * accesses elsewhere keep running on Unicorn's fast path. Since Unicorn
+ * only checks the start address of an access against the hook range, the
+ * hook starts a few bytes earlier, and the callback checks for an actual
+ * overlap.
+ *
+ * A hit stops the emulation (uc_emu_stop()), and gdb_handle_stop() then
+ * reports it to GDB with the appropriate stop reason.
+ */
+#define GDB_MAX_WATCHPOINTS 32
+#define GDB_MAX_ACCESS_SIZE 8
+#define GDB_WP_WRITE  2
+#define GDB_WP_READ   3
+#define GDB_WP_ACCESS 4
+static struct gdb_watchpoint {
+	u32 addr;
+	u32 len;      /* 0 means free slot. */
+	int type;
+	uc_hook hook;
+} watchpoints[GDB_MAX_WATCHPOINTS];
+
+/* Last watchpoint hit (if any), reported on the next stop. */
+static int wp_hit_type;
+static u32 wp_hit_addr;
+
+/* Stop reason, as sent to GDB. */
+static char   halt_reason[32] = "S05";
+static size_t halt_reason_len = 3;
+
+/*
+ * Single-step hook.
+ *
+ * The single-step hook covers the entire address space, and thus, it
+ * only exists while GDB is stepping: it is added on 's' and removed on
+ * 'c'. Since the execution resumes at the instruction that stopped,
+ * 'ss_skip_pc' avoids stopping twice at the same address.
+ */
 static int in_single_step = 1;
+static int ss_active;
+static int ss_skip;
+static u32 ss_skip_pc;
+
+/*
+ * Hooks added (or translated blocks flushed) while stopped inside a
+ * hook: the block being executed does not see them, so the emulation
+ * is stopped and resumed from the main loop, at the same address (see
+ * resume_from_main_loop()).
+ */
+static int retranslate;
+static int resume_pending;
+static u32 resume_pc;
 static uc_hook uc_hook_ss;
-static void single_step(uc_engine *uc, uint32_t addr, uint32_t size,
+static void single_step(uc_engine *uc, uint64_t addr, uint32_t size,
 	void *user_data);
+static void gdb_stop(uc_engine *uc, u32 addr);
+static void resume_from_main_loop(uc_engine *uc, u32 addr);
 
 /* aix-user gdb stub. */
 static int sv_fd;
 static int cl_fd = -1;
 
-/* The registers are cached, so this flag signals
- * if the cache is updated or not. */
-static int have_ppc_regs = 0;
+/*
+ * Attach mode (-a).
+ *
+ * The guest runs at full speed while a watcher thread polls the server
+ * socket (and the client, once connected). On a new connection or on a
+ * Ctrl+C, it calls uc_emu_stop() and the main loop (see gdb_handle_stop())
+ * hands the control to GDB.
+ *
+ * 'vm_running' tells whether the guest is running (and then, the watcher
+ * owns the sockets) or stopped in GDB (the main thread owns them).
+ * 'stop_pending' is set when the watcher stops the emulation, and
+ * 'stop_serviced' if a hook already stopped in GDB in the meantime.
+ *
+ * A GDB detach (or disconnect) removes every breakpoint, watchpoint and
+ * the single-step hook, and the guest keeps running until the next
+ * connection.
+ */
+static pthread_t       watcher_thread;
+static pthread_mutex_t watcher_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  watcher_cond = PTHREAD_COND_INITIALIZER;
+static uc_engine *watcher_uc;
+static int attach_mode;
+static int vm_running;
+static int stop_pending;
+static int stop_serviced;
+
+/*
+ * Maximum packet size we accept (advertised on qSupported).
+ * Big packets allow GDB to transfer large memory areas with just a
+ * few round trips.
+ */
+#define GDB_PACKET_SIZE 0x20000
 
-/* Memory dump helpers. */
-static uint8_t *dump_buffer;
+/*
+ * Largest memory read whose reply fits in a packet, framing ('$', '#'
+ * and checksum) included: 'm' sends two hex digits per byte, and 'x'
+ * sends a 'b' prefix and, at worst, every byte escaped.
+ */
+#define GDB_PACKET_FRAMING 4
+#define GDB_MAX_READ_HEX   ((GDB_PACKET_SIZE - GDB_PACKET_FRAMING) / 2)
+#define GDB_MAX_READ_BIN   ((GDB_PACKET_SIZE - GDB_PACKET_FRAMING - 1) / 2)
 
 /*
  * Keeps all the variables for the GDB state machine here
@@ -58,9 +167,9 @@ struct gdb_handle
 	int  state;
 	int  csum;
 	int  cmd_idx;
-	char buff[32];
+	char buff[4096];
 	char csum_read[3];
-	char cmd_buff[512];
+	char cmd_buff[GDB_PACKET_SIZE + 1];
 } gdb_handle = {
 	.state = GDB_STATE_START
 };
@@ -137,12 +246,17 @@ void setup_server(int *srv_fd, uint16_t port)
  * MISC                                                              *
  * ------------------------------------------------------------------*/
 /**
- * Global buffer, responsible to handle dynamic allocations
- * from/to GDB messages.
+ * Global transfer buffer, responsible to handle all the data from/to
+ * GDB messages. Allocated once (with room for the largest possible
+ * hex-encoded packet) and reused for every request.
  */
 static char  *gbuffer      = NULL;
 static size_t gbuffer_size = 0;
 
+/* Hex codec tables. */
+static char hex_digits[256][2];
+static s8   hex_values[256];
+
 /**
  * @brief Increase the global buffer size to a new value
  * if needed.
@@ -162,85 +276,128 @@ static void increase_buffer(size_t new_size)
 }
 
 /**
- * @brief For a given nibble, to converts to its
- * ascii representative form, ie: 10 -> a.
- *
- * @param nibble Nibble input value to be converted.
- *
- * @return Returns the converted value.
- */
-static inline char to_digit(int nibble) {
-	static const char digits[] = "0123456789abcdef";
-	return (digits[nibble]);
-}
-
-/**
- * @brief For a given nibble (in its char form),
- * convert to the decimal representation, i.e:
- * 'b' -> 11.
- *
- * @param ch Char nibble to be converted.
- *
- * @return Returns the converted value.
+ * @brief Initialize the hex codec tables, i.e: the two ascii digits
+ * for each byte value and the value for each ascii hex digit (or -1
+ * if not a hex digit).
  */
-static inline int to_value(int ch)
+static void hex_tables_init(void)
 {
-	int c = tolower(ch);
+	static const char digits[] = "0123456789abcdef";
+	int i;
 
-	if (c >= '0' && c <= '9')
-		return (c - '0');
-	else if (c >= 'a' && c <= 'f')
-		return (0xA + c - 'a');
-	else
-		return (-1);
+	for (i = 0; i < 256; i++) {
+		hex_digits[i][0] = digits[i >> 4];
+		hex_digits[i][1] = digits[i & 0xF];
+		hex_values[i]    = -1;
+	}
+	for (i = 0; i < 10; i++)
+		hex_values['0' + i] = i;
+	for (i = 0; i < 6; i++) {
+		hex_values['a' + i] = 0xA + i;
+		hex_values['A' + i] = 0xA + i;
+	}
 }
 
 /**
  * @brief Encodes a binary data inside @p data to its representative form in
  * ascii hex value.
  *
+ * @param out  Output buffer, must have room for 2 * @p len bytes.
  * @param data Data to be encoded in ascii-hex form.
  * @param len  Length of @p data.
  *
- * @return Returns a buffer containing the encoded buffer.
+ * @return Returns the amount of bytes written into @p out.
  *
- * @note Please note that the size of the output
- * buffer is twice bigger than the input buffer.
+ * @note @p data might live inside @p out, as long as it starts at
+ * out + len or later: each input byte is always read before its
+ * position is overwritten.
  */
-char *encode_hex(const char *data, size_t len)
+static size_t encode_hex(char *out, const u8 *data, size_t len)
 {
-	char *tmp;
 	size_t i;
+	u8 b;
 
-	increase_buffer(len * 2);
-	for (i = 0, tmp = gbuffer; i < len; i++) {
-		*tmp++ = to_digit((data[i] >> 4) & 0xF);
-		*tmp++ = to_digit((data[i]     ) & 0xF);
+	for (i = 0; i < len; i++) {
+		b = data[i];
+		*out++ = hex_digits[b][0];
+		*out++ = hex_digits[b][1];
 	}
-	return (gbuffer);
+	return (len * 2);
 }
 
 /**
  * @brief Converts an input buffer containing an ascii hex-value representation
  * into the equivalent binary form.
  *
+ * @param out  Output buffer, must have room for @p len bytes.
  * @param data Input buffer to be decoded to binary.
- * @param len  Input buffer length.
+ * @param len  Amount of bytes to be decoded (input have 2 * @p len chars).
  *
- * @return Returns the buffer containing the binary representation of the data.
+ * @return Returns 0 if success, -1 if any invalid hex digit was found.
  */
-char *decode_hex(const char *data, size_t len)
+static int decode_hex(u8 *out, const char *data, size_t len)
 {
-	char *ptr;
 	size_t i;
+	s8 hi, lo;
+
+	for (i = 0; i < len; i++) {
+		hi = hex_values[(u8)data[i * 2]];
+		lo = hex_values[(u8)data[i * 2 + 1]];
+		if (hi < 0 || lo < 0)
+			return (-1);
+		out[i] = (hi << 4) | lo;
+	}
+	return (0);
+}
+
+/**
+ * @brief Escapes a binary buffer @p data as expected by the GDB remote
+ * protocol, i.e: '#', '$', '}' and '*' are sent as '}' followed by the
+ * original byte XOR 0x20.
+ *
+ * @param out  Output buffer, must have room for 2 * @p len bytes.
+ * @param data Binary data to be escaped.
+ * @param len  Length of @p data.
+ *
+ * @return Returns the amount of bytes written into @p out.
+ */
+static size_t escape_binary(char *out, const u8 *data, size_t len)
+{
+	size_t i, j;
+	u8 b;
+
+	for (i = 0, j = 0; i < len; i++) {
+		b = data[i];
+		if (b == '#' || b == '$' || b == '}' || b == '*') {
+			out[j++] = '}';
+			out[j++] = b ^ 0x20;
+		} else
+			out[j++] = b;
+	}
+	return (j);
+}
 
-	increase_buffer(len);
-	for (i = 0, ptr = gbuffer; i < len * 2; i += 2, ptr++) {
-		*ptr =  to_value(data[i]);
-		*ptr <<= 4;
-		*ptr |= to_value(data[i+1]);
+/**
+ * @brief Undo the escaping of binary data sent by GDB (see
+ * escape_binary()).
+ *
+ * @param out  Output buffer, might be the same as @p data.
+ * @param data Escaped binary data.
+ * @param len  Length of @p data.
+ *
+ * @return Returns the amount of bytes written into @p out.
+ */
+static size_t unescape_binary(u8 *out, const char *data, size_t len)
+{
+	size_t i, j;
+
+	for (i = 0, j = 0; i < len; i++, j++) {
+		if (data[i] == '}' && i + 1 < len)
+			out[j] = data[++i] ^ 0x20;
+		else
+			out[j] = data[i];
 	}
-	return (gbuffer);
+	return (j);
 }
 
 /* ------------------------------------------------------------------*
@@ -261,24 +418,47 @@ char *decode_hex(const char *data, size_t len)
  */
 static ssize_t send_gdb_cmd(const char *buff, size_t len)
 {
-	size_t i;
-	int csum;
-	ssize_t ret;
+	struct iovec iov[3];
 	char csum_str[3];
+	size_t i, total;
+	ssize_t ret;
+	u8 csum;
 
 	/* Calculate checksum. */
 	for (i = 0, csum = 0; i < len; i++)
-		csum += buff[i];
-	csum &= 0xFF;
-
-	send_all(cl_fd, "$", 1);
-	send_all(cl_fd, buff, len);
-	send_all(cl_fd, "#", 1);
-	snprintf(csum_str, 3, "%02x", csum);
-	ret = send_all(cl_fd, csum_str, 2);
-
-	if (ret < 0)
-		errx(1, "Unable to send command to GDB!\n");
+		csum += (u8)buff[i];
+
+	csum_str[0] = '#';
+	csum_str[1] = hex_digits[csum][0];
+	csum_str[2] = hex_digits[csum][1];
+
+	/* Send the entire packet at once. */
+	iov[0].iov_base = "$";
+	iov[0].iov_len  = 1;
+	iov[1].iov_base = (void *)buff;
+	iov[1].iov_len  = len;
+	iov[2].iov_base = csum_str;
+	iov[2].iov_len  = 3;
+	total = len + 4;
+
+	while (total) {
+		ret = writev(cl_fd, iov, 3);
+		if (ret <= 0)
+			errx(1, "Unable to send command to GDB!\n");
+
+		/* Partial write, skip what was already sent. */
+		total -= ret;
+		for (i = 0; i < 3 && ret; i++) {
+			if ((size_t)ret >= iov[i].iov_len) {
+				ret -= iov[i].iov_len;
+				iov[i].iov_len = 0;
+			} else {
+				iov[i].iov_base = (char *)iov[i].iov_base + ret;
+				iov[i].iov_len -= ret;
+				ret = 0;
+			}
+		}
+	}
 
 	return (0);
 }
@@ -323,7 +503,7 @@ static inline void send_gdb_error(void) {
  * @brief Send the halt reason to GDB.
  */
 static inline void send_gdb_halt_reason(void) {
-	send_gdb_cmd("S05", 3);
+	send_gdb_cmd(halt_reason, halt_reason_len);
 }
 
 /* ------------------------------------------------------------------*
@@ -353,22 +533,26 @@ union ppc_regs {
 	u8   u8_vals[PPC_REGS_AMNT*4];
 } ppcregs = {0};
 
+/* Pointers to each ppcregs entry, for uc_reg_read_batch(). */
+static void *ppcregs_ptrs[PPC_REGS_AMNT];
+
 /**
  * @brief Handle he 'read registers (g)' command from GDB.
  *
+ * The entire register file is read with a single uc_reg_read_batch().
+ *
  * @param uc Unicorn engine context.
  */
 static void handle_gdb_read_registers(uc_engine *uc)
 {
-	void *ptr_vals[PPC_REGS_AMNT] = {0};
-	char *buff;
-	int   i;
-
-	for (i = 0; i < PPC_REGS_AMNT; i++)
-		ptr_vals[i] = &ppcregs.u32_vals[i];
+	size_t len;
+	int i;
 
-	if (uc_reg_read_batch(uc, regs_to_be_read, ptr_vals, PPC_REGS_AMNT) < 0) {
+	if (uc_reg_read_batch(uc, regs_to_be_read, ppcregs_ptrs,
+		PPC_REGS_AMNT))
+	{
 		warn("Unable to read GPRs...\n");
+		send_gdb_error();
 		return;
 	}
 
@@ -376,12 +560,40 @@ static void handle_gdb_read_registers(uc_engine *uc)
 	for (i = 0; i < PPC_REGS_AMNT; i++)
 		ppcregs.u32_vals[i] = htonl(ppcregs.u32_vals[i]);
 
-	buff = encode_hex((const char*) ppcregs.u8_vals, sizeof ppcregs);
-	send_gdb_cmd(buff, sizeof(ppcregs) * 2);
+	len = encode_hex(gbuffer, ppcregs.u8_vals, sizeof ppcregs);
+	send_gdb_cmd(gbuffer, len);
+}
+
+/**
+ * @brief Parse the 'addr,length' part common to the memory packets
+ * (m, M, x, X), and validate the length against our packet size.
+ *
+ * @param ptr  Buffer pointing to the address, it is updated to point
+ *             right after the length.
+ * @param len  Buffer length, also updated.
+ * @param addr Parsed address.
+ * @param amnt Parsed length.
+ *
+ * @return Returns 0 if valid, -1 otherwise.
+ */
+static int parse_mem_range(const char **ptr, size_t *len, u32 *addr,
+	u32 *amnt)
+{
+	*addr = read_int(*ptr, len, ptr, 16);
+	if (**ptr != ',')
+		return (-1);
+	(*ptr)++;
+	(*len)--;
+
+	*amnt = read_int(*ptr, len, ptr, 16);
+	if (*amnt > GDB_PACKET_SIZE)
+		return (-1);
+	return (0);
 }
 
 /**
- * @brief Handles the 'read memory (m)' command from GDB.
+ * @brief Handles the 'read memory' commands from GDB, whether the
+ * hex-encoded 'm' or the binary 'x'.
  *
  * @param uc   Unicorn engine context.
  * @param buff Message buffer to be parsed.
@@ -389,33 +601,32 @@ static void handle_gdb_read_registers(uc_engine *uc)
  *
  * @return Returns 0 if the request is valid, -1 otherwise.
  *
- * @note Please note that the actual memory read is
- * done by the serial device. This routine only parses
- * the command and forward the request to the serial
- * device.
+ * @note Guest memory is read into the end of the global transfer buffer,
+ * and then encoded (or escaped) into its beginning, so no extra buffer
+ * is needed.
  */
-static int handle_gdb_read_memory(uc_engine *uc, const char *mbuff, size_t len)
+static int handle_gdb_read_memory(uc_engine *uc, const char *buff, size_t len)
 {
-	static u8 *dump_buffer;
-	uint32_t addr, amnt;
 	const char *ptr;
-	char *dump_buff;
-	char *hexa_buff;
+	u32 addr, amnt;
+	size_t out_len;
+	int binary;
+	u8 *raw;
 
-	ptr = mbuff;
+	ptr    = buff;
+	binary = (*ptr == 'x');
 
-	/* Skip first 'm'. */
-	expect_char('m', ptr, len);
-	addr = read_int(ptr, &len, &ptr, 16);
-	expect_char(',', ptr, len);
+	/* Skip first 'm'/'x'. */
+	ptr++;
+	len--;
 
-	/* Get amount. */
-	amnt = simple_read_int(ptr, len, 16);
+	if (parse_mem_range(&ptr, &len, &addr, &amnt) < 0) {
+		send_gdb_error();
+		return -1;
+	}
 
-	/* */
-	dump_buff = malloc(amnt);
-	if (!dump_buff)
-		errx(1, "GDBStub: Unable to alloc %u bytes!\n", amnt);
+	/* Replies may be shorter than requested, GDB asks for the rest. */
+	amnt = MIN(amnt, binary ? GDB_MAX_READ_BIN : GDB_MAX_READ_HEX);
 
 	/*
 	 * For some reason, GDB insists on reading the addr 0x0
@@ -426,17 +637,87 @@ static int handle_gdb_read_memory(uc_engine *uc, const char *mbuff, size_t len)
 		return -1;
 	}
 
-	if (uc_mem_read(uc, addr, dump_buff, amnt)) {
+	raw = (u8 *)gbuffer + gbuffer_size - amnt;
+	if (uc_mem_read(uc, addr, raw, amnt)) {
 		warn("Unable to read from VM memory: 0x%08x\n", addr);
-		free(dump_buff);
 		send_gdb_error();
 		return -1;
 	}
 
-	hexa_buff = encode_hex(dump_buff, amnt);
-	send_gdb_cmd(hexa_buff, amnt * 2);
-	free(dump_buff);
+	/*
+	 * Binary reads are prefixed with 'b'. Since escaping might
+	 * expand the data, it only works in-place if the raw data
+	 * is far enough, which is always true as our buffer is three times
+	 * the packet size.
+	 */
+	if (binary) {
+		gbuffer[0] = 'b';
+		out_len    = escape_binary(gbuffer + 1, raw, amnt) + 1;
+	} else
+		out_len = encode_hex(gbuffer, raw, amnt);
+
+	send_gdb_cmd(gbuffer, out_len);
+	return 0;
+}
+
+/**
+ * @brief Handles the 'write memory' commands from GDB, whether the
+ * hex-encoded 'M' or the binary 'X'.
+ *
+ * @param uc   Unicorn engine context.
+ * @param buff Message buffer to be parsed.
+ * @param len  Buffer length.
+ *
+ * @return Returns 0 if the request is valid, -1 otherwise.
+ */
+static int handle_gdb_write_memory(uc_engine *uc, const char *buff, size_t len)
+{
+	const char *ptr;
+	u32 addr, amnt;
+	size_t data_len;
+	int binary;
+
+	ptr    = buff;
+	binary = (*ptr == 'X');
+
+	/* Skip first 'M'/'X'. */
+	ptr++;
+	len--;
+
+	if (parse_mem_range(&ptr, &len, &addr, &amnt) < 0) {
+		send_gdb_error();
+		return -1;
+	}
+	expect_char(':', ptr, len);
+
+	/* Data (if any) is everything until the end of the packet. */
+	data_len = buff + gdb_handle.cmd_idx - ptr;
+
+	if (binary) {
+		if (unescape_binary((u8 *)gbuffer, ptr, data_len) != amnt) {
+			send_gdb_error();
+			return -1;
+		}
+	} else {
+		if (data_len != (size_t)amnt * 2 ||
+			decode_hex((u8 *)gbuffer, ptr, amnt) < 0)
+		{
+			send_gdb_error();
+			return -1;
+		}
+	}
+
+	/* 'X' with length 0 is used by GDB to probe binary support. */
+	if (amnt && uc_mem_write(uc, addr, gbuffer, amnt)) {
+		warn("Unable to write to VM memory: 0x%08x\n", addr);
+		send_gdb_error();
+		return -1;
+	}
+
+	/* The decode cache might hold an instruction just overwritten. */
+	insn_emu_invalidate(addr, amnt);
 
+	send_gdb_ok();
 	return 0;
 }
 
@@ -462,6 +743,272 @@ static inline void handle_gdb_continue(uc_engine *uc, int *cont) {
 	*cont = 1;
 }
 
+/**
+ * @brief Unicorn hook callback for breakpoints.
+ *
+ * Since each breakpoint hook only covers its own address, this is only
+ * called when a breakpoint is actually hit.
+ *
+ * @param uc        Unicorn context.
+ * @param addr      Current instruction address.
+ * @param size      Instruction size.
+ * @param user_data User-defined data (unused).
+ */
+static void breakpoint_hit(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	((void)size);
+	((void)user_data);
+
+	OVH_COUNT(OVH_HOOK_GDB);
+
+	/* Single-step hook also stops here, no need to stop twice. */
+	if (ss_active)
+		return;
+
+	/* Resumed at the breakpoint that stopped. */
+	if (ss_skip) {
+		ss_skip = 0;
+		if (addr == ss_skip_pc)
+			return;
+	}
+
+	GDB("Breakpoint hit at 0x%08x\n", (u32)addr);
+	gdb_stop(uc, addr);
+	if (retranslate)
+		resume_from_main_loop(uc, addr);
+}
+
+/**
+ * @brief Find a breakpoint by its address.
+ *
+ * @param addr Breakpoint address.
+ *
+ * @return Returns the breakpoint index if found, -1 otherwise.
+ */
+static int find_breakpoint(u32 addr)
+{
+	int i;
+	for (i = 0; i < nbreakpoints; i++)
+		if (breakpoints[i].addr == addr)
+			return i;
+	return -1;
+}
+
+/**
+ * @brief Insert a breakpoint at @p addr, i.e., add a code hook that
+ * only covers @p addr.
+ *
+ * @param uc   Unicorn engine context.
+ * @param addr Breakpoint address.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int insert_breakpoint(uc_engine *uc, u32 addr)
+{
+	struct gdb_breakpoint *bp;
+
+	/* GDB might insert the same breakpoint more than once. */
+	if (find_breakpoint(addr) >= 0)
+		return 0;
+
+	if (nbreakpoints >= GDB_MAX_BREAKPOINTS) {
+		warn("Too many breakpoints (max: %d)!\n", GDB_MAX_BREAKPOINTS);
+		return -1;
+	}
+
+	bp = &breakpoints[nbreakpoints];
+	if (uc_hook_add(uc, &bp->hook, UC_HOOK_CODE, breakpoint_hit, NULL,
+		addr, addr))
+	{
+		warn("Unable to add breakpoint hook at 0x%08x\n", addr);
+		return -1;
+	}
+
+	/* Already translated code do not know about the new hook. */
+	uc_ctl_remove_cache(uc, addr, addr + 4);
+	retranslate = 1;
+
+	bp->addr = addr;
+	nbreakpoints++;
+	return 0;
+}
+
+/**
+ * @brief Remove a previously inserted breakpoint at @p addr.
+ *
+ * @param uc   Unicorn engine context.
+ * @param addr Breakpoint address.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int remove_breakpoint(uc_engine *uc, u32 addr)
+{
+	int idx;
+
+	idx = find_breakpoint(addr);
+	if (idx < 0)
+		return 0;
+
+	uc_hook_del(uc, breakpoints[idx].hook);
+	uc_ctl_remove_cache(uc, addr, addr + 4);
+
+	breakpoints[idx] = breakpoints[--nbreakpoints];
+	return 0;
+}
+
+/**
+ * @brief Unicorn hook callback for watchpoints.
+ *
+ * @param uc        Unicorn context.
+ * @param type      Memory access type.
+ * @param address   Accessed address.
+ * @param size      Access size.
+ * @param value     Written value (unused).
+ * @param user_data Watchpoint that owns this hook.
+ */
+static void watchpoint_hit(uc_engine *uc, uc_mem_type type, uint64_t address,
+	int size, int64_t value, void *user_data)
+{
+	struct gdb_watchpoint *wp = user_data;
+	((void)value);
+
+	OVH_COUNT(OVH_HOOK_GDB);
+
+	/* Hook range is a bit larger than the watched range. */
+	if (address + size <= wp->addr || address >= (u64)wp->addr + wp->len)
+		return;
+
+	/* Keep the first hit only, the emulation is stopping anyway. */
+	if (wp_hit_type)
+		return;
+
+	GDB("Watchpoint hit at 0x%08x (%s)\n", (u32)address,
+		(type == UC_MEM_WRITE) ? "write" : "read");
+
+	/*
+	 * Report an address inside the watched range, as the access might
+	 * start before it: otherwise GDB can't tell which watchpoint hit.
+	 */
+	wp_hit_type = wp->type;
+	wp_hit_addr = max((u32)address, wp->addr);
+
+	pthread_mutex_lock(&watcher_lock);
+	stop_pending  = 1;
+	stop_serviced = 0;
+	pthread_mutex_unlock(&watcher_lock);
+	uc_emu_stop(uc);
+}
+
+/**
+ * @brief Find a watchpoint by its address, length and type.
+ *
+ * @param addr Watchpoint address.
+ * @param len  Watched length.
+ * @param type Watchpoint type (GDB_WP_*).
+ *
+ * @return Returns the watchpoint index if found, -1 otherwise.
+ */
+static int find_watchpoint(u32 addr, u32 len, int type)
+{
+	int i;
+	for (i = 0; i < GDB_MAX_WATCHPOINTS; i++) {
+		if (watchpoints[i].len && watchpoints[i].addr == addr &&
+			watchpoints[i].len == len &&
+			watchpoints[i].type == type)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Insert a watchpoint for the range @p addr to @p addr + @p len,
+ * i.e., add a memory read and/or write hook that only covers this range.
+ *
+ * @param uc   Unicorn engine context.
+ * @param addr Watchpoint address.
+ * @param len  Watched length.
+ * @param type Watchpoint type (GDB_WP_*).
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int insert_watchpoint(uc_engine *uc, u32 addr, u32 len, int type)
+{
+	struct gdb_watchpoint *wp;
+	int hook_type;
+	u32 begin;
+
+	if (!len)
+		return -1;
+
+	if (find_watchpoint(addr, len, type) >= 0)
+		return 0;
+
+	/* Find a free slot. */
+	for (wp = watchpoints; wp < watchpoints + GDB_MAX_WATCHPOINTS; wp++)
+		if (!wp->len)
+			break;
+
+	if (wp == watchpoints + GDB_MAX_WATCHPOINTS) {
+		warn("Too many watchpoints (max: %d)!\n", GDB_MAX_WATCHPOINTS);
+		return -1;
+	}
+
+	if (type == GDB_WP_WRITE)
+		hook_type = UC_HOOK_MEM_WRITE;
+	else if (type == GDB_WP_READ)
+		hook_type = UC_HOOK_MEM_READ;
+	else
+		hook_type = UC_HOOK_MEM_READ|UC_HOOK_MEM_WRITE;
+
+	begin = (addr >= GDB_MAX_ACCESS_SIZE - 1) ?
+		addr - (GDB_MAX_ACCESS_SIZE - 1) : 0;
+
+	/* Hook 'user_data' points to its own (fixed) slot. */
+	if (uc_hook_add(uc, &wp->hook, hook_type, watchpoint_hit, wp,
+		begin, addr + len - 1))
+	{
+		warn("Unable to add watchpoint hook at 0x%08x\n", addr);
+		return -1;
+	}
+
+	/* Translated code might have the memory accesses inlined. */
+	uc_ctl_flush_tb(uc);
+	retranslate = 1;
+
+	wp->addr = addr;
+	wp->len  = len;
+	wp->type = type;
+	return 0;
+}
+
+/**
+ * @brief Remove a previously inserted watchpoint.
+ *
+ * @param uc   Unicorn engine context.
+ * @param addr Watchpoint address.
+ * @param len  Watched length.
+ * @param type Watchpoint type (GDB_WP_*).
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int remove_watchpoint(uc_engine *uc, u32 addr, u32 len, int type)
+{
+	int idx;
+
+	idx = find_watchpoint(addr, len, type);
+	if (idx < 0)
+		return 0;
+
+	uc_hook_del(uc, watchpoints[idx].hook);
+	uc_ctl_flush_tb(uc);
+
+	watchpoints[idx].len = 0;
+	return 0;
+}
+
 /**
  * @brief Handles the 'add breakpoint (Zn)' command from GDB.
  *
@@ -477,6 +1024,7 @@ static int handle_gdb_add_breakpoint(uc_engine *uc, const char *buff, size_t len
 {
 	const char *ptr = buff;
 	u32 addr;
+	u32 kind;
 
 	/* Skip 'Z0'. */
 	expect_char('Z', ptr, len);
@@ -487,6 +1035,9 @@ static int handle_gdb_add_breakpoint(uc_engine *uc, const char *buff, size_t len
 	addr = read_int(ptr, &len, &ptr, 16);
 	expect_char(',', ptr, len);
 
+	/* Kind: for watchpoints, the watched length. */
+	kind = read_int(ptr, &len, &ptr, 16);
+
 	GDB("Adding breakpoint at 0x%08x\n", addr);
 
 	/*
@@ -501,19 +1052,21 @@ static int handle_gdb_add_breakpoint(uc_engine *uc, const char *buff, size_t len
 	 */
 	case '0':
 	case '1':
-		break_pc = addr;
+		if (insert_breakpoint(uc, addr) < 0) {
+			send_gdb_error();
+			return (-1);
+		}
 		break;
 	/* Write watchpoint. */
 	case '2':
-		send_gdb_unsupported_msg();
-		break;
 	/* Read watchpoint. */
 	case '3':
-		send_gdb_unsupported_msg();
-		break;
 	/* Access (Read/Write) watchpoint. */
 	case '4':
-		send_gdb_unsupported_msg();
+		if (insert_watchpoint(uc, addr, kind, buff[1] - '0') < 0) {
+			send_gdb_error();
+			return (-1);
+		}
 		break;
 	}
 
@@ -534,8 +1087,7 @@ handle_gdb_remove_breakpoint(uc_engine *uc, const char *buff, size_t len)
 {
 	const char *ptr = buff;
 	u32 addr;
-
-	((void)addr);
+	u32 kind;
 
 	/* Skip 'z0'. */
 	expect_char('z', ptr, len);
@@ -546,27 +1098,29 @@ handle_gdb_remove_breakpoint(uc_engine *uc, const char *buff, size_t len)
 	addr = read_int(ptr, &len, &ptr, 16);
 	expect_char(',', ptr, len);
 
+	/* Kind: for watchpoints, the watched length. */
+	kind = read_int(ptr, &len, &ptr, 16);
+
 	GDB("Removing breakpoint at 0x%08x\n", addr);
 
 	/*
 	 * Check which type of breakpoint we have and act
 	 * accordingly.
-	 *
-	 * Since we only support 1 instruction (ATM) and 1
-	 * data breakpoint, there is no need to check
-	 * address and etc...
 	 */
 	switch (buff[1]) {
 	/* Instruction break. */
 	case '0':
 	case '1':
-		break_pc = 0;
+		remove_breakpoint(uc, addr);
 		break;
-	/* Remaining. */
+	/* Watchpoints Write, Read, Access(R/W). */
 	case '2':
 	case '3':
 	case '4':
-		/* Watchpoints Write, Read, Access(R/W): ignore for now. */
+		if (remove_watchpoint(uc, addr, kind, buff[1] - '0') < 0) {
+			send_gdb_error();
+			return (-1);
+		}
 		break;
 	}
 
@@ -590,10 +1144,14 @@ static int handle_gdb_query_packets(uc_engine *uc, const char *cmd_buff,
 	char *response_buff;
 	const char *ptr;
 	size_t xml_size;
+	int ret;
 
 	/* Handle 'qSupported' - advertise our capabilities. */
 	if (strncmp(cmd_buff, "qSupported", 10) == 0) {
-		send_gdb_cmd("qXfer:features:read+", 20);
+		ret = snprintf(gbuffer, gbuffer_size,
+			"PacketSize=%x;qXfer:features:read+;binary-upload+",
+			GDB_PACKET_SIZE);
+		send_gdb_cmd(gbuffer, ret);
 		return 0;
 	}
 
@@ -618,10 +1176,9 @@ static int handle_gdb_query_packets(uc_engine *uc, const char *cmd_buff,
 
 		chunk_size = MIN(length, xml_size - offset);
 
-		/* Allocate response buffer: 'm'/'l' prefix + chunk. */
-		response_buff = malloc(chunk_size + 1);
-		if (!response_buff)
-			errx(1, "GDBStub: Unable to alloc %u bytes!\n", chunk_size + 1);
+		/* Response buffer: 'm'/'l' prefix + chunk. */
+		chunk_size    = MIN(chunk_size, GDB_PACKET_SIZE - 1);
+		response_buff = gbuffer;
 
 		/* Build response: 'm' for more data, 'l' for last chunk. */
 		if (offset + chunk_size < xml_size)
@@ -634,7 +1191,6 @@ static int handle_gdb_query_packets(uc_engine *uc, const char *cmd_buff,
 
 		/* Send via standard function. */
 		send_gdb_cmd(response_buff, chunk_size + 1);
-		free(response_buff);
 		return 0;
 	}
 
@@ -643,6 +1199,40 @@ static int handle_gdb_query_packets(uc_engine *uc, const char *cmd_buff,
 	return 0;
 }
 
+/**
+ * @brief Detach from GDB: remove all breakpoints, watchpoints and the
+ * single-step hook, close the client connection and let the guest run.
+ *
+ * @param uc   Unicorn engine context.
+ * @param cont Signals that the execution must proceed.
+ */
+static void gdb_detach(uc_engine *uc, int *cont)
+{
+	int i;
+
+	GDB("GDB detached, resuming...\n");
+
+	while (nbreakpoints)
+		remove_breakpoint(uc, breakpoints[0].addr);
+
+	for (i = 0; i < GDB_MAX_WATCHPOINTS; i++) {
+		if (!watchpoints[i].len)
+			continue;
+		uc_hook_del(uc, watchpoints[i].hook);
+		watchpoints[i].len = 0;
+	}
+	uc_ctl_flush_tb(uc);
+	wp_hit_type = 0;
+
+	/* The single-step hook is removed by update_single_step(). */
+	in_single_step = 0;
+
+	close(cl_fd);
+	cl_fd = -1;
+	gdb_handle.state = GDB_STATE_START;
+	*cont = 1;
+}
+
 /**
  * @brief Generic handler for all GDB commands/packets.
  *
@@ -678,9 +1268,15 @@ static int handle_gdb_cmd(uc_engine *uc, struct gdb_handle *gh, int *cont)
 	case 'g':
 		handle_gdb_read_registers(uc);
 		break;
-	/* Read memory. */
+	/* Read memory (hex/binary). */
 	case 'm':
-		handle_gdb_read_memory(uc, gh->cmd_buff, sizeof gh->cmd_buff);
+	case 'x':
+		handle_gdb_read_memory(uc, gh->cmd_buff, gh->cmd_idx);
+		break;
+	/* Write memory (hex/binary). */
+	case 'M':
+	case 'X':
+		handle_gdb_write_memory(uc, gh->cmd_buff, gh->cmd_idx);
 		break;
 	/* Halt reason. */
 	case '?':
@@ -688,7 +1284,7 @@ static int handle_gdb_cmd(uc_engine *uc, struct gdb_handle *gh, int *cont)
 		break;
 	/* Query packets. */
 	case 'q':
-		handle_gdb_query_packets(uc, gh->cmd_buff, sizeof gh->cmd_buff);
+		handle_gdb_query_packets(uc, gh->cmd_buff, gh->cmd_idx);
 		break;
 	/* Single-step. */
 	case 's':
@@ -698,13 +1294,18 @@ static int handle_gdb_cmd(uc_engine *uc, struct gdb_handle *gh, int *cont)
 	case 'c':
 		handle_gdb_continue(uc, cont);
 		break;
+	/* Detach. */
+	case 'D':
+		send_gdb_ok();
+		gdb_detach(uc, cont);
+		break;
 	/* Insert breakpoint. */
 	case 'Z':
-		handle_gdb_add_breakpoint(uc, gh->cmd_buff, sizeof gh->cmd_buff);
+		handle_gdb_add_breakpoint(uc, gh->cmd_buff, gh->cmd_idx);
 		break;
 	/* Remove breakpoint. */
 	case 'z':
-		handle_gdb_remove_breakpoint(uc, gh->cmd_buff, sizeof gh->cmd_buff);
+		handle_gdb_remove_breakpoint(uc, gh->cmd_buff, gh->cmd_idx);
 		break;
 	/* Not-supported messages. */
 	default:
@@ -745,7 +1346,6 @@ static void handle_gdb_state_start(struct gdb_handle *gh,
 		return;
 
 	gh->state   = GDB_STATE_CMD;
-	memset(gh->cmd_buff, 0, sizeof gh->cmd_buff);
 	gh->csum    = 0;
 	gh->cmd_idx = 0;
 }
@@ -802,13 +1402,14 @@ static
 inline void handle_gdb_state_cmd(struct gdb_handle *gh, uint8_t curr_byte)
 {
 	if (curr_byte == '#') {
+		gh->cmd_buff[gh->cmd_idx] = '\0';
 		gh->state = GDB_STATE_CSUM_D1;
 		return;
 	}
 	gh->csum += curr_byte;
 
 	/* Emit a warning if command exceeds buffer size. */
-	if ((size_t)gh->cmd_idx > sizeof gh->cmd_buff - 2)
+	if ((size_t)gh->cmd_idx >= sizeof gh->cmd_buff - 1)
 		errx(1, "Command exceeds buffer size (%zu): %s\n",
 			sizeof gh->cmd_buff, gh->cmd_buff);
 
@@ -831,10 +1432,15 @@ void handle_gdb_msg(uc_engine *uc, uint32_t addr, uint32_t size, int *cont)
 	uint8_t curr_byte;
 
 	ret = recv(cl_fd, gdb_handle.buff, sizeof gdb_handle.buff, 0);
-	if (ret <= 0)
-		errx(1, "GDB closed!\n");
+	if (ret <= 0) {
+		/* Attach mode: keep the guest running, and wait for GDB again. */
+		if (!attach_mode)
+			errx(1, "GDB closed!\n");
+		gdb_detach(uc, cont);
+		return;
+	}
 
-	for (i = 0; i < ret; i++) {
+	for (i = 0; i < ret && cl_fd >= 0; i++) {
 		curr_byte = gdb_handle.buff[i] & 0xFF;
 
 		switch (gdb_handle.state) {
@@ -859,29 +1465,73 @@ void handle_gdb_msg(uc_engine *uc, uint32_t addr, uint32_t size, int *cont)
 }
 
 /**
- * @brief Unicorn hook callback for single-step debugging and breakpoints.
- *
- * Pauses execution at each instruction when in single-step mode or when a
- * breakpoint is hit. Handles GDB client connection and message processing
- * during the pause.
+ * @brief Add or remove the single-step hook, accordingly with the last
+ * command received from GDB.
  *
- * @param uc        Unicorn context.
- * @param addr      Current instruction address.
- * @param size      Instruction size.
- * @param user_data User-defined data (unused).
+ * @param uc   Unicorn context.
+ * @param addr Current instruction address.
  */
-static void single_step(uc_engine *uc, uint32_t addr, uint32_t size,
-	void *user_data)
+static void update_single_step(uc_engine *uc, u32 addr)
 {
-	int cont = 0;
-	((void)user_data);
+	/* Stepping: add the hook, if not already. */
+	if (in_single_step && !ss_active) {
+		if (uc_hook_add(uc, &uc_hook_ss, UC_HOOK_CODE, single_step, NULL, 1, 0))
+			errx(1, "Unable to add single-step hook!\n");
+
+		/* Translated blocks must see the new hook. */
+		uc_ctl_flush_tb(uc);
+		retranslate = 1;
+		ss_active   = 1;
+		ss_skip     = 1;
+		ss_skip_pc  = addr;
+	}
 
-	/* If not in single-step or if PC do not matches a previous
-	 * added breakpoint, just return. */
-	if (!in_single_step && addr != break_pc)
-		return;
+	/* Continuing: single-step hook is not needed anymore. */
+	else if (!in_single_step && ss_active) {
+		uc_hook_del(uc, uc_hook_ss);
+		uc_ctl_flush_tb(uc);
+		ss_active = 0;
+	}
+}
 
-	GDB("Hook triggered at 0x%08x\n", addr);
+/**
+ * @brief Stop the execution at @p addr and hand the control to GDB,
+ * until GDB asks to continue or to step.
+ *
+ * Handles GDB client connection and message processing during the pause.
+ *
+ * @param uc   Unicorn context.
+ * @param addr Current instruction address.
+ */
+static void gdb_stop(uc_engine *uc, u32 addr)
+{
+	int cont = 0;
+	u64 start;
+
+	GDB("Stopped at 0x%08x\n", addr);
+	start = timeline_enabled ? stats_now_ns() : 0;
+	OVH_BEGIN(OVH_PAUSE);
+	retranslate = 0;
+
+	/* Take the sockets from the watcher. */
+	pthread_mutex_lock(&watcher_lock);
+	vm_running = 0;
+	if (stop_pending)
+		stop_serviced = 1;
+	pthread_mutex_unlock(&watcher_lock);
+
+	/* Stop reason: watchpoint or a simple trap. */
+	if (wp_hit_type) {
+		halt_reason_len = snprintf(halt_reason, sizeof halt_reason,
+			"T05%s:%08x;",
+			(wp_hit_type == GDB_WP_WRITE) ? "watch" :
+			(wp_hit_type == GDB_WP_READ)  ? "rwatch" : "awatch",
+			wp_hit_addr);
+		wp_hit_type = 0;
+	} else {
+		memcpy(halt_reason, "S05", 4);
+		halt_reason_len = 3;
+	}
 
 	if (cl_fd >= 0)
 		send_gdb_halt_reason();
@@ -893,32 +1543,226 @@ static void single_step(uc_engine *uc, uint32_t addr, uint32_t size,
 				errx(1, "Failed to accept client connection!\n");
 		}
 		else {
-			handle_gdb_msg(uc, addr, size, &cont);
+			handle_gdb_msg(uc, addr, 0, &cont);
 		}
 	}
+
+	update_single_step(uc, addr);
+
+	OVH_END();
+	if (timeline_enabled)
+		timeline_slice(TL_GDB, "gdb pause", NULL, start,
+			stats_now_ns() - start, &addr, 1);
+
+	/* Back to running, the watcher can poll again. */
+	pthread_mutex_lock(&watcher_lock);
+	vm_running = 1;
+	pthread_cond_signal(&watcher_cond);
+	pthread_mutex_unlock(&watcher_lock);
+}
+
+/**
+ * @brief Watcher thread, used in attach mode.
+ *
+ * While the guest is running, waits for a GDB connection (or for any
+ * data from an already connected GDB, such as Ctrl+C) and then stops
+ * the emulation.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *gdb_watcher(void *arg)
+{
+	struct pollfd pfd;
+	int ret;
+
+	((void)arg);
+
+	for (;;) {
+		/* Wait until the guest is running. */
+		pthread_mutex_lock(&watcher_lock);
+		while (!vm_running || stop_pending)
+			pthread_cond_wait(&watcher_cond, &watcher_lock);
+		pfd.fd = (cl_fd >= 0) ? cl_fd : sv_fd;
+		pthread_mutex_unlock(&watcher_lock);
+
+		pfd.events  = POLLIN;
+		pfd.revents = 0;
+
+		/*
+		 * Timeout, so that a stop triggered by a breakpoint (which
+		 * changes the socket owner) is noticed.
+		 */
+		ret = poll(&pfd, 1, 100);
+		if (ret <= 0)
+			continue;
+
+		pthread_mutex_lock(&watcher_lock);
+		if (vm_running && !stop_pending) {
+			GDB("%s, stopping...\n",
+				(cl_fd >= 0) ? "Interrupt received" : "GDB attached");
+			stop_pending  = 1;
+			stop_serviced = 0;
+			uc_emu_stop(watcher_uc);
+		}
+		pthread_mutex_unlock(&watcher_lock);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Stop the emulation from inside a hook, at @p addr, so that it
+ * resumes there from the main loop (see gdb_handle_stop()), with the
+ * blocks retranslated with the hooks added meanwhile.
+ *
+ * @param uc   Unicorn context.
+ * @param addr Address of the instruction that stopped (not executed
+ *             yet).
+ */
+static void resume_from_main_loop(uc_engine *uc, u32 addr)
+{
+	GDB("Hooks changed, resuming at 0x%08x\n", addr);
+
+	/* The hooks at @p addr already stopped, skip them once. */
+	ss_skip    = 1;
+	ss_skip_pc = addr;
+
+	pthread_mutex_lock(&watcher_lock);
+	/* An interrupt from the watcher stops in GDB again, as usual. */
+	if (!stop_pending) {
+		stop_pending   = 1;
+		stop_serviced  = 1;
+		resume_pending = 1;
+		resume_pc      = addr;
+	}
+	pthread_mutex_unlock(&watcher_lock);
+	uc_emu_stop(uc);
+}
+
+/**
+ * @brief Handles an emulation stop requested by GDB, i.e., the return
+ * of uc_emu_start() in attach mode, or due to a watchpoint hit.
+ *
+ * @param uc Unicorn context.
+ * @param pc Returned PC, where the emulation should resume.
+ *
+ * @return Returns 1 if the emulation should resume at @p pc, 0
+ * otherwise.
+ */
+int gdb_handle_stop(uc_engine *uc, u32 *pc)
+{
+	int serviced;
+
+	pthread_mutex_lock(&watcher_lock);
+	if (!stop_pending) {
+		pthread_mutex_unlock(&watcher_lock);
+		return 0;
+	}
+	serviced = stop_serviced;
+	pthread_mutex_unlock(&watcher_lock);
+
+	/* Stopped before the instruction, PC might not be in sync. */
+	if (resume_pending)
+		*pc = resume_pc;
+	else if (uc_reg_read(uc, UC_PPC_REG_PC, pc))
+		errx(1, "Unable to read PC!\n");
+
+	/* Unless some breakpoint already did, stop here. */
+	if (!serviced)
+		gdb_stop(uc, *pc);
+
+	pthread_mutex_lock(&watcher_lock);
+	stop_pending   = 0;
+	stop_serviced  = 0;
+	resume_pending = 0;
+	pthread_cond_signal(&watcher_cond);
+	pthread_mutex_unlock(&watcher_lock);
+	return 1;
+}
+
+/**
+ * @brief Unicorn hook callback for single-step debugging.
+ *
+ * Pauses execution at each instruction while GDB is stepping.
+ *
+ * @param uc        Unicorn context.
+ * @param addr      Current instruction address.
+ * @param size      Instruction size.
+ * @param user_data User-defined data (unused).
+ */
+static void single_step(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	((void)size);
+	((void)user_data);
+
+	OVH_COUNT(OVH_HOOK_GDB);
+
+	/* Hook just added for an instruction that already stopped. */
+	if (ss_skip) {
+		ss_skip = 0;
+		if (addr == ss_skip_pc)
+			return;
+	}
+
+	/* Step done, we're going to stop here. */
+	gdb_stop(uc, addr);
+	if (retranslate)
+		resume_from_main_loop(uc, addr);
 }
 
 /**
  * @brief Initialize the GDB stub server.
  *
- * Sets up a TCP server on the specified port and installs a Unicorn code hook
- * for single-stepping and breakpoint support. This must be called once during
+ * Sets up a TCP server on the specified port and installs a temporary
+ * single-step hook, so the execution stops at the first instruction.
+ * Breakpoints are installed later, on demand. This must be called once during
  * VM initialization before executing any code.
  *
- * @param uc   Unicorn engine instance.
- * @param port TCP port number for the GDB server.
+ * In attach mode, nothing is hooked: the execution starts right away and a
+ * watcher thread stops it when GDB connects.
+ *
+ * @param uc     Unicorn engine instance.
+ * @param port   TCP port number for the GDB server.
+ * @param attach If non-zero, do not stop at the first instruction.
  * @return 0 on success, -1 on error.
  */
-int gdb_init(uc_engine *uc, u16 port)
+int gdb_init(uc_engine *uc, u16 port, int attach)
 {
+	int i;
+
 	setup_server(&sv_fd, port);
+	hex_tables_init();
 
 	/*
-	 * Enable single-step, i.e.: add a hook code for the entire 4GiB.
-	 * so our handler stop at each instruction.
+	 * Transfer buffer: large enough for a full hex-encoded packet plus
+	 * the raw data that originated it.
+	 */
+	increase_buffer(GDB_PACKET_SIZE * 3);
+
+	for (i = 0; i < PPC_REGS_AMNT; i++)
+		ppcregs_ptrs[i] = &ppcregs.u32_vals[i];
+
+	if (attach) {
+		attach_mode    = 1;
+		in_single_step = 0;
+		vm_running     = 1;
+		watcher_uc     = uc;
+		if (pthread_create(&watcher_thread, NULL, gdb_watcher, NULL))
+			return -1;
+		pthread_detach(watcher_thread);
+		return 0;
+	}
+
+	/*
+	 * Stop at the very first instruction, i.e.: start single-stepping,
+	 * so GDB can connect before the program runs.
 	 */
 	if (uc_hook_add(uc, &uc_hook_ss, UC_HOOK_CODE, single_step, NULL, 1, 0))
 		return -1;
 
+	ss_active = 1;
+
 	return 0;
 }
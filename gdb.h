@@ -161,6 +161,7 @@
 		"  </feature>"
 		"</target>";
 
-	extern int gdb_init(uc_engine *uc, u16 port);
+	extern int gdb_init(uc_engine *uc, u16 port, int attach);
+	extern int gdb_handle_stop(uc_engine *uc, u32 *pc);
 
 #endif /* GDH_H */
@@ -25,17 +25,82 @@
  *
  * Since PPC64 is (ATM) unreliable, we sadly have to go this route.
  * I honestly hope that there isn't too much insns to emulate...
+ *
+ * How the dispatch works:
+ * - All emulated instructions live in a single table (insn_ops[]), and
+ *   during init, each entry is placed into a lookup table indexed by
+ *   primary opcode and, for opcode 31, by its extended opcode. Decoding
+ *   a trapped instruction is then just two array lookups, no matter
+ *   how many instructions we support.
+ *
+ * - Since the same instruction usually traps over and over again (think
+ *   of a cmpb inside a strlen loop), each decoded instruction is saved
+ *   in a small direct-mapped cache indexed by its PC, so the next trap
+ *   at the same address skips both the uc_mem_read() and the decode.
+ *   Text is only rewritten after load by GDB memory writes, which drop
+ *   the entries of the overwritten range (see insn_emu_invalidate()).
  */
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include <arpa/inet.h>
 #include "mm.h"
 #include "util.h"
+#include "overhead.h"
+#include "stats.h"
+#include "timeline.h"
 #include "insn_emu.h"
 
 #define POWERPC_EXCP_HV_EMU 96
 
+/* XER bits. */
+#define XER_SO 0x80000000
+#define XER_OV 0x40000000
+
+/* Decode cache size, must be a power of 2. */
+#define INSN_CACHE_SIZE 4096
+
+/* Forward declaration. */
+struct insn_dec;
+
+/**
+ * Emulated instruction descriptor.
+ */
+struct insn_op {
+	const char *name;  /* Mnemonic.                                  */
+	u32 opcode;        /* Primary opcode.                            */
+	u32 xo;            /* Extended opcode (X-form, 10-bit).          */
+	u32 xo_mask;       /* Which XO bits are significant (A-form: 5). */
+	int (*emu)(uc_engine *uc, const struct insn_dec *d);
+	u64 hits;          /* How many times this insn was emulated.     */
+};
+
+/**
+ * Decoded instruction, as saved in the decode cache.
+ */
+struct insn_dec {
+	u32 pc;              /* Instruction address, 0 means empty slot. */
+	u32 insn;            /* Raw instruction.                         */
+	u8  rt;              /* RT/RS field (bits 6-10).                 */
+	u8  ra;              /* RA field    (bits 11-15).                */
+	u8  rb;              /* RB field    (bits 16-20).                */
+	u8  bc;              /* BC field    (bits 21-25), for isel.      */
+	u8  rc;              /* Record bit.                              */
+	u8  oe;              /* OE bit      (bit 21), XO-form.           */
+	struct insn_op *op;  /* Instruction handler.                     */
+};
+
+/* Decode tables. */
+static struct insn_op *primary_tbl[64];
+static struct insn_op *op31_tbl[1024];
+static struct insn_dec insn_cache[INSN_CACHE_SIZE];
+
+/* Cache statistics. */
+static u64 cache_hits;
+static u64 cache_misses;
+
 /* Instruction decoder helpers */
 static inline u32 get_opcode(u32 insn) {
 	return (insn >> 26) & 0x3F;
@@ -44,42 +109,384 @@ static inline u32 get_subop(u32 insn) {
 	return (insn >> 1) & 0x3FF;
 }
 
+/* Register helpers. */
+static inline u32 rd_gpr(uc_engine *uc, u32 r) {
+	u32 v;
+	uc_reg_read(uc, UC_PPC_REG_0 + r, &v);
+	return v;
+}
+static inline void wr_gpr(uc_engine *uc, u32 r, u32 v) {
+	uc_reg_write(uc, UC_PPC_REG_0 + r, &v);
+}
+
+/**
+ * @brief Computes the effective address for X-form loads/stores,
+ * i.e: (RA|0) + RB.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ *
+ * @return Returns the effective address.
+ */
+static inline u32 get_ea(uc_engine *uc, const struct insn_dec *d) {
+	return (d->ra ? rd_gpr(uc, d->ra) : 0) + rd_gpr(uc, d->rb);
+}
+
 /**
- * @brief cmpb rD, rA, rB
+ * @brief Update CR0 accordingly with the result @p res, for
+ * instructions with the record bit set (Rc=1).
+ *
+ * @param uc  Unicorn context.
+ * @param res Signed result to compare against 0.
+ */
+static void update_cr0(uc_engine *uc, s32 res)
+{
+	u32 cr, xer, field;
+	uc_reg_read(uc, UC_PPC_REG_CR,  &cr);
+	uc_reg_read(uc, UC_PPC_REG_XER, &xer);
+
+	if (res < 0)
+		field = 0x8;
+	else if (res > 0)
+		field = 0x4;
+	else
+		field = 0x2;
+
+	field |= (xer >> 31) & 1; /* SO. */
+	cr = (cr & 0x0FFFFFFF) | (field << 28);
+	uc_reg_write(uc, UC_PPC_REG_CR, &cr);
+}
+
+/**
+ * @brief cmpb rA, rS, rB
  * Compare bytes: for each byte position, set result to 0xFF if equal,
  * 0x00 if not.
  *
  * Pseudo:
  * for i range(1,4)
- *   res[i] = if vA[i] == vB[i] ? 0xFF : 0x00
+ *   res[i] = if vS[i] == vB[i] ? 0xFF : 0x00
  *
- * @param uc   Unicorn context.
- * @param insn Instruction to emulate.
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
  */
-static int emu_cmpb(uc_engine *uc, u32 insn, u32 pc)
+static int emu_cmpb(uc_engine *uc, const struct insn_dec *d)
 {
 	int i;
-	int result;
-	u32 vA, vB;
-	u8 byteA, byteB, cmp;
-	u32 rA = (insn >> 21) & 0x1F;
-	u32 rD = (insn >> 16) & 0x1F;
-	u32 rB = (insn >> 11) & 0x1F;
+	u32 result;
+	u32 vS, vB;
+	u8 byteS, byteB, cmp;
 
 	result = 0;
-	uc_reg_read(uc, UC_PPC_REG_0 + rA, &vA);
-	uc_reg_read(uc, UC_PPC_REG_0 + rB, &vB);
+	vS = rd_gpr(uc, d->rt);
+	vB = rd_gpr(uc, d->rb);
 
 	/* Compare each byte */
 	for (i = 0; i < 4; i++) {
-		byteA   = (vA >> (i * 8)) & 0xFF;
+		byteS   = (vS >> (i * 8)) & 0xFF;
 		byteB   = (vB >> (i * 8)) & 0xFF;
-		cmp     = (byteA == byteB) ? 0xFF : 0x00;
-		result |= (cmp << (i * 8));
+		cmp     = (byteS == byteB) ? 0xFF : 0x00;
+		result |= ((u32)cmp << (i * 8));
+	}
+
+	wr_gpr(uc, d->ra, result);
+	INSN("(%08x) cmpb(r%d,r%d,r%d) = %08x\n", d->pc,d->ra,d->rt,d->rb,result);
+	return 0;
+}
+
+/**
+ * @brief popcntb rA, rS
+ * Population count bytes: each byte of rA receives the amount of
+ * bits set in the same byte of rS.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_popcntb(uc_engine *uc, const struct insn_dec *d)
+{
+	u32 v, result;
+	int i;
+
+	v      = rd_gpr(uc, d->rt);
+	result = 0;
+	for (i = 0; i < 4; i++)
+		result |= (u32)__builtin_popcount((v >> (i * 8)) & 0xFF) << (i * 8);
+
+	wr_gpr(uc, d->ra, result);
+	INSN("(%08x) popcntb(r%d,r%d) = %08x\n", d->pc, d->ra, d->rt, result);
+	return 0;
+}
+
+/**
+ * @brief popcntw/popcntd rA, rS
+ * Population count word/doubleword. Since we're in 32-bit mode, the
+ * upper word is always zero, so both behave the same.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_popcntw(uc_engine *uc, const struct insn_dec *d)
+{
+	u32 result = __builtin_popcount(rd_gpr(uc, d->rt));
+	wr_gpr(uc, d->ra, result);
+	INSN("(%08x) %s(r%d,r%d) = %08x\n", d->pc, d->op->name, d->ra, d->rt,
+		result);
+	return 0;
+}
+
+/**
+ * @brief prtyw rA, rS
+ * Parity word: rA receives the XOR of the least significant bit of
+ * each byte of rS.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_prtyw(uc_engine *uc, const struct insn_dec *d)
+{
+	u32 v, result;
+
+	v      = rd_gpr(uc, d->rt);
+	result = (v ^ (v >> 8) ^ (v >> 16) ^ (v >> 24)) & 1;
+
+	wr_gpr(uc, d->ra, result);
+	INSN("(%08x) prtyw(r%d,r%d) = %08x\n", d->pc, d->ra, d->rt, result);
+	return 0;
+}
+
+/**
+ * @brief bpermd rA, rS, rB
+ * Bit permute doubleword: each byte of rS selects a bit (big-endian
+ * numbering, 0-63) from rB, the 8 selected bits are placed on the
+ * least significant byte of rA. Indexes >= 64 select a 0.
+ *
+ * In 32-bit mode, rB is zero-extended to 64-bit and only the low word
+ * of rS is available, so only the last 4 selectors are meaningful,
+ * the first four select bit 0 of a zero upper word.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_bpermd(uc_engine *uc, const struct insn_dec *d)
+{
+	u32 vS, result;
+	u64 vB;
+	u8 idx;
+	int i;
+
+	vS     = rd_gpr(uc, d->rt);
+	vB     = rd_gpr(uc, d->rb);
+	result = 0;
+
+	/* Selectors 0-3 comes from the (zero) upper word: index 0. */
+	for (i = 0; i < 8; i++) {
+		idx = (i < 4) ? 0 : (vS >> ((7 - i) * 8)) & 0xFF;
+		if (idx < 64 && ((vB >> (63 - idx)) & 1))
+			result |= 1 << (7 - i);
+	}
+
+	wr_gpr(uc, d->ra, result);
+	INSN("(%08x) bpermd(r%d,r%d,r%d) = %08x\n", d->pc, d->ra, d->rt, d->rb,
+		result);
+	return 0;
+}
+
+/**
+ * @brief isel rT, rA, rB, BC
+ * Integer select: rT = CR[BC] ? (rA|0) : rB.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_isel(uc_engine *uc, const struct insn_dec *d)
+{
+	u32 cr, result;
+
+	uc_reg_read(uc, UC_PPC_REG_CR, &cr);
+	if ((cr >> (31 - d->bc)) & 1)
+		result = d->ra ? rd_gpr(uc, d->ra) : 0;
+	else
+		result = rd_gpr(uc, d->rb);
+
+	wr_gpr(uc, d->rt, result);
+	INSN("(%08x) isel(r%d,r%d,r%d,%d) = %08x\n", d->pc, d->rt, d->ra, d->rb,
+		d->bc, result);
+	return 0;
+}
+
+/**
+ * @brief ldbrx rT, rA, rB
+ * Load doubleword byte-reverse indexed. In 32-bit mode only the low
+ * word of rT is visible, which corresponds to the first 4 bytes in
+ * memory, byte-reversed.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_ldbrx(uc_engine *uc, const struct insn_dec *d)
+{
+	u8 b[8];
+	u32 ea, result;
+
+	ea = get_ea(uc, d);
+	if (uc_mem_read(uc, ea, b, sizeof b))
+		return -1;
+
+	result = (u32)b[3] << 24 | (u32)b[2] << 16 | (u32)b[1] << 8 | b[0];
+	wr_gpr(uc, d->rt, result);
+	INSN("(%08x) ldbrx(r%d,r%d,r%d) [%08x] = %08x\n", d->pc, d->rt, d->ra,
+		d->rb, ea, result);
+	return 0;
+}
+
+/**
+ * @brief stdbrx rS, rA, rB
+ * Store doubleword byte-reverse indexed. The upper word of rS is
+ * zero in 32-bit mode, so the last 4 bytes in memory are always zero.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_stdbrx(uc_engine *uc, const struct insn_dec *d)
+{
+	u8 b[8] = {0};
+	u32 ea, v;
+
+	ea   = get_ea(uc, d);
+	v    = rd_gpr(uc, d->rt);
+	b[0] = v;
+	b[1] = v >> 8;
+	b[2] = v >> 16;
+	b[3] = v >> 24;
+
+	if (uc_mem_write(uc, ea, b, sizeof b))
+		return -1;
+
+	INSN("(%08x) stdbrx(r%d,r%d,r%d) [%08x] = %08x\n", d->pc, d->rt, d->ra,
+		d->rb, ea, v);
+	return 0;
+}
+
+/**
+ * @brief divweu/divwe rT, rA, rB
+ * Divide word extended (unsigned/signed): rT = (rA || 0x00000000) / rB.
+ * If the quotient does not fit into 32-bit or rB is zero, rT is
+ * undefined, and we just write 0. The OE forms (divweuo/divweo) set
+ * XER[OV] on these cases (and XER[SO]), and clear XER[OV] otherwise.
+ *
+ * @param uc Unicorn context.
+ * @param d  Decoded instruction.
+ */
+static int emu_divwe(uc_engine *uc, const struct insn_dec *d)
+{
+	u32 vA, vB, result, xer;
+	int overflow;
+	s64 sq;
+	u64 uq;
+
+	vA       = rd_gpr(uc, d->ra);
+	vB       = rd_gpr(uc, d->rb);
+	result   = 0;
+	overflow = 1;
+
+	/* divweu. */
+	if ((get_subop(d->insn) & 0x1FF) == 395) {
+		if (vB) {
+			uq = ((u64)vA << 32) / vB;
+			if (uq <= UINT32_MAX) {
+				result   = uq;
+				overflow = 0;
+			}
+		}
+	}
+
+	/*
+	 * divwe: (rA || 0) / -1 only fits if rA is zero, and must not reach
+	 * the host division, as INT64_MIN / -1 traps.
+	 */
+	else if ((s32)vB == -1)
+		overflow = (vA != 0);
+
+	else if (vB) {
+		sq = (s64)((u64)vA << 32) / (s32)vB;
+		if (sq >= INT32_MIN && sq <= INT32_MAX) {
+			result   = sq;
+			overflow = 0;
+		}
 	}
 
-	uc_reg_write(uc, UC_PPC_REG_0 + rD, &result);
-	INSN("(%08x) cmpb(r%d,r%d,r%d) = %08x\n", pc,rD,rA,rB,result);
+	wr_gpr(uc, d->rt, result);
+
+	/* OE=1: update XER[OV,SO] before CR0, as CR0[SO] comes from XER. */
+	if (d->oe) {
+		uc_reg_read(uc, UC_PPC_REG_XER, &xer);
+		if (overflow)
+			xer |= XER_SO | XER_OV;
+		else
+			xer &= ~XER_OV;
+		uc_reg_write(uc, UC_PPC_REG_XER, &xer);
+	}
+
+	if (d->rc)
+		update_cr0(uc, result);
+
+	INSN("(%08x) %s%s(r%d,r%d,r%d) = %08x\n", d->pc, d->op->name,
+		d->oe ? "o" : "", d->rt, d->ra, d->rb, result);
+	return 0;
+}
+
+/**
+ * All emulated instructions.
+ * To add a new one, just add a new entry here.
+ */
+static struct insn_op insn_ops[] = {
+	/* Name      Op  XO   XO mask  Handler. */
+	{"cmpb",     31, 508, 0x3FF,   emu_cmpb},
+	{"popcntb",  31, 122, 0x3FF,   emu_popcntb},
+	{"popcntw",  31, 378, 0x3FF,   emu_popcntw},
+	{"popcntd",  31, 506, 0x3FF,   emu_popcntw},
+	{"prtyw",    31, 154, 0x3FF,   emu_prtyw},
+	{"bpermd",   31, 252, 0x3FF,   emu_bpermd},
+	{"isel",     31,  15, 0x01F,   emu_isel},
+	{"ldbrx",    31, 532, 0x3FF,   emu_ldbrx},
+	{"stdbrx",   31, 660, 0x3FF,   emu_stdbrx},
+	{"divweu",   31, 395, 0x1FF,   emu_divwe},
+	{"divwe",    31, 427, 0x1FF,   emu_divwe},
+};
+
+#define INSN_OPS_AMNT (sizeof(insn_ops)/sizeof(insn_ops[0]))
+
+/**
+ * @brief Decodes the instruction @p insn at @p pc into @p d.
+ *
+ * @param insn Raw instruction (host order).
+ * @param pc   Instruction address.
+ * @param d    Decoded instruction.
+ *
+ * @return Returns 0 if the instruction is supported, -1 otherwise.
+ */
+static int insn_decode(u32 insn, u32 pc, struct insn_dec *d)
+{
+	struct insn_op *op;
+	u32 opcode;
+
+	opcode = get_opcode(insn);
+	if (opcode == 31)
+		op = op31_tbl[get_subop(insn)];
+	else
+		op = primary_tbl[opcode];
+
+	if (!op)
+		return -1;
+
+	d->pc   = pc;
+	d->insn = insn;
+	d->rt   = (insn >> 21) & 0x1F;
+	d->ra   = (insn >> 16) & 0x1F;
+	d->rb   = (insn >> 11) & 0x1F;
+	d->bc   = (insn >>  6) & 0x1F;
+	d->rc   = insn & 1;
+	d->oe   = (insn >> 10) & 1;
+	d->op   = op;
 	return 0;
 }
 
@@ -91,9 +498,10 @@ static int emu_cmpb(uc_engine *uc, u32 insn, u32 pc)
  */
 static void hook_illegal_insn(uc_engine *uc, u32 intno, void *user_data)
 {
+	struct insn_dec *d;
 	u32 pc, insn;
-	u32 opcode;
-	u32 subop;
+	u32 argv[2];
+	u64 start;
 	((void)user_data);
 
 	/* Only handle HV emulation assistance exceptions */
@@ -102,24 +510,123 @@ static void hook_illegal_insn(uc_engine *uc, u32 intno, void *user_data)
 		return;
 	}
 
+	OVH_HOOK(OVH_HOOK_INSN_EMU);
 	uc_reg_read(uc, UC_PPC_REG_PC, &pc);
 	pc -= 4;
-	uc_mem_read(uc, pc, &insn, 4);
 
-	insn   = ntohl(insn);
-	opcode = get_opcode(insn);
-	subop  = get_subop(insn);
+	/* Lookup on the decode cache first. */
+	d = &insn_cache[(pc >> 2) & (INSN_CACHE_SIZE - 1)];
+	if (d->pc == pc && d->op)
+		cache_hits++;
+
+	else {
+		cache_misses++;
+		uc_mem_read(uc, pc, &insn, 4);
+		insn = ntohl(insn);
+
+		/* If we get here, it's an unhandled instruction */
+		if (insn_decode(insn, pc, d) < 0) {
+			d->pc = 0;
+			errx(1, "Unhandled HV_EMU excep at 0x%x: 0x%08x (opcode=%d, "
+				"subop=%d)\n", pc, insn, get_opcode(insn), get_subop(insn));
+		}
+	}
 
 	/* Dispatch to appropriate emulator */
-	if (opcode == 31 && subop == 508) {
-		  /* cmpb - Compare Bytes */
-		if (emu_cmpb(uc, insn, pc) == 0)
-			return;
+	d->op->hits++;
+	start = timeline_enabled ? stats_now_ns() : 0;
+
+	if (d->op->emu(uc, d) < 0)
+		errx(1, "Unable to emulate %s at 0x%x: 0x%08x\n", d->op->name, pc,
+			d->insn);
+
+	if (timeline_enabled) {
+		argv[0] = pc;
+		argv[1] = d->insn;
+		timeline_slice(TL_INSN_EMU, d->op->name, NULL, start,
+			stats_now_ns() - start, argv, 2);
+	}
+	OVH_END();
+}
+
+/**
+ * @brief Drop the decode cache entries of the instructions within
+ * @p addr to @p addr + @p len, as their code has been overwritten
+ * (e.g., by GDB).
+ *
+ * @param addr Start address.
+ * @param len  Length, in bytes.
+ */
+void insn_emu_invalidate(u32 addr, u32 len)
+{
+	struct insn_dec *d;
+	u64 pc, end;
+
+	if (!len)
+		return;
+
+	/* Larger than the cache: just clear it all. */
+	if (len >= INSN_CACHE_SIZE * 4) {
+		memset(insn_cache, 0, sizeof insn_cache);
+		return;
+	}
+
+	end = (u64)addr + len;
+	for (pc = addr & ~3u; pc < end; pc += 4) {
+		d = &insn_cache[(pc >> 2) & (INSN_CACHE_SIZE - 1)];
+		if (d->pc == (u32)pc)
+			d->pc = 0;
 	}
+}
+
+/**
+ * @brief Prints how many times each instruction was emulated.
+ * Only instructions with at least one hit are shown.
+ */
+static void insn_emu_print_stats(void)
+{
+	int i;
+
+	if (!cache_hits && !cache_misses)
+		return;
 
-	/* If we get here, it's an unhandled instruction */
-	errx(1, "Unhandled HV_EMU excep at 0x%x: 0x%08x (opcode=%d, subop=%d)\n",
-		pc, insn, opcode, subop);
+	fprintf(stderr, "[insn_emu] Emulated instructions (decode cache: "
+		"%" PRIu64 " hits, %" PRIu64 " misses):\n", cache_hits, cache_misses);
+
+	for (i = 0; i < INSN_OPS_AMNT; i++) {
+		if (!insn_ops[i].hits)
+			continue;
+		fprintf(stderr, "[insn_emu]   %-10s %" PRIu64 "\n",
+			insn_ops[i].name, insn_ops[i].hits);
+	}
+}
+
+/**
+ * @brief Fill the decode tables with all the instructions
+ * from insn_ops[].
+ */
+static void insn_tables_init(void)
+{
+	struct insn_op *op;
+	u32 xo;
+	int i;
+
+	for (i = 0; i < INSN_OPS_AMNT; i++) {
+		op = &insn_ops[i];
+		if (op->opcode != 31) {
+			primary_tbl[op->opcode] = op;
+			continue;
+		}
+
+		/*
+		 * Fill every XO that matches the significant bits, so forms
+		 * with a smaller XO (like isel, A-form) or with an OE bit
+		 * (XO-form) also decode with a single lookup.
+		 */
+		for (xo = 0; xo < 1024; xo++)
+			if ((xo & op->xo_mask) == op->xo)
+				op31_tbl[xo] = op;
+	}
 }
 
 /**
@@ -129,7 +636,13 @@ static void hook_illegal_insn(uc_engine *uc, u32 intno, void *user_data)
 void insn_emu_init(uc_engine *uc) {
 	uc_hook hook;
 	uc_err err;
+
+	insn_tables_init();
+
 	err = uc_hook_add(uc, &hook, UC_HOOK_INTR, hook_illegal_insn, NULL, 1, 0);
 	if (err)
 		errx(1, "Unable to add hook_illegal_insn!\n");
+
+	if (args.insn_stats)
+		atexit(insn_emu_print_stats);
 }
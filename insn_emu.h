@@ -19,5 +19,6 @@
 #endif
 
 extern void insn_emu_init(uc_engine *uc);
+extern void insn_emu_invalidate(u32 addr, u32 len);
 
 #endif /* INSN_EMU_H. */
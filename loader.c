@@ -13,8 +13,12 @@
 #include <unistd.h>
 #include <unicorn/unicorn.h>
 
+#include "flightrec.h"
 #include "loader.h"
+#include "ltrace.h"
 #include "mm.h"
+#include "stats.h"
+#include "symindex.h"
 #include "util.h"
 #include "unix.h"
 
@@ -35,6 +39,31 @@ static int g_depth = -1;
 /* Tiny AIX dynamic loader. */
 struct loaded_coff *loaded_modules;
 
+/* Symbol index (-i), opened on first use. */
+static struct symindex symindex;
+static int symindex_state; /* 0: not opened, 1: opened, -1: unavailable. */
+
+/**
+ * @brief Get the symbol index provided with -i, if any.
+ *
+ * @return Returns the opened index, or NULL if not available.
+ */
+static const struct symindex *get_symindex(void)
+{
+	if (!args.symindex || symindex_state < 0)
+		return NULL;
+	if (symindex_state)
+		return &symindex;
+
+	if (symindex_open(args.symindex, &symindex) < 0) {
+		warn("Unable to open symbol index (%s), ignoring!\n", args.symindex);
+		symindex_state = -1;
+		return NULL;
+	}
+	symindex_state = 1;
+	return &symindex;
+}
+
 /**
  * @brief Add a loaded XCOFF module to the global module list.
  *
@@ -79,70 +108,230 @@ get_bin_path(char *buff, size_t size, const char *bin, const char *member_name)
 	return buff;
 }
 
+/*
+ * Lookup cache: every path probed while searching for libraries (and
+ * every search path directory), with its result, including negative
+ * ones, kept for the whole load. The same few libraries are looked up
+ * for every imported symbol, from several directories, so without this
+ * most lookups would end up in failed open()s.
+ */
+struct path_entry {
+	char *path;
+	int   found;   /* Directory exists, or file is an XCOFF/Big-AR. */
+	struct path_entry *next;
+};
+
+static struct {
+	struct path_entry **buckets;
+	u32 nbuckets;              /* Power of 2. */
+	u32 nentries;
+} path_cache;
+
+/**
+ * @brief Hash a path (FNV-1a).
+ */
+static u32 path_hash(const char *s)
+{
+	u32 h = 2166136261u;
+	for (; *s; s++) {
+		h ^= (u8)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * @brief Probe @p path: for directories, if it exists; for files, if it
+ * exists and is either an XCOFF32 or a Big-AR, so that unrelated host
+ * files that happen to have the same name (such as a Linux /usr/lib/libc.a)
+ * are skipped.
+ *
+ * @param path   Path to be probed.
+ * @param is_dir 1 if @p path should be a directory, 0 otherwise.
+ *
+ * @return Returns 1 if found, 0 otherwise.
+ */
+static int probe_path(const char *path, int is_dir)
+{
+	struct stat st;
+	char magic[AMAGICLEN];
+	int fd, found;
+
+	if (is_dir)
+		return !stat(path, &st) && S_ISDIR(st.st_mode);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	found = 0;
+	if (read(fd, magic, sizeof magic) == sizeof magic) {
+		found = !memcmp(magic, AMAGICBIG, AMAGICLEN) ||
+			((u8)magic[0] << 8 | (u8)magic[1]) == XCOFFF32_MAGIC;
+	}
+	close(fd);
+	return found;
+}
+
+/**
+ * @brief Check if @p path exists (see probe_path()), using the lookup
+ * cache.
+ *
+ * @param path   Path to be looked up.
+ * @param is_dir 1 if @p path should be a directory, 0 otherwise.
+ *
+ * @return Returns 1 if found, 0 otherwise.
+ */
+static int lookup_path(const char *path, int is_dir)
+{
+	struct path_entry **buckets, *e, *next;
+	u32 h, i, nbuckets;
+
+	h = path_hash(path);
+	if (path_cache.nbuckets) {
+		e = path_cache.buckets[h & (path_cache.nbuckets - 1)];
+		for (; e; e = e->next)
+			if (!strcmp(e->path, path))
+				return e->found;
+	}
+
+	/* Grow (load factor 1). */
+	if (path_cache.nentries >= path_cache.nbuckets) {
+		nbuckets = path_cache.nbuckets ? path_cache.nbuckets * 2 : 64;
+		buckets  = calloc(nbuckets, sizeof(*buckets));
+		if (!buckets)
+			errx(1, "Unable to allocate lookup cache!\n");
+		for (i = 0; i < path_cache.nbuckets; i++) {
+			for (e = path_cache.buckets[i]; e; e = next) {
+				next = e->next;
+				e->next = buckets[path_hash(e->path) & (nbuckets - 1)];
+				buckets[path_hash(e->path) & (nbuckets - 1)] = e;
+			}
+		}
+		free(path_cache.buckets);
+		path_cache.buckets  = buckets;
+		path_cache.nbuckets = nbuckets;
+	}
+
+	e = calloc(1, sizeof(*e));
+	if (!e || !(e->path = strdup(path)))
+		errx(1, "Unable to allocate lookup cache!\n");
+
+	e->found = probe_path(path, is_dir);
+	e->next  = path_cache.buckets[h & (path_cache.nbuckets - 1)];
+	path_cache.buckets[h & (path_cache.nbuckets - 1)] = e;
+	path_cache.nentries++;
+
+	LOADER("Lookup: (%s): %s\n", path, e->found ? "found" : "not found");
+	return e->found;
+}
+
+/**
+ * @brief Search for @p basename in a colon-separated list of
+ * directories @p dirs.
+ *
+ * @param dest      Output buffer for the full path.
+ * @param dest_size Size of output buffer.
+ * @param dirs      Colon-separated directory list (may be NULL).
+ * @param basename  Library basename.
+ *
+ * @return Returns 1 if found (and @p dest is filled), 0 otherwise.
+ */
+static int
+search_dirs(char *dest, size_t dest_size, const char *dirs,
+	const char *basename)
+{
+	const char *p, *end;
+	size_t len;
+
+	for (p = dirs; p && *p; p = *end ? end + 1 : end) {
+		end = strchr(p, ':');
+		if (!end)
+			end = p + strlen(p);
+
+		len = end - p;
+		if (!len)
+			continue;
+		if (len + strlen(basename) + 2 > dest_size)
+			errx(1, "Path too long when searching for %s\n", basename);
+
+		memcpy(dest, p, len);
+		dest[len] = '\0';
+		if (!lookup_path(dest, 1))
+			continue;
+
+		if (dest[len - 1] != '/')
+			dest[len++] = '/';
+		strcpy(dest + len, basename);
+		if (lookup_path(dest, 0))
+			return 1;
+	}
+	return 0;
+}
+
 /**
- * @brief Prepend library search path to a basename.
+ * @brief Get the path of the library imported by @p lc through the
+ * import ID @p id.
  *
- * Constructs a full path by prepending args.lib_path to the given
- * basename. The result is: "lib_path/basename".
+ * The library is searched, in order, on:
+ * - The library search path (-L, colon-separated)
+ * - The LIBPATH environment variable (colon-separated)
+ * - The path embedded in the import ID, if any
+ * - The LIBPATH embedded in the importing module (import ID #0)
+ * - The symbol index (-i), if provided
  *
  * @param dest      Output buffer for the full path.
  * @param dest_size Size of output buffer.
- * @param basename  Base filename to append.
+ * @param lc        Importing module.
+ * @param id        Import ID.
  */
 static void
-prepend_lib_path(char *dest, size_t dest_size, const char *basename)
+get_lib_path(char *dest, size_t dest_size, const struct loaded_coff *lc,
+	const union xcoff_impid *id)
 {
-	size_t len_base, len_path;
+	const char *basename = id->l_impidbase;
+	const struct symindex *si;
+	const char *path;
 
-	len_base = strlen(basename);
-	len_path = strlen(args.lib_path);
+	if (search_dirs(dest, dest_size, args.lib_path, basename) ||
+		search_dirs(dest, dest_size, getenv("LIBPATH"), basename) ||
+		search_dirs(dest, dest_size, id->l_impidpath, basename) ||
+		search_dirs(dest, dest_size, lc->xcoff.ldr.impids[0].l_impidpath,
+			basename))
+	{
+		return;
+	}
 
-	if (len_base + len_path + 1 >= dest_size - 1)
-		errx(1, "Path too long when prepending lib_path to %s\n", basename);
+	si = get_symindex();
+	if (si && (path = symindex_find_file(si, basename, id->l_impidmem))) {
+		if (strlen(path) >= dest_size)
+			errx(1, "Path too long: %s\n", path);
+		LOADER("Library (%s) not found in the search path, using indexed "
+			"(%s)\n", basename, path);
+		strcpy(dest, path);
+		return;
+	}
 
-	memcpy(dest, args.lib_path, len_path);
-	dest[len_path] = '/';
-	memcpy(dest + len_path + 1, basename, len_base);
-	dest[len_path + 1 + len_base] = '\0';
+	/* Not found: keep the name, so that the error makes sense. */
+	if (snprintf(dest, dest_size, "%s", basename) >= (int)dest_size)
+		errx(1, "Path too long: %s\n", basename);
 }
 
 /**
- * @brief Search for a loaded module by import symbol reference.
- *
- * This function looks up the import ID from the symbol, constructs
- * the expected binary path, and searches the loaded_modules list
- * for a matching module.
+ * @brief Search for an already loaded module.
  *
- * @param imp_sym Import symbol containing the import file ID.
- * @param lc      Current loaded XCOFF with import ID table.
+ * @param path   Library path.
+ * @param member Archive member, or NULL.
  * @return Pointer to the loaded module if found, NULL otherwise.
  */
 static const struct loaded_coff *
-find_module(const struct xcoff_ldr_sym_tbl_hdr32 *imp_sym,
-	const struct loaded_coff *lc)
+find_module(const char *path, const char *member)
 {
-	union xcoff_impid *impids;
 	struct loaded_coff *head;
 	char search_name[2048] = {0};
-	char full_path[2048]   = {0};
-	const char *basename, *member;
 
-	if (!imp_sym || !lc)
-		return NULL;
-
-	if (!imp_sym->l_ifile)
-		errx(1, "Import ID for symbol (%s) should be greater than 0!\n",
-			imp_sym->u.l_strtblname);
-
-	impids = lc->xcoff.ldr.impids;
-	basename = impids[imp_sym->l_ifile].l_impidbase;
-	member   = impids[imp_sym->l_ifile].l_impidmem;
-
-	/* Construct full path: lib_path + "/" + basename. */
-	prepend_lib_path(full_path, sizeof full_path, basename);
-
-	/* Construct module name: full_path + "_" + member (or just full_path). */
-	get_bin_path(search_name, sizeof search_name, full_path, member);
+	/* Construct module name: path + "_" + member (or just path). */
+	get_bin_path(search_name, sizeof search_name, path, member);
 
 	/* Search for matching module in loaded list. */
 	for (head = loaded_modules; head != NULL; head = head->next) {
@@ -153,6 +342,44 @@ find_module(const struct xcoff_ldr_sym_tbl_hdr32 *imp_sym,
 	return NULL;
 }
 
+/**
+ * @brief Emits a hint for an unresolved symbol @p sym, i.e., if the
+ * module @p lc was loaded from an archive, tell which member of that
+ * archive actually exports the symbol, accordingly with the archive
+ * global symbol table. If a symbol index was provided, also tell all
+ * the indexed modules that export it.
+ *
+ * @param lc  Module where the symbol was expected to be.
+ * @param sym Unresolved symbol name.
+ */
+static void suggest_exporter(const struct loaded_coff *lc, const char *sym)
+{
+	const struct symindex_sym *s;
+	const struct ar_memb_idx *m;
+	const struct symindex *si;
+	const char *path, *member;
+
+	if (lc->bar) {
+		m = ar_find_symbol(lc->bar, sym);
+		if (m) {
+			warn("Hint: symbol (%s) is exported by member (%.*s) of the "
+				"same archive\n", sym, (int)m->hdr.namlen, m->name);
+		}
+	}
+
+	si = get_symindex();
+	if (!si)
+		return;
+
+	for (s = symindex_find(si, sym, NULL); s; s = symindex_find(si, sym, s)) {
+		symindex_get_file(si, s, &path, &member);
+		if (!path)
+			continue;
+		warn("Hint: symbol (%s) is exported by (%s)%s%s%s\n", sym, path,
+			member ? "(" : "", member ? member : "", member ? ")" : "");
+	}
+}
+
 /**
  * @brief Resolves an imported symbol for an already (or not) loaded
  * library/module.
@@ -178,6 +405,7 @@ resolve_import(uc_engine *uc, const struct xcoff_ldr_sym_tbl_hdr32 *cur_sym,
 	const struct xcoff_ldr_hdr32 *imp_ldr;
 	const struct loaded_coff *imp_lc;
 	const union xcoff_impid *cur_id;
+	char lib_path[2048];
 	int i;
 
 	INCREASE_DEPTH;
@@ -213,9 +441,10 @@ resolve_import(uc_engine *uc, const struct xcoff_ldr_sym_tbl_hdr32 *cur_sym,
 		cur_id->l_impidbase,
 		cur_lc->name);
 
-	imp_lc = find_module(cur_sym, cur_lc);
+	get_lib_path(lib_path, sizeof lib_path, cur_lc, cur_id);
+	imp_lc = find_module(lib_path, cur_id->l_impidmem);
 	if (!imp_lc)
-		imp_lc = load_xcoff_file(uc, cur_id->l_impidbase, cur_id->l_impidmem, 0);
+		imp_lc = load_xcoff_file(uc, lib_path, cur_id->l_impidmem, 0);
 
 	/* Look up for the symbol. */
 	imp_ldr = &imp_lc->xcoff.ldr.hdr;
@@ -237,6 +466,7 @@ resolve_import(uc_engine *uc, const struct xcoff_ldr_sym_tbl_hdr32 *cur_sym,
 				imp_sym[i].u.l_strtblname,
 				imp_lc->xcoff.ldr.impids[imp_sym[i].l_ifile].l_impidbase);
 
+			STATS_ADD(cur_lc->stats_id, STATS_PASSTHROUGHS, 1);
 			return resolve_import(uc, &imp_sym[i], imp_lc);
 		}
 
@@ -247,10 +477,18 @@ resolve_import(uc_engine *uc, const struct xcoff_ldr_sym_tbl_hdr32 *cur_sym,
 		 * env]. Variables are exported as direct addresses. No distinction
 		 * needed here.
 		 */
+		if (ltrace_enabled && imp_sym[i].l_smclass == XMC_DS)
+			ltrace_bind(imp_lc, imp_sym[i].u.l_strtblname,
+				imp_sym[i].l_value);
+		flightrec_loader("bind", imp_sym[i].u.l_strtblname,
+			imp_sym[i].l_value);
+
 		DECREASE_DEPTH;
 		return imp_sym[i].l_value;
 	}
 
+	/* Hints first, errx() also dumps the flight recorder. */
+	suggest_exporter(imp_lc, cur_sym->u.l_strtblname);
 	errx(1, "Unresolved symbol (%s) from (%s)!\n", cur_sym->u.l_strtblname,
 		cur_lc->name);
 }
@@ -308,6 +546,8 @@ static void process_relocations(uc_engine *uc, struct loaded_coff *lc)
 	 * Relocate sections addresses (.text/.data/.bss and IMPORTs)
 	 */	
 	LOADER("Processing %d relocations (%s)...\n", ldr->l_nreloc, lc->name);
+	STATS_BEGIN(lc->stats_id, STATS_RELOC);
+	STATS_ADD(lc->stats_id, STATS_RELOCS, ldr->l_nreloc);
 	for (i = 0; i < ldr->l_nreloc; i++)
 	{
 		/* Addr containing the addr to be relocated. */
@@ -340,7 +580,10 @@ static void process_relocations(uc_engine *uc, struct loaded_coff *lc)
 				if (ret < 0)
 					errx(1, "Unable to read address 0x%x to relocate!\n", addr);
 
+				STATS_BEGIN(lc->stats_id, STATS_IMPORT);
 				value = resolve_import(uc, sym, lc) + addend;
+				STATS_END();
+				STATS_ADD(lc->stats_id, STATS_IMPORTS, 1);
 				LOADER("Imported sym (%s), resolved, addr=0x%08x (addend=0x%x)\n",
 				       sym->u.l_strtblname, value, addend);
 			}
@@ -359,6 +602,7 @@ static void process_relocations(uc_engine *uc, struct loaded_coff *lc)
 		if (mm_write_u32(addr, value) < 0)
 			errx(1, "Unable to write address relocated into 0x%x\n", addr);	
 	}
+	STATS_END();
 
 	DECREASE_DEPTH;
 }
@@ -386,8 +630,10 @@ load_xcoff_or_bigar(const char *bin, const char *member, struct loaded_coff *lc)
 
 	/* Load an executable or an XCOFF32 library. */
 	if (!member) {
+		STATS_BEGIN(lc->stats_id, STATS_XCOFF_PARSE);
 		if (xcoff_open(bin, &lc->xcoff) < 0)
 			errx(1, "Unable to load XCOFF (%s)!\n", bin);
+		STATS_END();
 	}
 
 	/*
@@ -395,16 +641,22 @@ load_xcoff_or_bigar(const char *bin, const char *member, struct loaded_coff *lc)
 	 * XCOFF32 library, thank you IBM for making our lives simpler /s
 	 */
 	else {
-		if (ar_open(bin, &lc->bar) < 0) {
+		STATS_BEGIN(lc->stats_id, STATS_AR_OPEN);
+		lc->bar = ar_get(bin);
+		if (!lc->bar) {
 			errx(1, "Unable to open big archive: (%s)\n", bin);
 		}
-		buff = ar_extract_member(&lc->bar, member, &size);
+		buff = ar_extract_member(lc->bar, member, &size);
 		if (!buff) {
 			errx(1, "Unable to extract member (%s) from (%s)!\n", member, bin);
 		}
-		if (xcoff_load(lc->bar.fd, buff, size, &lc->xcoff) < 0)
+		STATS_END();
+
+		STATS_BEGIN(lc->stats_id, STATS_XCOFF_PARSE);
+		if (xcoff_load(lc->bar->fd, buff, size, &lc->xcoff) < 0)
 			errx(1, "Unable to load member (%s) from XCOFF file (%s)!\n",
 				member, bin);
+		STATS_END();
 	}
 
 	get_bin_path(path, sizeof path, bin, member);
@@ -426,7 +678,8 @@ load_xcoff_or_bigar(const char *bin, const char *member, struct loaded_coff *lc)
  * TODO: Maybe split this into 'load_executable' and 'load_library'.
  *
  * @param uc     Unicorn engine instance.
- * @param bin    Path to the binary or archive file.
+ * @param bin    Path to the binary or archive file (libraries are
+ *               already searched on the library search path).
  * @param member Archive member name (NULL for executables).
  * @param is_exe 1 for main executable, 0 for library.
  * @return Pointer to the loaded COFF structure, or NULL on error.
@@ -437,26 +690,19 @@ load_xcoff_file(uc_engine *uc, const char *bin, const char *member, int is_exe)
 	struct loaded_coff *lcoff = NULL;
 	struct xcoff_aux_hdr32 *aux;
 	struct xcoff_sec_hdr32 *sec;
-	char full_path[2048] = {0};
-	const char *path;
 
 	if (!uc || !bin)
 		return lcoff;
 
-	path = bin;
 	INCREASE_DEPTH;
 
 	lcoff = calloc(1, sizeof(*lcoff));
 	if (!lcoff)
 		errx(1, "Unable to allocate buffer to load new XCOFF!\n");
 
-	/* For libraries, prepend the library search path. */
-	if (!is_exe) {
-		prepend_lib_path(full_path, sizeof full_path, bin);
-		path = full_path;
-	}
+	lcoff->stats_id = stats_module(bin, member);
 
-	load_xcoff_or_bigar(path, member, lcoff);	
+	load_xcoff_or_bigar(bin, member, lcoff);	
 	aux = &lcoff->xcoff.aux;
 	sec = &lcoff->xcoff.secs[aux->o_snbss - 1];
 	
@@ -487,11 +733,13 @@ load_xcoff_file(uc_engine *uc, const char *bin, const char *member, int is_exe)
 		uc_reg_write(uc, UC_PPC_REG_2, &lcoff->toc_anchor);
 
 	push_coff(lcoff);
+	flightrec_loader("load", lcoff->name, lcoff->text_start);
 	mm_write_text(lcoff, is_exe);
 	mm_write_data(lcoff, is_exe);
 
 	/* Fix relocs. */
 	process_relocations(uc, lcoff);
+	flightrec_loader("loaded", lcoff->name, lcoff->text_start);
 
 	DECREASE_DEPTH;
 	return lcoff;
@@ -19,8 +19,9 @@
 struct loaded_coff {
 	/* Loaded bin info. */
 	struct xcoff  xcoff;
-	struct big_ar bar;
+	struct big_ar *bar;  /* Shared archive (if loaded from one). */
 	const char *name;
+	u32 stats_id;        /* Statistics module id (see stats.h). */
 
 	/* Relocations. */
 	u32 text_start;    /* Runtime .text base address. */
@@ -35,6 +36,9 @@ struct loaded_coff {
 	struct loaded_coff *next;
 };
 
+/* All loaded modules, in load order (the executable first). */
+extern struct loaded_coff *loaded_modules;
+
 extern struct loaded_coff *load_xcoff_file(uc_engine *uc, const char *bin,
 	const char *member, int is_exe);
 
@@ -0,0 +1,485 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ltrace.h"
+#include "overhead.h"
+#include "stats.h"
+#include "sym.h"
+
+/* Amount of traced functions shown on the summary. */
+#define LT_TOP_FUNCS 40
+
+/* Module that called a traced function. */
+struct lt_caller {
+	const char *module;       /* Basename, see sym.h. */
+	u64 calls;
+	u64 total_ns;
+	struct lt_caller *next;
+};
+
+/* Traced (imported) function. */
+struct lt_func {
+	const struct loaded_coff *lc;   /* Exporter.                */
+	const char *module;             /* Exporter basename.       */
+	const char *name;
+	u32 desc;                       /* Function descriptor.     */
+	u32 entry;                      /* Entry point, 0 if none.  */
+	u64 calls;
+	u64 total_ns;
+	u64 min_ns;
+	u64 max_ns;
+	struct lt_caller *callers;
+	uc_hook hook;
+};
+
+/* Call in progress. */
+struct lt_frame {
+	struct lt_func *func;
+	struct lt_caller *caller;
+	u32 ret;                        /* Return address (LR).     */
+	u32 sp;                         /* r1 on entry.             */
+	u64 start;
+};
+
+/* Address -> pointer map, open addressing, linear probing. */
+struct lt_slot {
+	u32 addr;                       /* 0 = empty slot. */
+	void *ptr;
+};
+
+struct lt_map {
+	struct lt_slot *slots;
+	u32 capacity;                   /* Power of 2. */
+	u32 n;
+};
+
+int ltrace_enabled;
+
+static struct {
+	uc_engine *uc;
+	FILE *log;                      /* Streaming log, or NULL.  */
+	int started;
+	u64 start_ns;
+
+	struct lt_func **funcs;
+	u32 nfuncs;
+	u32 funcs_cap;
+
+	struct lt_map descs;            /* Descriptor -> function.  */
+	struct lt_map entries;          /* Entry point -> function. */
+	struct lt_map rets;             /* Hooked return addresses. */
+
+	struct lt_frame *stack;         /* Shadow call stack.       */
+	u32 depth;
+	u32 stack_cap;
+	u64 unwound;                    /* Frames never returned.   */
+} lt;
+
+static inline u32 map_hash(u32 addr) {
+	return (addr >> 2) * 2654435761u;
+}
+
+/**
+ * @brief Find the slot of @p addr in @p map, or the empty slot where
+ * it should be inserted.
+ */
+static struct lt_slot *map_slot(struct lt_map *map, u32 addr)
+{
+	u32 mask = map->capacity - 1;
+	u32 i;
+
+	for (i = map_hash(addr) & mask; map->slots[i].addr; i = (i + 1) & mask)
+		if (map->slots[i].addr == addr)
+			break;
+	return &map->slots[i];
+}
+
+/**
+ * @brief Get the pointer mapped to @p addr, or NULL.
+ */
+static void *map_find(struct lt_map *map, u32 addr)
+{
+	if (!map->capacity)
+		return NULL;
+	return map_slot(map, addr)->ptr;
+}
+
+/**
+ * @brief Map @p addr into @p ptr (non-NULL), growing the map if needed.
+ */
+static void map_insert(struct lt_map *map, u32 addr, void *ptr)
+{
+	struct lt_slot *old, *s;
+	u32 i, old_cap;
+
+	if ((map->n + 1) * 2 > map->capacity) {
+		old     = map->slots;
+		old_cap = map->capacity;
+
+		map->capacity = old_cap ? old_cap * 2 : 1024;
+		map->slots    = calloc(map->capacity, sizeof(*map->slots));
+		if (!map->slots)
+			errx(1, "Unable to allocate ltrace tables!\n");
+
+		for (i = 0; i < old_cap; i++)
+			if (old[i].addr)
+				*map_slot(map, old[i].addr) = old[i];
+		free(old);
+	}
+
+	s = map_slot(map, addr);
+	if (!s->addr)
+		map->n++;
+	s->addr = addr;
+	s->ptr  = ptr;
+}
+
+/**
+ * @brief Get the caller @p module entry of @p f, creating it if needed.
+ */
+static struct lt_caller *get_caller(struct lt_func *f, const char *module)
+{
+	struct lt_caller *c;
+
+	for (c = f->callers; c; c = c->next)
+		if (c->module == module)
+			return c;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		errx(1, "Unable to allocate ltrace callers!\n");
+	c->module  = module;
+	c->next    = f->callers;
+	f->callers = c;
+	return c;
+}
+
+/**
+ * @brief Account the finished call @p fr, lasting @p dur.
+ */
+static void account(const struct lt_frame *fr, u64 dur)
+{
+	struct lt_func *f = fr->func;
+
+	f->total_ns          += dur;
+	fr->caller->total_ns += dur;
+	if (!f->min_ns || dur < f->min_ns)
+		f->min_ns = dur;
+	if (dur > f->max_ns)
+		f->max_ns = dur;
+}
+
+/**
+ * @brief Return address hook: pop (and time) the calls that returned
+ * into @p addr.
+ *
+ * A return address might be executed for other reasons (e.g., a loop
+ * around the call), so a call only returns if both the address and
+ * the stack pointer match its entry. Calls whose stack is already
+ * gone (e.g., longjmp) are dropped.
+ */
+static void hook_return(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	struct lt_frame *fr;
+	u32 sp, r3;
+	u64 now;
+	((void)size);
+	((void)user_data);
+
+	OVH_HOOK(OVH_HOOK_LTRACE);
+	uc_reg_read(uc, UC_PPC_REG_1, &sp);
+
+	while (lt.depth) {
+		fr = &lt.stack[lt.depth - 1];
+		if (fr->sp < sp) {
+			lt.depth--;
+			lt.unwound++;
+			continue;
+		}
+		if (fr->ret != addr || fr->sp != sp)
+			break;
+
+		now = stats_now_ns();
+		account(fr, now - fr->start);
+		lt.depth--;
+
+		if (lt.log) {
+			uc_reg_read(uc, UC_PPC_REG_3, &r3);
+			fprintf(lt.log, "%12.6f %*s%s <- %s`%s = 0x%x <%.3f us>\n",
+				(now - lt.start_ns) / 1e9, (int)lt.depth * 2, "",
+				fr->caller->module, fr->func->module, fr->func->name, r3,
+				(now - fr->start) / 1e3);
+		}
+	}
+	OVH_END();
+}
+
+/**
+ * @brief Hook the return address @p ret, if not already.
+ */
+static void hook_ret_addr(uc_engine *uc, u32 ret)
+{
+	uc_hook hook;
+
+	if (map_find(&lt.rets, ret))
+		return;
+
+	if (uc_hook_add(uc, &hook, UC_HOOK_CODE, hook_return, NULL, ret, ret))
+		errx(1, "Unable to add ltrace return hook at 0x%08x!\n", ret);
+
+	/* Already translated code do not know about the new hook. */
+	uc_ctl_remove_cache(uc, ret, ret + 4);
+	map_insert(&lt.rets, ret, &lt);
+}
+
+/**
+ * @brief Entry hook of a traced function: if called from another
+ * module, push the call into the shadow stack.
+ */
+static void hook_entry(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	struct lt_func *f = user_data;
+	struct lt_frame *fr;
+	const char *module;
+	u32 lr, sp, off;
+	u32 r[4];
+	((void)addr);
+	((void)size);
+
+	OVH_HOOK(OVH_HOOK_LTRACE);
+	uc_reg_read(uc, UC_PPC_REG_LR, &lr);
+	uc_reg_read(uc, UC_PPC_REG_1,  &sp);
+
+	/* Calls from within the exporter itself are not imports. */
+	if (lr >= f->lc->text_start &&
+		lr <  f->lc->text_start + f->lc->xcoff.aux.o_tsize)
+	{
+		OVH_END();
+		return;
+	}
+
+	sym_lookup(uc, lr - 4, &module, &off);
+	if (!module)
+		module = "[unknown]";
+
+	if (lt.depth == lt.stack_cap) {
+		lt.stack_cap = lt.stack_cap ? lt.stack_cap * 2 : 256;
+		lt.stack     = realloc(lt.stack, lt.stack_cap * sizeof(*lt.stack));
+		if (!lt.stack)
+			errx(1, "Unable to allocate ltrace stack!\n");
+	}
+
+	fr         = &lt.stack[lt.depth];
+	fr->func   = f;
+	fr->caller = get_caller(f, module);
+	fr->ret    = lr;
+	fr->sp     = sp;
+	fr->start  = stats_now_ns();
+
+	f->calls++;
+	fr->caller->calls++;
+
+	if (lt.log) {
+		uc_reg_read(uc, UC_PPC_REG_3, &r[0]);
+		uc_reg_read(uc, UC_PPC_REG_4, &r[1]);
+		uc_reg_read(uc, UC_PPC_REG_5, &r[2]);
+		uc_reg_read(uc, UC_PPC_REG_6, &r[3]);
+		fprintf(lt.log, "%12.6f %*s%s -> %s`%s(0x%x, 0x%x, 0x%x, 0x%x)\n",
+			(fr->start - lt.start_ns) / 1e9, (int)lt.depth * 2, "", module,
+			f->module, f->name, r[0], r[1], r[2], r[3]);
+	}
+
+	lt.depth++;
+	hook_ret_addr(uc, lr);
+	OVH_END();
+}
+
+/**
+ * @brief Hook the entry point of @p f, read from its descriptor.
+ */
+static void install(struct lt_func *f)
+{
+	const struct loaded_coff *lc = f->lc;
+	u32 entry;
+
+	if (uc_mem_read(lt.uc, f->desc, &entry, 4))
+		return;
+
+	entry = ntohl(entry);
+	if (entry < lc->text_start || entry >= lc->text_start + lc->xcoff.aux.o_tsize)
+		return;
+
+	/* Aliases share the same code: the first name wins. */
+	if (map_find(&lt.entries, entry))
+		return;
+
+	if (uc_hook_add(lt.uc, &f->hook, UC_HOOK_CODE, hook_entry, f, entry,
+		entry))
+	{
+		errx(1, "Unable to add ltrace hook at 0x%08x!\n", entry);
+	}
+	if (lt.started)
+		uc_ctl_remove_cache(lt.uc, entry, entry + 4);
+
+	f->entry = entry;
+	map_insert(&lt.entries, entry, f);
+}
+
+/**
+ * @brief Register a function bound by the loader.
+ *
+ * Its entry point is only hooked on ltrace_start(), since the
+ * descriptor of a module still being loaded (circular imports) may not
+ * be relocated yet.
+ *
+ * @param lc   Exporting module.
+ * @param name Function name.
+ * @param desc Relocated function descriptor address.
+ */
+void ltrace_bind(const struct loaded_coff *lc, const char *name, u32 desc)
+{
+	struct lt_func *f;
+	const char *p;
+
+	if (map_find(&lt.descs, desc))
+		return;
+
+	if (lt.nfuncs == lt.funcs_cap) {
+		lt.funcs_cap = lt.funcs_cap ? lt.funcs_cap * 2 : 256;
+		lt.funcs     = realloc(lt.funcs, lt.funcs_cap * sizeof(*lt.funcs));
+		if (!lt.funcs)
+			errx(1, "Unable to allocate ltrace functions!\n");
+	}
+
+	f = calloc(1, sizeof(*f));
+	if (!f)
+		errx(1, "Unable to allocate ltrace functions!\n");
+
+	p         = strrchr(lc->name, '/');
+	f->lc     = lc;
+	f->module = p ? p + 1 : lc->name;
+	f->name   = name;
+	f->desc   = desc;
+
+	lt.funcs[lt.nfuncs++] = f;
+	map_insert(&lt.descs, desc, f);
+
+	if (lt.started)
+		install(f);
+}
+
+/**
+ * @brief Hook all the functions bound so far, called once everything
+ * is loaded, right before running the program.
+ */
+void ltrace_start(void)
+{
+	u32 i;
+
+	if (!ltrace_enabled)
+		return;
+
+	for (i = 0; i < lt.nfuncs; i++)
+		install(lt.funcs[i]);
+
+	lt.started  = 1;
+	lt.start_ns = stats_now_ns();
+}
+
+/**
+ * @brief Compare functions by inclusive time, then calls (descending).
+ */
+static int cmp_func(const void *a, const void *b)
+{
+	const struct lt_func *fa = *(struct lt_func *const *)a;
+	const struct lt_func *fb = *(struct lt_func *const *)b;
+	if (fa->total_ns != fb->total_ns)
+		return (fa->total_ns < fb->total_ns) ? 1 : -1;
+	if (fa->calls != fb->calls)
+		return (fa->calls < fb->calls) ? 1 : -1;
+	return 0;
+}
+
+/**
+ * @brief Print the per-function summary, called at exit.
+ *
+ * Calls still in progress (e.g., exit() itself) are timed up to now.
+ * Times are inclusive, so nested calls (e.g., libc into libpthreads)
+ * are accounted on both.
+ */
+static void ltrace_report(void)
+{
+	struct lt_caller *c;
+	struct lt_func *f;
+	u64 now, elapsed, calls;
+	u32 i, n, hooked;
+
+	now     = stats_now_ns();
+	elapsed = now - lt.start_ns;
+	for (i = 0; i < lt.depth; i++)
+		account(&lt.stack[i], now - lt.stack[i].start);
+
+	if (lt.log)
+		fclose(lt.log);
+
+	for (i = 0, calls = 0, hooked = 0; i < lt.nfuncs; i++) {
+		calls  += lt.funcs[i]->calls;
+		hooked += !!lt.funcs[i]->entry;
+	}
+	qsort(lt.funcs, lt.nfuncs, sizeof(*lt.funcs), cmp_func);
+
+	fprintf(stderr, "\n[ltrace] %" PRIu64 " inter-module calls, %u functions "
+		"hooked (%u bound), %.6f s traced, %u unfinished, %" PRIu64
+		" unwound:\n", calls, hooked, lt.nfuncs, elapsed / 1e9, lt.depth,
+		lt.unwound);
+	fprintf(stderr, "[ltrace] %% time     seconds  usecs/call     calls"
+		"   min(us)   max(us)  function / callers\n");
+
+	for (i = 0, n = 0; i < lt.nfuncs && n < LT_TOP_FUNCS; i++) {
+		f = lt.funcs[i];
+		if (!f->calls)
+			continue;
+		n++;
+		fprintf(stderr, "[ltrace] %6.2f %11.6f %11" PRIu64 " %9" PRIu64
+			" %9" PRIu64 " %9" PRIu64 "  %s`%s\n",
+			elapsed ? f->total_ns * 100.0 / elapsed : 0.0,
+			f->total_ns / 1e9, f->total_ns / f->calls / 1000, f->calls,
+			f->min_ns / 1000, f->max_ns / 1000, f->module, f->name);
+		for (c = f->callers; c; c = c->next) {
+			fprintf(stderr, "[ltrace]        %11.6f %11" PRIu64 " %9" PRIu64
+				"                      <- %s\n", c->total_ns / 1e9,
+				c->total_ns / c->calls / 1000, c->calls, c->module);
+		}
+	}
+}
+
+/**
+ * @brief Enable the inter-library call tracer: must be called before
+ * loading the program, the summary is printed at exit.
+ *
+ * @param uc  Unicorn context.
+ * @param log Streaming log file (one line per call and return), or
+ *            NULL.
+ */
+void ltrace_init(uc_engine *uc, const char *log)
+{
+	lt.uc = uc;
+	if (log) {
+		lt.log = fopen(log, "w");
+		if (!lt.log)
+			errx(1, "Unable to open ltrace log (%s)!\n", log);
+	}
+	ltrace_enabled = 1;
+	atexit(ltrace_report);
+}
@@ -0,0 +1,28 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef LTRACE_H
+#define LTRACE_H
+
+/*
+ * Inter-library call tracer (--ltrace): the functions bound by the
+ * loader while resolving imports get a code hook on their entry point
+ * (and only there), and each return address seen gets a code hook
+ * too. Calls coming from another module are counted and timed
+ * (inclusive time, i.e., callees included), per function and per
+ * caller module, and optionally logged as they happen.
+ */
+
+#include "loader.h"
+
+extern int ltrace_enabled;
+
+extern void ltrace_init(uc_engine *uc, const char *log);
+extern void ltrace_bind(const struct loaded_coff *lc, const char *name,
+	u32 desc);
+extern void ltrace_start(void);
+
+#endif /* LTRACE_H */
@@ -17,6 +17,9 @@
 #include "mm.h"
 #include "util.h"
 #include "loader.h"
+#include "overhead.h"
+#include "stats.h"
+#include "sym.h"
 #include "unix.h"
 
 /* Memory Management. */
@@ -174,11 +177,13 @@ void mm_alloc_main_exec_memory(
 		errx(1, "Main exec .data at 0x%x outside range!\n", data_vaddr);
 
 	/* Allocate using generic function (map full 16MiB regions). */
+	STATS_BEGIN(lcoff->stats_id, STATS_MAP);
 	mm_alloc_memory(
 		TEXT_START, EXEC_TEXT_SIZE, TEXT_END,
 		DATA_START, EXEC_DATA_SIZE, DATA_END,
 		bss_vaddr, bss_size,
 		0, 0, 0, lcoff);  /* All deltas are 0 for main executable */
+	STATS_END();
 }
 
 /**
@@ -234,11 +239,13 @@ int mm_alloc_library_memory(
 	bss_delta = bss_runtime - bss_vaddr;
 
 	/* Allocate using generic function. */
+	STATS_BEGIN(lcoff->stats_id, STATS_MAP);
 	mm_alloc_memory(
 		text_runtime, tsize, TEXT_END,
 		data_runtime, dsize, DATA_END,
 		bss_runtime, bss_size,
 		text_delta, data_delta, bss_delta, lcoff);
+	STATS_END();
 
 	/* Update bump allocators. */
 	next_text_base += tsize;
@@ -270,8 +277,11 @@ void mm_write_text(struct loaded_coff *lcoff, int is_exe)
 	text_buff = lcoff->xcoff.buff + text_sec->s_scnptr;
 	vaddr     = (is_exe ? text_sec->s_vaddr : lcoff->text_start);
 
+	STATS_BEGIN(lcoff->stats_id, STATS_COPY);
 	if (uc_mem_write(g_uc, vaddr, text_buff, aux->o_tsize))
 		errx(1, "Failed to write .text at 0x%x!\n", vaddr);
+	STATS_END();
+	STATS_ADD(lcoff->stats_id, STATS_BYTES, aux->o_tsize);
 }
 
 /**
@@ -297,8 +307,11 @@ void mm_write_data(struct loaded_coff *lcoff, int is_exe)
 	data_buff = lcoff->xcoff.buff + data_sec->s_scnptr;
 	vaddr     = (is_exe ? data_sec->s_vaddr : lcoff->data_start);
 
+	STATS_BEGIN(lcoff->stats_id, STATS_COPY);
 	if (uc_mem_write(g_uc, vaddr, data_buff, aux->o_dsize))
 		errx(1, "Failed to write .data at 0x%x!\n", vaddr);
+	STATS_END();
+	STATS_ADD(lcoff->stats_id, STATS_BYTES, aux->o_dsize);
 }
 
 /**
@@ -354,8 +367,11 @@ static void
 hook_invalid_mem(uc_engine *uc, uc_mem_type type, uint64_t addr, int size,
 	int64_t value, void *user_data)
 {
+	char sym[SYM_FORMAT_LEN];
+	u32 pc;
 	((void)user_data);
 
+	OVH_HOOK(OVH_HOOK_MEM_FAULT);
 	switch (type) {
 	case UC_MEM_WRITE_UNMAPPED:
 		warn("\n\n>>> INVALID WRITE AT UNMAPPED ADDRESS <<<\n");
@@ -381,7 +397,10 @@ hook_invalid_mem(uc_engine *uc, uc_mem_type type, uint64_t addr, int size,
 		break;
 	}
 
+	uc_reg_read(uc, UC_PPC_REG_PC, &pc);
+	warn("PC: %s\n", sym_format(uc, pc, sym, sizeof sym));
 	register_dump(uc);
+	OVH_END();
 }
 
 /**
@@ -393,11 +412,14 @@ hook_invalid_mem(uc_engine *uc, uc_mem_type type, uint64_t addr, int size,
  * an unhandled exception instead, see insn_emu.c
  */
 static void hook_invalid_insn(uc_engine *uc, void *data) {
+	char sym[SYM_FORMAT_LEN];
 	u32 pc;
+	OVH_HOOK(OVH_HOOK_INSN_FAULT);
 	uc_reg_read(uc, UC_PPC_REG_PC, &pc);
 	warn("\n\n>>> INVALID INSN <<<\n");
-	warn("ADDR: 0x%x\n", pc);
+	warn("ADDR: %s\n", sym_format(uc, pc, sym, sizeof sym));
 	register_dump(uc);
+	OVH_END();
 }
 
 /**
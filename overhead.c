@@ -0,0 +1,215 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "overhead.h"
+#include "stats.h"
+
+#define OVH_MAX_DEPTH 16
+
+int overhead_enabled;
+
+static struct {
+	int human;                 /* One-line summary on stderr. */
+	const char *json_file;     /* JSON report file, or NULL.  */
+	u64 start_wall;            /* overhead_init() time.       */
+	u64 start_cpu;
+
+	u64 wall[OVH_NBUCKETS];
+	u64 cpu[OVH_NBUCKETS];
+	u64 hooks[OVH_NHOOKS];
+
+	/* Buckets being timed. */
+	struct {
+		enum ovh_bucket bucket;
+		u64 wall;
+		u64 cpu;
+		u64 child_wall;        /* Time spent in nested buckets. */
+		u64 child_cpu;
+	} stack[OVH_MAX_DEPTH];
+	int depth;
+} ovh;
+
+static const char *const bucket_names[OVH_NBUCKETS] = {
+	"guest", "hooks", "host_syscalls", "gdb_pause"
+};
+
+static const char *const hook_names[OVH_NHOOKS] = {
+	"syscall", "insn_emu", "mem_fault", "insn_fault", "gdb", "ltrace",
+	"bbcount", "flightrec"
+};
+
+/**
+ * @brief Get the CPU time of the calling (main) thread, in nanoseconds.
+ */
+static u64 cpu_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Start timing the bucket @p bucket.
+ */
+void overhead_begin(enum ovh_bucket bucket)
+{
+	if (ovh.depth < OVH_MAX_DEPTH) {
+		ovh.stack[ovh.depth].bucket     = bucket;
+		ovh.stack[ovh.depth].wall       = stats_now_ns();
+		ovh.stack[ovh.depth].cpu        = cpu_now_ns();
+		ovh.stack[ovh.depth].child_wall = 0;
+		ovh.stack[ovh.depth].child_cpu  = 0;
+	}
+	ovh.depth++;
+}
+
+/**
+ * @brief Count a firing of the hook @p hook, and start timing it.
+ */
+void overhead_hook(enum ovh_hook hook)
+{
+	ovh.hooks[hook]++;
+	overhead_begin(OVH_HOOK);
+}
+
+/**
+ * @brief Count a firing of the hook @p hook, without timing it.
+ */
+void overhead_count(enum ovh_hook hook)
+{
+	ovh.hooks[hook]++;
+}
+
+/**
+ * @brief Finish timing the bucket started by the last overhead_begin().
+ */
+void overhead_end(void)
+{
+	u64 wall, cpu;
+	int d;
+
+	d = --ovh.depth;
+	if (d < 0 || d >= OVH_MAX_DEPTH) {
+		if (d < 0)
+			ovh.depth = 0;
+		return;
+	}
+
+	wall = stats_now_ns() - ovh.stack[d].wall;
+	cpu  = cpu_now_ns()   - ovh.stack[d].cpu;
+	ovh.wall[ovh.stack[d].bucket] += wall - ovh.stack[d].child_wall;
+	ovh.cpu[ovh.stack[d].bucket]  += cpu  - ovh.stack[d].child_cpu;
+	if (d > 0) {
+		ovh.stack[d - 1].child_wall += wall;
+		ovh.stack[d - 1].child_cpu  += cpu;
+	}
+}
+
+/**
+ * @brief Print the buckets of @p ns (out of @p total) as percentages.
+ */
+static void human_buckets(const u64 *ns, u64 total)
+{
+	u64 sum = 0;
+	u32 i;
+
+	for (i = 0; i < OVH_NBUCKETS; i++) {
+		fprintf(stderr, " %s %.1f%%,", bucket_names[i],
+			total ? ns[i] * 100.0 / total : 0.0);
+		sum += ns[i];
+	}
+	fprintf(stderr, " other %.1f%%", (total && total > sum) ?
+		(total - sum) * 100.0 / total : 0.0);
+}
+
+/**
+ * @brief Save the JSON report into the file @p file.
+ */
+static void report_json(const char *file, u64 wall, u64 cpu)
+{
+	FILE *f;
+	u32 i;
+
+	f = fopen(file, "w");
+	if (!f) {
+		warn("Unable to open overhead file (%s)!\n", file);
+		return;
+	}
+
+	fprintf(f, "{\n  \"wall_ns\": %" PRIu64 ",\n  \"cpu_ns\": %" PRIu64
+		",\n  \"wall\": {", wall, cpu);
+	for (i = 0; i < OVH_NBUCKETS; i++)
+		fprintf(f, "%s\"%s_ns\": %" PRIu64, i ? ", " : "", bucket_names[i],
+			ovh.wall[i]);
+	fprintf(f, "},\n  \"cpu\": {");
+	for (i = 0; i < OVH_NBUCKETS; i++)
+		fprintf(f, "%s\"%s_ns\": %" PRIu64, i ? ", " : "", bucket_names[i],
+			ovh.cpu[i]);
+	fprintf(f, "},\n  \"hooks\": {");
+	for (i = 0; i < OVH_NHOOKS; i++)
+		fprintf(f, "%s\"%s\": %" PRIu64, i ? ", " : "", hook_names[i],
+			ovh.hooks[i]);
+	fprintf(f, "}\n}\n");
+	fclose(f);
+}
+
+/**
+ * @brief Emit the reports, called at exit.
+ *
+ * The program usually exits from within a hook (the exit syscall), so
+ * the buckets still open are closed first.
+ */
+static void overhead_report(void)
+{
+	u64 wall, cpu;
+	u32 i;
+
+	while (ovh.depth > 0)
+		overhead_end();
+
+	wall = stats_now_ns() - ovh.start_wall;
+	cpu  = cpu_now_ns()   - ovh.start_cpu;
+
+	if (ovh.human) {
+		fprintf(stderr, "\n[overhead] wall %.3f s:", wall / 1e9);
+		human_buckets(ovh.wall, wall);
+		fprintf(stderr, " | cpu %.3f s:", cpu / 1e9);
+		human_buckets(ovh.cpu, cpu);
+		fprintf(stderr, " | hooks:");
+		for (i = 0; i < OVH_NHOOKS; i++)
+			fprintf(stderr, " %s %" PRIu64, hook_names[i], ovh.hooks[i]);
+		fprintf(stderr, "\n");
+	}
+	if (ovh.json_file)
+		report_json(ovh.json_file, wall, cpu);
+
+	overhead_enabled = 0;
+}
+
+/**
+ * @brief Enable the overhead breakdown, right before running the
+ * program: reports are emitted at exit.
+ *
+ * @param human     Print a one-line summary on stderr.
+ * @param json_file Save a JSON report on this file (if not NULL).
+ */
+void overhead_init(int human, const char *json_file)
+{
+	if (!human && !json_file)
+		return;
+
+	ovh.human        = human;
+	ovh.json_file    = json_file;
+	ovh.start_wall   = stats_now_ns();
+	ovh.start_cpu    = cpu_now_ns();
+	overhead_enabled = 1;
+	atexit(overhead_report);
+}
@@ -0,0 +1,77 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef OVERHEAD_H
+#define OVERHEAD_H
+
+/*
+ * Emulator overhead breakdown: splits the wall and (main thread) CPU
+ * time of the run into guest execution (translated code, inside
+ * uc_emu_start()), host hook callbacks, host syscalls issued on behalf
+ * of the guest, and GDB pauses, plus how many times each hook fired.
+ *
+ * Buckets nest (e.g., a host write() inside the syscall hook, inside
+ * uc_emu_start()), so each one only accounts its own (self) time.
+ * All the macros below are a single (predicted) branch when disabled.
+ */
+
+#include "util.h"
+
+/* Time buckets. */
+enum ovh_bucket {
+	OVH_GUEST,       /* Inside uc_emu_start().          */
+	OVH_HOOK,        /* Host hook callbacks.            */
+	OVH_HOST,        /* Host syscalls, for the guest.   */
+	OVH_PAUSE,       /* Stopped in GDB.                 */
+	OVH_NBUCKETS
+};
+
+/* Hook types. */
+enum ovh_hook {
+	OVH_HOOK_SYSCALL,    /* Syscall entry point.        */
+	OVH_HOOK_INSN_EMU,   /* Emulated instruction trap.  */
+	OVH_HOOK_MEM_FAULT,  /* Invalid memory access.      */
+	OVH_HOOK_INSN_FAULT, /* Invalid instruction.        */
+	OVH_HOOK_GDB,        /* Breakpoint/watchpoint/step. */
+	OVH_HOOK_LTRACE,     /* --ltrace entry/return.      */
+	OVH_HOOK_BBCOUNT,    /* --bbcount block.            */
+	OVH_HOOK_FLIGHTREC,  /* --flightrec-blocks block.   */
+	OVH_NHOOKS
+};
+
+extern int overhead_enabled;
+
+#define OVH_BEGIN(bucket) \
+	do { \
+		if (overhead_enabled) \
+			overhead_begin((bucket)); \
+	} while (0)
+
+#define OVH_HOOK(hook) \
+	do { \
+		if (overhead_enabled) \
+			overhead_hook((hook)); \
+	} while (0)
+
+#define OVH_COUNT(hook) \
+	do { \
+		if (overhead_enabled) \
+			overhead_count((hook)); \
+	} while (0)
+
+#define OVH_END() \
+	do { \
+		if (overhead_enabled) \
+			overhead_end(); \
+	} while (0)
+
+extern void overhead_init(int human, const char *json_file);
+extern void overhead_begin(enum ovh_bucket bucket);
+extern void overhead_hook(enum ovh_hook hook);
+extern void overhead_count(enum ovh_hook hook);
+extern void overhead_end(void);
+
+#endif /* OVERHEAD_H */
@@ -0,0 +1,291 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+#include "sym.h"
+
+/* Maximum amount of frames of a sample. */
+#define PROFILE_MAX_DEPTH 128
+
+/* Unique stack, and how many times it was sampled. */
+struct prof_stack {
+	u32 hash;
+	u32 depth;
+	u64 count;
+	u32 *pcs;                /* Leaf first. */
+	struct prof_stack *next;
+};
+
+/* Folded stack line, see profile_flush(). */
+struct prof_line {
+	char *stack;
+	u64 count;
+};
+
+int profile_enabled;
+
+static struct {
+	const char *file;        /* Output file.                         */
+	uc_engine *uc;
+	u64 interval_ns;         /* Sampling interval.                   */
+	int pending;             /* Sampler asked for a stop.            */
+	int stopping;            /* Sampler thread should finish.        */
+	pthread_t thread;
+
+	struct prof_stack **buckets;
+	u32 nbuckets;            /* Power of 2.                          */
+	u32 nstacks;
+	u64 nsamples;
+	u64 truncated;           /* Samples deeper than the max depth.   */
+} prof;
+
+/**
+ * @brief Sampler thread: periodically stops the emulation, so the main
+ * loop takes a sample.
+ */
+static void *sampler(void *arg)
+{
+	struct timespec next;
+	((void)arg);
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!__atomic_load_n(&prof.stopping, __ATOMIC_ACQUIRE)) {
+		next.tv_nsec += prof.interval_ns;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		__atomic_store_n(&prof.pending, 1, __ATOMIC_RELEASE);
+		uc_emu_stop(prof.uc);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Hash a stack (FNV-1a).
+ */
+static u32 stack_hash(const u32 *pcs, u32 depth)
+{
+	u32 h = 2166136261u;
+	u32 i;
+	for (i = 0; i < depth; i++) {
+		h ^= pcs[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * @brief Double the stack hash table.
+ */
+static void grow_table(void)
+{
+	struct prof_stack **buckets, *s, *next;
+	u32 nbuckets, i;
+
+	nbuckets = prof.nbuckets ? prof.nbuckets * 2 : 1024;
+	buckets  = calloc(nbuckets, sizeof(*buckets));
+	if (!buckets)
+		errx(1, "Unable to allocate profile!\n");
+
+	for (i = 0; i < prof.nbuckets; i++) {
+		for (s = prof.buckets[i]; s; s = next) {
+			next = s->next;
+			s->next = buckets[s->hash & (nbuckets - 1)];
+			buckets[s->hash & (nbuckets - 1)] = s;
+		}
+	}
+	free(prof.buckets);
+	prof.buckets  = buckets;
+	prof.nbuckets = nbuckets;
+}
+
+/**
+ * @brief Account one sample of the stack @p pcs.
+ */
+static void add_sample(const u32 *pcs, u32 depth)
+{
+	struct prof_stack *s;
+	u32 h;
+
+	h = stack_hash(pcs, depth);
+	for (s = prof.buckets[h & (prof.nbuckets - 1)]; s; s = s->next) {
+		if (s->hash == h && s->depth == depth &&
+			!memcmp(s->pcs, pcs, depth * sizeof(*pcs)))
+		{
+			s->count++;
+			return;
+		}
+	}
+
+	if (prof.nstacks >= prof.nbuckets)
+		grow_table();
+
+	s = malloc(sizeof(*s));
+	if (!s || !(s->pcs = malloc(depth * sizeof(*pcs))))
+		errx(1, "Unable to allocate profile!\n");
+
+	memcpy(s->pcs, pcs, depth * sizeof(*pcs));
+	s->hash  = h;
+	s->depth = depth;
+	s->count = 1;
+	s->next  = prof.buckets[h & (prof.nbuckets - 1)];
+	prof.buckets[h & (prof.nbuckets - 1)] = s;
+	prof.nstacks++;
+}
+
+/**
+ * @brief Handles an emulation stop requested by the sampler: takes a
+ * sample of the guest stack.
+ *
+ * @param uc Unicorn context.
+ * @param pc Returned PC, where the emulation should resume.
+ *
+ * @return Returns 1 if the emulation should resume at @p pc, 0
+ * otherwise.
+ */
+int profile_handle_stop(uc_engine *uc, u32 *pc)
+{
+	u32 pcs[PROFILE_MAX_DEPTH];
+	u32 depth;
+
+	if (!__atomic_exchange_n(&prof.pending, 0, __ATOMIC_ACQ_REL))
+		return 0;
+
+	if (uc_reg_read(uc, UC_PPC_REG_PC, pc))
+		errx(1, "Unable to read PC!\n");
+
+	depth = sym_unwind(uc, *pc, pcs, PROFILE_MAX_DEPTH);
+	if (depth == PROFILE_MAX_DEPTH)
+		prof.truncated++;
+	add_sample(pcs, depth);
+	prof.nsamples++;
+	return 1;
+}
+
+/**
+ * @brief Append the frame name of @p pc into @p f.
+ */
+static void put_frame(FILE *f, u32 pc)
+{
+	const char *module, *name;
+	u32 off;
+
+	name = sym_lookup(prof.uc, pc, &module, &off);
+	if (name)
+		fprintf(f, "%s`%s", module, name);
+	else if (module)
+		fprintf(f, "%s`0x%x", module, off);
+	else
+		fprintf(f, "0x%08x", pc);
+}
+
+/**
+ * @brief Compare two folded lines by stack.
+ */
+static int cmp_line(const void *a, const void *b)
+{
+	const struct prof_line *la = a, *lb = b;
+	return strcmp(la->stack, lb->stack);
+}
+
+/**
+ * @brief Symbolize the samples and save them as folded stacks, called
+ * at exit.
+ *
+ * Distinct PCs of the same function fold into the same line, so the
+ * lines are sorted and merged before being written.
+ */
+static void profile_flush(void)
+{
+	struct prof_line *lines;
+	struct prof_stack *s;
+	size_t len;
+	FILE *f;
+	u32 i, j, n;
+
+	__atomic_store_n(&prof.stopping, 1, __ATOMIC_RELEASE);
+
+	lines = calloc(prof.nstacks ? prof.nstacks : 1, sizeof(*lines));
+	if (!lines)
+		errx(1, "Unable to allocate profile!\n");
+
+	for (i = 0, n = 0; i < prof.nbuckets; i++) {
+		for (s = prof.buckets[i]; s; s = s->next, n++) {
+			f = open_memstream(&lines[n].stack, &len);
+			if (!f)
+				errx(1, "Unable to allocate profile!\n");
+			for (j = s->depth; j > 0; j--) {
+				put_frame(f, s->pcs[j - 1]);
+				if (j > 1)
+					fputc(';', f);
+			}
+			fclose(f);
+			lines[n].count = s->count;
+		}
+	}
+
+	if (n)
+		qsort(lines, n, sizeof(*lines), cmp_line);
+
+	f = fopen(prof.file, "w");
+	if (!f)
+		warn("Unable to open profile file (%s)!\n", prof.file);
+
+	for (i = 0; i < n; i = j) {
+		for (j = i + 1; j < n && !strcmp(lines[i].stack, lines[j].stack); j++)
+			lines[i].count += lines[j].count;
+		if (f)
+			fprintf(f, "%s %" PRIu64 "\n", lines[i].stack, lines[i].count);
+	}
+
+	if (f) {
+		fclose(f);
+		warn("[profile] %" PRIu64 " samples (%u unique stacks, %" PRIu64
+			" truncated) saved into %s\n", prof.nsamples, prof.nstacks,
+			prof.truncated, prof.file);
+	}
+
+	for (i = 0; i < n; i++)
+		free(lines[i].stack);
+	free(lines);
+}
+
+/**
+ * @brief Enable the sampling profiler: the samples are saved at exit
+ * into @p file.
+ *
+ * @param uc   Unicorn context.
+ * @param file Output file (folded stacks), or NULL.
+ * @param hz   Sampling frequency, in samples per second.
+ */
+void profile_init(uc_engine *uc, const char *file, int hz)
+{
+	if (!file)
+		return;
+
+	prof.file        = file;
+	prof.uc          = uc;
+	prof.interval_ns = 1000000000ULL / hz;
+	grow_table();
+
+	if (pthread_create(&prof.thread, NULL, sampler, NULL))
+		errx(1, "Unable to start the profiler thread!\n");
+	pthread_detach(prof.thread);
+
+	profile_enabled = 1;
+	atexit(profile_flush);
+}
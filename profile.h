@@ -0,0 +1,28 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * Sampling guest profiler (--profile): a host thread periodically
+ * stops the emulation (uc_emu_stop()), the main loop then samples the
+ * guest stack (PC + AIX back-chain) and resumes. At exit, the samples
+ * are symbolized (see sym.h) and saved as folded stacks, ready for
+ * flamegraph.pl and friends.
+ */
+
+#include "util.h"
+
+#define PROFILE_DEFAULT_HZ 99
+#define PROFILE_MAX_HZ     10000
+
+extern int profile_enabled;
+
+extern void profile_init(uc_engine *uc, const char *file, int hz);
+extern int  profile_handle_stop(uc_engine *uc, u32 *pc);
+
+#endif /* PROFILE_H */
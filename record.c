@@ -0,0 +1,345 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "record.h"
+#include "unix.h"
+
+#define RR_MAGIC      "AIXRR01"   /* 8 bytes, NUL included.     */
+#define RR_MAX_STR    (1 << 20)   /* Sanity limit for strings.  */
+#define RR_MAX_WRITE  (1 << 30)   /* Sanity limit for 'W' data. */
+
+/* Abort the replay, without complaining about the rest of the log. */
+#define rr_fail(...) \
+	do { \
+		rr.failed = 1; \
+		errx(1, __VA_ARGS__); \
+	} while (0)
+
+int rr_mode;
+
+static struct {
+	FILE *f;
+	const char *file;
+	u64 nsys;          /* Syscalls so far.                    */
+	u32 errno_before;  /* Guest errno on rr_begin() (record). */
+	int failed;        /* Replay aborted.                     */
+} rr;
+
+/**
+ * @brief Write @p n bytes from @p p into the log.
+ */
+static void put(const void *p, size_t n)
+{
+	if (fwrite(p, 1, n, rr.f) != n)
+		errx(1, "record: unable to write into %s!\n", rr.file);
+}
+
+/**
+ * @brief Read @p n bytes from the log into @p p.
+ */
+static void get(void *p, size_t n)
+{
+	if (fread(p, 1, n, rr.f) != n)
+		rr_fail("replay: %s ended unexpectedly, at syscall #%" PRIu64 "!\n",
+			rr.file, rr.nsys);
+}
+
+static void put_str(const char *s)
+{
+	u32 len = strlen(s);
+	put(&len, sizeof len);
+	put(s, len);
+}
+
+static char *get_str(void)
+{
+	u32 len;
+	char *s;
+
+	get(&len, sizeof len);
+	if (len > RR_MAX_STR)
+		rr_fail("replay: %s is corrupted!\n", rr.file);
+	s = malloc(len + 1);
+	if (!s)
+		rr_fail("replay: unable to allocate string!\n");
+	get(s, len);
+	s[len] = '\0';
+	return s;
+}
+
+/**
+ * @brief Read the guest errno, or 0 if the program does not use it.
+ */
+static u32 guest_errno(uc_engine *uc)
+{
+	u32 err;
+	if (!vm_errno || uc_mem_read(uc, vm_errno, &err, sizeof err))
+		return 0;
+	return ntohl(err);
+}
+
+/**
+ * @brief Record a write of @p len bytes of @p buff into the guest
+ * address @p addr, made by the current syscall.
+ */
+void rr_mem_write(u32 addr, const void *buff, u32 len)
+{
+	u8 tag = 'W';
+	put(&tag, 1);
+	put(&addr, sizeof addr);
+	put(&len, sizeof len);
+	put(buff, len);
+}
+
+/**
+ * @brief Read the next syscall from the log and check that it matches
+ * the syscall @p name with arguments @p argv.
+ */
+static void expect_call(const char *name, const u32 *argv)
+{
+	char lname[256];
+	u32 largv[4];
+	u8 tag, len;
+
+	rr.nsys++;
+	get(&tag, 1);
+	if (tag != 'S')
+		rr_fail("replay: divergence at syscall #%" PRIu64 " (%s): the log "
+			"has no syscall there!\n", rr.nsys, name);
+
+	get(&len, 1);
+	get(lname, len);
+	lname[len] = '\0';
+	get(largv, sizeof largv);
+
+	if (strcmp(lname, name) || memcmp(largv, argv, sizeof largv)) {
+		rr_fail("replay: divergence at syscall #%" PRIu64 ": got "
+			"%s(0x%x, 0x%x, 0x%x, 0x%x), but the log has "
+			"%s(0x%x, 0x%x, 0x%x, 0x%x)!\n", rr.nsys,
+			name,  argv[0],  argv[1],  argv[2],  argv[3],
+			lname, largv[0], largv[1], largv[2], largv[3]);
+	}
+}
+
+/**
+ * @brief Read the results of the current syscall from the log: if
+ * @p apply, its memory writes and errno are applied into the guest.
+ *
+ * @return Returns the recorded return value.
+ */
+static int read_results(uc_engine *uc, int apply)
+{
+	u32 addr, len, err;
+	u8 tag, has_errno;
+	void *buff;
+	int ret;
+
+	for (;;) {
+		get(&tag, 1);
+		if (tag == 'R')
+			break;
+		if (tag != 'W')
+			rr_fail("replay: %s is corrupted!\n", rr.file);
+
+		get(&addr, sizeof addr);
+		get(&len, sizeof len);
+		if (len > RR_MAX_WRITE)
+			rr_fail("replay: %s is corrupted!\n", rr.file);
+		buff = malloc(len ? len : 1);
+		if (!buff)
+			rr_fail("replay: unable to allocate %u bytes!\n", len);
+		get(buff, len);
+		if (apply && uc_mem_write(uc, addr, buff, len))
+			rr_fail("replay: unable to write into guest 0x%08x, "
+				"at syscall #%" PRIu64 "!\n", addr, rr.nsys);
+		free(buff);
+	}
+
+	get(&ret, sizeof ret);
+	get(&has_errno, 1);
+	get(&err, sizeof err);
+	if (apply && has_errno)
+		unix_set_errno(err);
+	return ret;
+}
+
+/**
+ * @brief Start a syscall @p name, with arguments @p argv, that is
+ * going to be executed: recorded, or checked against the log.
+ */
+void rr_begin(uc_engine *uc, const char *name, const u32 *argv)
+{
+	u8 tag = 'S';
+	u8 len;
+
+	if (rr_mode == RR_REPLAY) {
+		expect_call(name, argv);
+		return;
+	}
+
+	len = min(strlen(name), 255);
+	put(&tag, 1);
+	put(&len, 1);
+	put(name, len);
+	put(argv, 4 * sizeof(*argv));
+	rr.errno_before = guest_errno(uc);
+}
+
+/**
+ * @brief Finish the syscall started by rr_begin(), that returned
+ * @p ret: record its results, or check them against the log.
+ *
+ * @return Returns @p ret.
+ */
+int rr_end(uc_engine *uc, int ret)
+{
+	u8 tag = 'R';
+	u8 has_errno;
+	int lret;
+	u32 err;
+
+	if (rr_mode == RR_REPLAY) {
+		lret = read_results(uc, 0);
+		if (lret != ret)
+			rr_fail("replay: divergence at syscall #%" PRIu64 ": returned "
+				"0x%x, but the log has 0x%x!\n", rr.nsys, ret, lret);
+		return ret;
+	}
+
+	err       = guest_errno(uc);
+	has_errno = (err != rr.errno_before);
+	put(&tag, 1);
+	put(&ret, sizeof ret);
+	put(&has_errno, 1);
+	put(&err, sizeof err);
+	return ret;
+}
+
+/**
+ * @brief Serve the syscall @p name, with arguments @p argv, from the
+ * log, without running it.
+ *
+ * @param uc   Unicorn context.
+ * @param name Syscall name.
+ * @param argv First 4 arguments.
+ * @param echo Output syscall (fd, buffer, count): the data written
+ *             into stdout/stderr is still shown.
+ *
+ * @return Returns the recorded return value.
+ */
+int rr_replay(uc_engine *uc, const char *name, const u32 *argv, int echo)
+{
+	void *buff;
+	int ret;
+
+	expect_call(name, argv);
+	ret = read_results(uc, 1);
+
+	if (echo && (argv[0] == 1 || argv[0] == 2) && ret > 0) {
+		buff = malloc(ret);
+		if (buff && !uc_mem_read(uc, argv[1], buff, ret)) {
+			if (write(argv[0], buff, ret) < 0)
+				warn("replay: unable to echo %s output!\n", name);
+		}
+		free(buff);
+	}
+	return ret;
+}
+
+/**
+ * @brief Close the log, called at exit.
+ */
+static void rr_close(void)
+{
+	if (rr_mode == RR_REPLAY && !rr.failed && fgetc(rr.f) != EOF)
+		warn("replay: the program exited after %" PRIu64 " syscalls, "
+			"before the end of %s!\n", rr.nsys, rr.file);
+	fclose(rr.f);
+}
+
+/**
+ * @brief Enable the syscall record or replay, before setting up the
+ * guest stack.
+ *
+ * On record, the guest arguments and environment are saved. On
+ * replay, they are replaced by the recorded ones, as they change the
+ * guest stack layout (and thus the syscall arguments); the program
+ * is still loaded from the command line.
+ *
+ * @param record Log to record into, or NULL.
+ * @param replay Log to replay from, or NULL.
+ * @param argc   Guest argument count (updated on replay).
+ * @param argv   Guest arguments (updated on replay).
+ * @param envp   Guest environment (updated on replay).
+ */
+void rr_init(const char *record, const char *replay, int *argc,
+	const char ***argv, const char ***envp)
+{
+	char magic[sizeof RR_MAGIC];
+	const char **p;
+	u32 n, i;
+
+	if (!record && !replay)
+		return;
+	if (record && replay)
+		errx(1, "--record and --replay are mutually exclusive!\n");
+
+	rr.file = record ? record : replay;
+	rr.f    = fopen(rr.file, record ? "wb" : "rb");
+	if (!rr.f)
+		errx(1, "Unable to open syscall log (%s)!\n", rr.file);
+
+	if (record) {
+		rr_mode = RR_RECORD;
+		put(RR_MAGIC, sizeof RR_MAGIC);
+		n = *argc;
+		put(&n, sizeof n);
+		for (i = 0; i < n; i++)
+			put_str((*argv)[i]);
+		for (n = 0, p = *envp; *p; p++)
+			n++;
+		put(&n, sizeof n);
+		for (i = 0; i < n; i++)
+			put_str((*envp)[i]);
+		atexit(rr_close);
+		return;
+	}
+
+	rr_mode = RR_REPLAY;
+	get(magic, sizeof magic);
+	if (memcmp(magic, RR_MAGIC, sizeof magic))
+		rr_fail("replay: %s is not a syscall log!\n", rr.file);
+
+	get(&n, sizeof n);
+	if (n > RR_MAX_STR)
+		rr_fail("replay: %s is corrupted!\n", rr.file);
+	p = calloc(n + 1, sizeof(*p));
+	if (!p)
+		rr_fail("replay: unable to allocate arguments!\n");
+	for (i = 0; i < n; i++)
+		p[i] = get_str();
+	*argc = n;
+	*argv = p;
+
+	get(&n, sizeof n);
+	if (n > RR_MAX_STR)
+		rr_fail("replay: %s is corrupted!\n", rr.file);
+	p = calloc(n + 1, sizeof(*p));
+	if (!p)
+		rr_fail("replay: unable to allocate environment!\n");
+	for (i = 0; i < n; i++)
+		p[i] = get_str();
+	*envp = p;
+
+	atexit(rr_close);
+}
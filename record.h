@@ -0,0 +1,44 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+/*
+ * Syscall record/replay: --record saves the guest argv/envp and, for
+ * every syscall, its arguments, the guest memory written on behalf of
+ * the guest (see sys_mem_write()), errno and the return value into a
+ * compact binary log (host byte order). --replay serves the syscalls
+ * that touch the host (SYS_F_HOST) from the log without running them,
+ * runs the others, and aborts on the first divergence. The guest gets
+ * the recorded argv/envp, as they shape its stack.
+ *
+ * Log layout: header ("AIXRR01\0", argc + argv, envc + envp, each
+ * string as u32 length + bytes), then, per syscall, an 'S' entry
+ * (name, 4 arguments), zero or more 'W' entries (address, length,
+ * data) and an 'R' entry (return value, errno). A syscall that never
+ * returns (_exit) has no 'R' entry.
+ */
+
+#include "util.h"
+
+enum rr_mode {
+	RR_OFF,
+	RR_RECORD,
+	RR_REPLAY
+};
+
+extern int rr_mode;
+
+extern void rr_init(const char *record, const char *replay, int *argc,
+	const char ***argv, const char ***envp);
+extern void rr_begin(uc_engine *uc, const char *name, const u32 *argv);
+extern void rr_mem_write(u32 addr, const void *buff, u32 len);
+extern int rr_end(uc_engine *uc, int ret);
+extern int rr_replay(uc_engine *uc, const char *name, const u32 *argv,
+	int echo);
+
+#endif /* RECORD_H */
@@ -0,0 +1,301 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+#include "timeline.h"
+
+#define STATS_MAX_DEPTH 64
+
+/* Per-module statistics. */
+struct stats_mod {
+	char *name;
+	u64 ns[STATS_NPHASES];
+	u64 cnt[STATS_NCOUNTERS];
+};
+
+int stats_enabled;
+
+static struct {
+	int human;               /* Human-readable report on stderr. */
+	const char *json_file;   /* JSON report file, or NULL.       */
+	u64 start_ns;            /* stats_init() time.               */
+	u64 loaded_ns;           /* stats_loaded() time, or 0.       */
+
+	struct stats_mod *mods;
+	u32 nmods;
+	u32 capacity;
+
+	/* Phases being timed. */
+	struct {
+		u32 mod;
+		enum stats_phase phase;
+		u64 start;
+		u64 child;           /* Time spent in nested phases.     */
+	} stack[STATS_MAX_DEPTH];
+	int depth;
+} st;
+
+static const char *const phase_names[STATS_NPHASES] = {
+	"ar_open", "xcoff_parse", "map", "copy", "reloc", "import"
+};
+
+static const char *const counter_names[STATS_NCOUNTERS] = {
+	"relocations", "imports", "passthroughs", "bytes_copied"
+};
+
+/**
+ * @brief Get the current monotonic time, in nanoseconds.
+ */
+u64 stats_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Register a new module @p bin (or @p bin member @p member).
+ *
+ * @return Returns the module id to be used with the other functions.
+ */
+u32 stats_module(const char *bin, const char *member)
+{
+	struct stats_mod *m;
+	size_t len;
+
+	if (!stats_enabled)
+		return 0;
+
+	if (st.nmods == st.capacity) {
+		st.capacity = st.capacity ? st.capacity * 2 : 16;
+		st.mods = realloc(st.mods, st.capacity * sizeof(*st.mods));
+		if (!st.mods)
+			errx(1, "Unable to allocate stats!\n");
+	}
+
+	m = &st.mods[st.nmods];
+	memset(m, 0, sizeof(*m));
+
+	len = strlen(bin) + (member ? strlen(member) + 2 : 0) + 1;
+	m->name = malloc(len);
+	if (!m->name)
+		errx(1, "Unable to allocate stats!\n");
+	if (member)
+		snprintf(m->name, len, "%s(%s)", bin, member);
+	else
+		snprintf(m->name, len, "%s", bin);
+
+	return st.nmods++;
+}
+
+/**
+ * @brief Start timing the phase @p phase of the module @p mod.
+ */
+void stats_begin(u32 mod, enum stats_phase phase)
+{
+	if (st.depth < STATS_MAX_DEPTH) {
+		st.stack[st.depth].mod   = mod;
+		st.stack[st.depth].phase = phase;
+		st.stack[st.depth].start = stats_now_ns();
+		st.stack[st.depth].child = 0;
+	}
+	st.depth++;
+}
+
+/**
+ * @brief Finish timing the phase started by the last stats_begin().
+ */
+void stats_end(void)
+{
+	u64 elapsed;
+	int d;
+
+	d = --st.depth;
+	if (d < 0 || d >= STATS_MAX_DEPTH) {
+		if (d < 0)
+			st.depth = 0;
+		return;
+	}
+
+	elapsed = stats_now_ns() - st.stack[d].start;
+	if (st.stack[d].mod < st.nmods) {
+		st.mods[st.stack[d].mod].ns[st.stack[d].phase] +=
+			elapsed - st.stack[d].child;
+
+		if (timeline_enabled)
+			timeline_slice(TL_LOADER, phase_names[st.stack[d].phase],
+				st.mods[st.stack[d].mod].name, st.stack[d].start, elapsed,
+				NULL, 0);
+	}
+	if (d > 0)
+		st.stack[d - 1].child += elapsed;
+}
+
+/**
+ * @brief Add @p n to the counter @p counter of module @p mod.
+ */
+void stats_add(u32 mod, enum stats_counter counter, u64 n)
+{
+	if (mod < st.nmods)
+		st.mods[mod].cnt[counter] += n;
+}
+
+/**
+ * @brief Signals that the loading is over, i.e., the program is about
+ * to run.
+ */
+void stats_loaded(void)
+{
+	if (stats_enabled && !st.loaded_ns)
+		st.loaded_ns = stats_now_ns();
+}
+
+/**
+ * @brief Print the human-readable report into @p f.
+ */
+static void report_human(FILE *f, const struct stats_mod *total)
+{
+	const struct stats_mod *m;
+	u32 i, j;
+
+	fprintf(f, "\n[stats] Loader statistics, %u modules, load time: "
+		"%.3f ms\n", st.nmods,
+		st.loaded_ns ? (st.loaded_ns - st.start_ns) / 1e6 : 0.0);
+
+	fprintf(f, "%-40s", "Module (ms)");
+	for (i = 0; i < STATS_NPHASES; i++)
+		fprintf(f, " %11s", phase_names[i]);
+	for (i = 0; i < STATS_NCOUNTERS; i++)
+		fprintf(f, " %12s", counter_names[i]);
+	fprintf(f, "\n");
+
+	for (j = 0; j <= st.nmods; j++) {
+		m = (j < st.nmods) ? &st.mods[j] : total;
+		if (j == st.nmods)
+			fprintf(f, "%-40s", "Total");
+		else if (strlen(m->name) > 40)
+			fprintf(f, "...%-37s", m->name + strlen(m->name) - 37);
+		else
+			fprintf(f, "%-40s", m->name);
+
+		for (i = 0; i < STATS_NPHASES; i++)
+			fprintf(f, " %11.3f", m->ns[i] / 1e6);
+		for (i = 0; i < STATS_NCOUNTERS; i++)
+			fprintf(f, " %12" PRIu64, m->cnt[i]);
+		fprintf(f, "\n");
+	}
+}
+
+/**
+ * @brief Print the JSON string @p s into @p f.
+ */
+static void json_str(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((u8)*s < 0x20)
+			fprintf(f, "\\u%04x", (u8)*s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+/**
+ * @brief Print the phases/counters of @p m as JSON object members.
+ */
+static void json_mod(FILE *f, const struct stats_mod *m)
+{
+	u32 i;
+	for (i = 0; i < STATS_NPHASES; i++)
+		fprintf(f, "%s\"%s_ns\": %" PRIu64, i ? ", " : "",
+			phase_names[i], m->ns[i]);
+	for (i = 0; i < STATS_NCOUNTERS; i++)
+		fprintf(f, ", \"%s\": %" PRIu64, counter_names[i], m->cnt[i]);
+}
+
+/**
+ * @brief Save the JSON report into the file @p file.
+ */
+static void report_json(const char *file, const struct stats_mod *total)
+{
+	FILE *f;
+	u32 i;
+
+	f = fopen(file, "w");
+	if (!f) {
+		warn("Unable to open stats file (%s)!\n", file);
+		return;
+	}
+
+	fprintf(f, "{\n  \"load_time_ns\": %" PRIu64 ",\n",
+		st.loaded_ns ? st.loaded_ns - st.start_ns : 0);
+	fprintf(f, "  \"total\": {");
+	json_mod(f, total);
+	fprintf(f, "},\n  \"modules\": [");
+	for (i = 0; i < st.nmods; i++) {
+		fprintf(f, "%s\n    {\"name\": ", i ? "," : "");
+		json_str(f, st.mods[i].name);
+		fprintf(f, ", ");
+		json_mod(f, &st.mods[i]);
+		fprintf(f, "}");
+	}
+	fprintf(f, "\n  ]\n}\n");
+	fclose(f);
+}
+
+/**
+ * @brief Emit the reports, called at exit.
+ */
+static void stats_report(void)
+{
+	struct stats_mod total = {0};
+	u32 i, j;
+
+	for (j = 0; j < st.nmods; j++) {
+		for (i = 0; i < STATS_NPHASES; i++)
+			total.ns[i] += st.mods[j].ns[i];
+		for (i = 0; i < STATS_NCOUNTERS; i++)
+			total.cnt[i] += st.mods[j].cnt[i];
+	}
+
+	if (st.human)
+		report_human(stderr, &total);
+	if (st.json_file)
+		report_json(st.json_file, &total);
+
+	for (i = 0; i < st.nmods; i++)
+		free(st.mods[i].name);
+	free(st.mods);
+	st.mods  = NULL;
+	st.nmods = 0;
+}
+
+/**
+ * @brief Enable the loader statistics: reports are emitted at exit.
+ *
+ * @param human     Print a human-readable report on stderr.
+ * @param json_file Save a JSON report on this file (if not NULL).
+ */
+void stats_init(int human, const char *json_file)
+{
+	if (!human && !json_file)
+		return;
+
+	st.human      = human;
+	st.json_file  = json_file;
+	st.start_ns   = stats_now_ns();
+	stats_enabled = 1;
+	atexit(stats_report);
+}
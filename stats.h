@@ -0,0 +1,69 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * Loader statistics: per-module wall time of each loader phase, plus a
+ * few counters. Phases may nest (e.g., resolving an import loads a new
+ * module), so each phase only accounts its own (self) time.
+ *
+ * All the macros below are a single (predicted) branch when the
+ * statistics are disabled.
+ */
+
+#include "util.h"
+
+/* Loader phases. */
+enum stats_phase {
+	STATS_AR_OPEN,      /* Archive open + member lookup. */
+	STATS_XCOFF_PARSE,  /* XCOFF headers and loader section parse. */
+	STATS_MAP,          /* Guest memory mapping.         */
+	STATS_COPY,         /* .text/.data copy into guest.  */
+	STATS_RELOC,        /* Relocation processing.        */
+	STATS_IMPORT,       /* Import resolution.            */
+	STATS_NPHASES
+};
+
+/* Counters. */
+enum stats_counter {
+	STATS_RELOCS,       /* Relocations processed.        */
+	STATS_IMPORTS,      /* Imports resolved.             */
+	STATS_PASSTHROUGHS, /* Re-exported imports followed. */
+	STATS_BYTES,        /* Bytes copied into guest.      */
+	STATS_NCOUNTERS
+};
+
+extern int stats_enabled;
+
+#define STATS_BEGIN(mod, phase) \
+	do { \
+		if (stats_enabled) \
+			stats_begin((mod), (phase)); \
+	} while (0)
+
+#define STATS_END() \
+	do { \
+		if (stats_enabled) \
+			stats_end(); \
+	} while (0)
+
+#define STATS_ADD(mod, counter, n) \
+	do { \
+		if (stats_enabled) \
+			stats_add((mod), (counter), (n)); \
+	} while (0)
+
+extern void stats_init(int human, const char *json_file);
+extern u32  stats_module(const char *bin, const char *member);
+extern void stats_begin(u32 mod, enum stats_phase phase);
+extern void stats_end(void);
+extern void stats_add(u32 mod, enum stats_counter counter, u64 n);
+extern void stats_loaded(void);
+extern u64  stats_now_ns(void);
+
+#endif /* STATS_H */
@@ -0,0 +1,340 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loader.h"
+#include "mm.h"
+#include "sym.h"
+
+/* Function entry point. */
+struct sym_entry {
+	u32 addr;
+	const char *name;
+};
+
+/* Symbols of a loaded module. */
+struct sym_module {
+	const struct loaded_coff *lc;
+	const char *name;     /* Module basename.            */
+	u32 start;            /* Runtime .text start.        */
+	u32 end;              /* Runtime .text end (excl).   */
+	int loaded;           /* Symbols already read.       */
+	struct sym_entry *syms;
+	u32 nsyms;
+	u32 capacity;
+};
+
+static struct {
+	struct sym_module *mods;   /* Sorted by address. */
+	u32 nmods;
+} sym;
+
+/**
+ * @brief Compare two symbols by address (and name, so that aliases
+ * are always resolved into the same name).
+ */
+static int cmp_sym(const void *a, const void *b)
+{
+	const struct sym_entry *sa = a, *sb = b;
+	if (sa->addr != sb->addr)
+		return (sa->addr < sb->addr) ? -1 : 1;
+	return strcmp(sa->name, sb->name);
+}
+
+/**
+ * @brief Compare two modules by address.
+ */
+static int cmp_module(const void *a, const void *b)
+{
+	const struct sym_module *ma = a, *mb = b;
+	if (ma->start != mb->start)
+		return (ma->start < mb->start) ? -1 : 1;
+	return 0;
+}
+
+/**
+ * @brief Add a symbol @p name at @p addr into the module @p m, if
+ * within its .text.
+ */
+static void add_sym(struct sym_module *m, u32 addr, const char *name)
+{
+	if (addr < m->start || addr >= m->end)
+		return;
+
+	if (m->nsyms == m->capacity) {
+		m->capacity = m->capacity ? m->capacity * 2 : 64;
+		m->syms     = realloc(m->syms, m->capacity * sizeof(*m->syms));
+		if (!m->syms)
+			errx(1, "Unable to allocate symbols!\n");
+	}
+	m->syms[m->nsyms].addr = addr;
+	m->syms[m->nsyms].name = name;
+	m->nsyms++;
+}
+
+/**
+ * @brief Symbol table handler: add a code symbol into the module.
+ */
+static int add_func(const char *name, size_t len, u32 value, void *data)
+{
+	struct sym_module *m = data;
+	char *s;
+
+	/* Entry points are named after the function, plus a leading '.'. */
+	if (len > 1 && name[0] == '.') {
+		name++;
+		len--;
+	}
+
+	s = strndup(name, len);
+	if (!s)
+		errx(1, "Unable to allocate symbols!\n");
+	add_sym(m, value + m->lc->deltas[TEXT_DELTA], s);
+	return 0;
+}
+
+/**
+ * @brief Read the symbols of the module @p m.
+ *
+ * Functions are exported through their descriptors (XMC_DS), whose
+ * first word (already relocated in guest memory) is the entry point.
+ * Exported code (XMC_PR) is taken as-is. If the module is not
+ * stripped, the symbol table adds all the other functions.
+ */
+static void load_symbols(uc_engine *uc, struct sym_module *m)
+{
+	const struct xcoff_ldr_sym_tbl_hdr32 *st;
+	const struct loaded_coff *lc = m->lc;
+	u32 i, j, addr;
+
+	m->loaded = 1;
+
+	for (i = 0; i < lc->xcoff.ldr.hdr.l_nsyms; i++) {
+		st = &lc->xcoff.ldr.symtbl[i];
+		if (!(st->l_symtype & L_EXPORT) || (st->l_symtype & L_IMPORT))
+			continue;
+
+		if (st->l_smclass == XMC_DS) {
+			if (uc_mem_read(uc, st->l_value, &addr, 4))
+				continue;
+			add_sym(m, ntohl(addr), st->u.l_strtblname);
+		}
+		else if (st->l_smclass == XMC_PR)
+			add_sym(m, st->l_value, st->u.l_strtblname);
+	}
+
+	if (lc->xcoff.hdr.f_nsyms)
+		xcoff_iterate_functions(lc->xcoff.buff, lc->xcoff.file_size,
+			add_func, m);
+
+	if (!m->nsyms)
+		return;
+
+	/* Sort, and drop the duplicates (exported and on the symtab). */
+	qsort(m->syms, m->nsyms, sizeof(*m->syms), cmp_sym);
+	for (i = 1, j = 1; i < m->nsyms; i++)
+		if (cmp_sym(&m->syms[i], &m->syms[j - 1]))
+			m->syms[j++] = m->syms[i];
+	m->nsyms = j;
+}
+
+/**
+ * @brief Add all modules loaded since the last call into the (sorted)
+ * module index. Their symbols are only read on demand.
+ */
+static void load_new_modules(void)
+{
+	const struct loaded_coff *lc;
+	struct sym_module *m;
+	const char *p;
+	u32 n;
+
+	for (n = 0, lc = loaded_modules; lc; lc = lc->next)
+		n++;
+	if (n == sym.nmods)
+		return;
+
+	sym.mods = realloc(sym.mods, n * sizeof(*sym.mods));
+	if (!sym.mods)
+		errx(1, "Unable to allocate symbols!\n");
+
+	/* The list only grows, so the new modules are at its end. */
+	for (n = 0, lc = loaded_modules; lc; lc = lc->next, n++) {
+		if (n < sym.nmods)
+			continue;
+		m = &sym.mods[n];
+		p = strrchr(lc->name, '/');
+		memset(m, 0, sizeof(*m));
+		m->lc    = lc;
+		m->name  = p ? p + 1 : lc->name;
+		m->start = lc->text_start;
+		m->end   = lc->text_start + lc->xcoff.aux.o_tsize;
+	}
+	sym.nmods = n;
+	qsort(sym.mods, sym.nmods, sizeof(*sym.mods), cmp_module);
+}
+
+/**
+ * @brief Find the module that contains @p addr.
+ */
+static struct sym_module *find_module(u32 addr)
+{
+	u32 lo, hi, mid;
+
+	lo = 0;
+	hi = sym.nmods;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (sym.mods[mid].start <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo || addr >= sym.mods[lo - 1].end)
+		return NULL;
+	return &sym.mods[lo - 1];
+}
+
+/**
+ * @brief Symbolize the guest address @p addr.
+ *
+ * @param uc     Unicorn context.
+ * @param addr   Guest .text address.
+ * @param module Output module basename, or NULL if @p addr does not
+ *               belong to any loaded module.
+ * @param off    Output offset from the returned symbol, or from the
+ *               module .text start if no symbol was found.
+ *
+ * @return Returns the nearest function at or below @p addr, or NULL
+ * if none.
+ */
+const char *sym_lookup(uc_engine *uc, u32 addr, const char **module,
+	u32 *off)
+{
+	struct sym_module *m;
+	u32 lo, hi, mid;
+
+	load_new_modules();
+
+	*module = NULL;
+	*off    = 0;
+
+	m = find_module(addr);
+	if (!m)
+		return NULL;
+	if (!m->loaded)
+		load_symbols(uc, m);
+
+	*module = m->name;
+	*off    = addr - m->start;
+
+	/* Last symbol <= addr. */
+	lo = 0;
+	hi = m->nsyms;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (m->syms[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return NULL;
+
+	/* First alias of that address. */
+	for (mid = lo - 1; mid > 0 && m->syms[mid - 1].addr == m->syms[lo - 1].addr;)
+		mid--;
+
+	*off = addr - m->syms[mid].addr;
+	return m->syms[mid].name;
+}
+
+/**
+ * @brief Format the guest address @p addr as 'addr <module`func+off>',
+ * or 'addr <module+off>', or just 'addr' if unknown.
+ *
+ * @param uc   Unicorn context.
+ * @param addr Guest address.
+ * @param buff Output buffer (SYM_FORMAT_LEN is always enough).
+ * @param size Output buffer size.
+ *
+ * @return Returns @p buff.
+ */
+const char *sym_format(uc_engine *uc, u32 addr, char *buff, size_t size)
+{
+	const char *module, *name;
+	u32 off;
+
+	name = sym_lookup(uc, addr, &module, &off);
+	if (name)
+		snprintf(buff, size, "0x%08x <%.80s`%.128s+0x%x>", addr, module,
+			name, off);
+	else if (module)
+		snprintf(buff, size, "0x%08x <%.80s+0x%x>", addr, module, off);
+	else
+		snprintf(buff, size, "0x%08x", addr);
+	return buff;
+}
+
+/**
+ * @brief Read a 32-bit word from the guest stack.
+ *
+ * @return Returns 0 if success, -1 if out of the stack.
+ */
+static int read_stack(uc_engine *uc, u32 addr, u32 *val)
+{
+	if (addr < STACK_ADDR - STACK_SIZE || addr > STACK_ADDR - 4)
+		return -1;
+	if (uc_mem_read(uc, addr, val, 4))
+		return -1;
+	*val = ntohl(*val);
+	return 0;
+}
+
+/**
+ * @brief Unwind the guest stack into @p pcs, leaf (@p pc) first.
+ *
+ * AIX frames are linked through r1: 0(r1) holds the caller stack
+ * pointer (back-chain) and 8(caller sp) the saved LR, i.e., the
+ * return address into the caller. Leaf functions that do not create
+ * a frame have their caller (still in LR) skipped.
+ *
+ * @param uc  Unicorn context.
+ * @param pc  Current PC.
+ * @param pcs Output frames: @p pc, then the call sites.
+ * @param max Maximum amount of frames.
+ *
+ * @return Returns the amount of frames.
+ */
+u32 sym_unwind(uc_engine *uc, u32 pc, u32 *pcs, u32 max)
+{
+	u32 sp, back, lr;
+	u32 depth;
+
+	if (!max)
+		return 0;
+
+	pcs[0] = pc;
+	depth  = 1;
+
+	if (uc_reg_read(uc, UC_PPC_REG_1, &sp))
+		return depth;
+
+	while (depth < max) {
+		if (read_stack(uc, sp, &back) < 0 || back <= sp)
+			break;
+		if (read_stack(uc, back + 8, &lr) < 0 || !lr)
+			break;
+		/* Return address - 4: the call site, within the caller. */
+		pcs[depth++] = lr - 4;
+		sp = back;
+	}
+	return depth;
+}
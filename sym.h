@@ -0,0 +1,33 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef SYM_H
+#define SYM_H
+
+/*
+ * Guest address symbolizer: maps a .text address into the loaded
+ * module that contains it and the nearest function below it, taken
+ * from the functions exported by the module (through their function
+ * descriptors) and, if not stripped, from its symbol table (csects
+ * and labels, static functions included).
+ *
+ * The tables of a module are built on its first lookup, and modules
+ * loaded later (e.g., via __loadx) are picked up on the next lookup.
+ */
+
+#include <stddef.h>
+#include "util.h"
+
+/* Maximum length of a symbolized address, see sym_format(). */
+#define SYM_FORMAT_LEN 256
+
+extern const char *sym_lookup(uc_engine *uc, u32 addr, const char **module,
+	u32 *off);
+extern const char *sym_format(uc_engine *uc, u32 addr, char *buff,
+	size_t size);
+extern u32 sym_unwind(uc_engine *uc, u32 pc, u32 *pcs, u32 max);
+
+#endif /* SYM_H */
@@ -0,0 +1,369 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "symindex.h"
+
+/**
+ * @brief Hash a symbol name (FNV-1a).
+ */
+static u32 sym_hash(const char *s)
+{
+	u32 h = 2166136261u;
+	for (; *s; s++) {
+		h ^= (u8)*s;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * @brief Append the string @p s into the string table being built.
+ *
+ * @return Returns the string offset.
+ */
+static u32 add_str(char *strtab, u32 *len, const char *s)
+{
+	size_t l = strlen(s) + 1;
+	u32 off  = *len;
+	memcpy(strtab + off, s, l);
+	*len += l;
+	return off;
+}
+
+/**
+ * @brief Write a new symbol index file @p out, with all the exported
+ * symbols of the modules in @p files.
+ *
+ * The file is written into a temporary file and then renamed, so
+ * readers never see a partially written index.
+ *
+ * @param out    Output file path.
+ * @param files  Modules to be indexed.
+ * @param nfiles Amount of modules.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+int symindex_write(const char *out, const struct symindex_wfile *files,
+	u32 nfiles)
+{
+	struct symindex_hdr   *hdr;
+	struct symindex_sym   *syms;
+	struct symindex_file  *wfiles;
+	u32   *buckets;
+	char  *strtab, *buff, *tmp;
+	u64    strtab_max, size;
+	u32    nsyms, nbuckets, len;
+	u32    i, j, k, b;
+	FILE  *f;
+	int    ret = -1;
+
+	/* Sizes. */
+	nsyms      = 0;
+	strtab_max = 1;
+	for (i = 0; i < nfiles; i++) {
+		nsyms      += files[i].nsyms;
+		strtab_max += strlen(files[i].path) + 1;
+		strtab_max += files[i].member ? strlen(files[i].member) + 1 : 0;
+		for (j = 0; j < files[i].nsyms; j++)
+			strtab_max += strlen(files[i].syms[j]) + 1;
+	}
+	if (strtab_max > UINT32_MAX)
+		return -1;
+
+	/* Load factor <= 0.5. */
+	for (nbuckets = 16; nbuckets < nsyms * 2; nbuckets <<= 1);
+
+	size = sizeof(*hdr) + (u64)nbuckets * sizeof(*buckets) +
+		(u64)nsyms * sizeof(*syms) + (u64)nfiles * sizeof(*wfiles) +
+		strtab_max;
+
+	buff = calloc(1, size);
+	if (!buff)
+		return -1;
+
+	hdr     = (struct symindex_hdr *)buff;
+	buckets = (u32 *)(hdr + 1);
+	syms    = (struct symindex_sym *)(buckets + nbuckets);
+	wfiles  = (struct symindex_file *)(syms + nsyms);
+	strtab  = (char *)(wfiles + nfiles);
+
+	/* Offset 0: empty string, i.e., 'no member'. */
+	len = 1;
+
+	for (i = 0, k = 0; i < nfiles; i++) {
+		/* Archive members share the same path. */
+		if (i && !strcmp(files[i].path, files[i - 1].path))
+			wfiles[i].path = wfiles[i - 1].path;
+		else
+			wfiles[i].path = htole32(add_str(strtab, &len, files[i].path));
+
+		wfiles[i].member = 0;
+		if (files[i].member)
+			wfiles[i].member = htole32(add_str(strtab, &len, files[i].member));
+
+		for (j = 0; j < files[i].nsyms; j++, k++) {
+			syms[k].hash    = sym_hash(files[i].syms[j]);
+			syms[k].name    = htole32(add_str(strtab, &len, files[i].syms[j]));
+			syms[k].file    = htole32(i);
+			syms[k].smclass = files[i].classes[j];
+		}
+	}
+
+	/*
+	 * Link the chains in reverse, so that each chain keeps the file
+	 * order, i.e., the first module that exports a symbol (in the
+	 * search order) is the first one found.
+	 */
+	for (k = nsyms; k > 0; k--) {
+		b = syms[k - 1].hash & (nbuckets - 1);
+		syms[k - 1].next = htole32(buckets[b]);
+		syms[k - 1].hash = htole32(syms[k - 1].hash);
+		buckets[b]       = htole32(k);
+	}
+
+	memcpy(hdr->magic, SYMINDEX_MAGIC, SYMINDEX_MAGICLEN);
+	hdr->nbuckets   = htole32(nbuckets);
+	hdr->nsyms      = htole32(nsyms);
+	hdr->nfiles     = htole32(nfiles);
+	hdr->strtab_len = htole32(len);
+
+	size -= strtab_max - len;
+
+	/* Write into a temporary file and rename. */
+	tmp = malloc(strlen(out) + 5);
+	if (!tmp)
+		goto out0;
+	sprintf(tmp, "%s.tmp", out);
+
+	f = fopen(tmp, "wb");
+	if (!f)
+		goto out1;
+	if (fwrite(buff, 1, size, f) != size) {
+		fclose(f);
+		unlink(tmp);
+		goto out1;
+	}
+	if (fclose(f) || rename(tmp, out) < 0) {
+		unlink(tmp);
+		goto out1;
+	}
+	ret = 0;
+out1:
+	free(tmp);
+out0:
+	free(buff);
+	return ret;
+}
+
+/**
+ * @brief Open (mmap) the symbol index @p file and validate it.
+ *
+ * @param file Index file path.
+ * @param si   Symbol index structure to be filled.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+int symindex_open(const char *file, struct symindex *si)
+{
+	const struct symindex_hdr *hdr;
+	struct stat st;
+	u32 nbuckets, nsyms, nfiles, strtab_len;
+	u64 size;
+
+	if (!file || !si)
+		return -1;
+
+	memset(si, 0, sizeof(*si));
+	si->fd = open(file, O_RDONLY);
+	if (si->fd < 0)
+		return -1;
+
+	if (fstat(si->fd, &st) < 0 || (size_t)st.st_size < sizeof(*hdr))
+		goto err;
+
+	si->size = st.st_size;
+	si->buff = mmap(0, si->size, PROT_READ, MAP_PRIVATE, si->fd, 0);
+	if (si->buff == MAP_FAILED) {
+		si->buff = NULL;
+		goto err;
+	}
+
+	hdr = (const struct symindex_hdr *)si->buff;
+	if (memcmp(hdr->magic, SYMINDEX_MAGIC, SYMINDEX_MAGICLEN))
+		goto err;
+
+	nbuckets   = le32toh(hdr->nbuckets);
+	nsyms      = le32toh(hdr->nsyms);
+	nfiles     = le32toh(hdr->nfiles);
+	strtab_len = le32toh(hdr->strtab_len);
+
+	if (!nbuckets || (nbuckets & (nbuckets - 1)) || !strtab_len)
+		goto err;
+
+	size = sizeof(*hdr) + (u64)nbuckets * sizeof(u32) +
+		(u64)nsyms * sizeof(struct symindex_sym) +
+		(u64)nfiles * sizeof(struct symindex_file) + strtab_len;
+	if (size != si->size)
+		goto err;
+
+	si->hdr     = hdr;
+	si->buckets = (const u32 *)(hdr + 1);
+	si->syms    = (const struct symindex_sym *)(si->buckets + nbuckets);
+	si->files   = (const struct symindex_file *)(si->syms + nsyms);
+	si->strtab  = (const char *)(si->files + nfiles);
+
+	/* Strings must never run past the end of the file. */
+	if (si->strtab[0] || si->strtab[strtab_len - 1])
+		goto err;
+
+	return 0;
+err:
+	symindex_close(si);
+	return -1;
+}
+
+/**
+ * @brief Close the symbol index @p si.
+ */
+void symindex_close(struct symindex *si)
+{
+	if (!si)
+		return;
+	if (si->buff)
+		munmap((char *)si->buff, si->size);
+	if (si->fd >= 0)
+		close(si->fd);
+	memset(si, 0, sizeof(*si));
+	si->fd = -1;
+}
+
+/**
+ * @brief Get a string from the index string table, or NULL if the
+ * offset is invalid.
+ */
+static const char *get_str(const struct symindex *si, u32 off)
+{
+	off = le32toh(off);
+	if (off >= le32toh(si->hdr->strtab_len))
+		return NULL;
+	return si->strtab + off;
+}
+
+/**
+ * @brief Find a module that exports the symbol @p sym.
+ *
+ * @param si   Opened symbol index.
+ * @param sym  Symbol name.
+ * @param prev Previous result (to find the next module that also
+ *             exports @p sym), or NULL to find the first one.
+ *
+ * @return Returns the symbol entry, or NULL if not found.
+ */
+const struct symindex_sym *
+symindex_find(const struct symindex *si, const char *sym,
+	const struct symindex_sym *prev)
+{
+	const struct symindex_sym *s;
+	const char *name;
+	u32 h, i;
+
+	if (!si || !si->hdr || !sym)
+		return NULL;
+
+	h = sym_hash(sym);
+	if (prev)
+		i = le32toh(prev->next);
+	else
+		i = le32toh(si->buckets[h & (le32toh(si->hdr->nbuckets) - 1)]);
+
+	while (i && i <= le32toh(si->hdr->nsyms)) {
+		s = &si->syms[i - 1];
+		if (le32toh(s->hash) == h) {
+			name = get_str(si, s->name);
+			if (name && !strcmp(name, sym))
+				return s;
+		}
+		i = le32toh(s->next);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Get the file path and member name of the module that
+ * exports the symbol @p s.
+ *
+ * @param si     Opened symbol index.
+ * @param s      Symbol entry, as returned by symindex_find().
+ * @param path   Output file path (or NULL if invalid).
+ * @param member Output member name (or NULL if not an archive).
+ */
+void symindex_get_file(const struct symindex *si,
+	const struct symindex_sym *s, const char **path, const char **member)
+{
+	const struct symindex_file *f;
+	u32 idx;
+
+	*path   = NULL;
+	*member = NULL;
+
+	idx = le32toh(s->file);
+	if (idx >= le32toh(si->hdr->nfiles))
+		return;
+
+	f       = &si->files[idx];
+	*path   = get_str(si, f->path);
+	*member = get_str(si, f->member);
+	if (*member && !**member)
+		*member = NULL;
+}
+
+/**
+ * @brief Find the indexed file whose basename is @p base and that
+ * contains the member @p member (if any), i.e., which file to open
+ * for an import ID.
+ *
+ * @param si     Opened symbol index.
+ * @param base   File basename, such as 'libc.a'.
+ * @param member Member name, such as 'shr.o', or NULL.
+ *
+ * @return Returns the file path, or NULL if not found.
+ */
+const char *
+symindex_find_file(const struct symindex *si, const char *base,
+	const char *member)
+{
+	const char *path, *mname, *p;
+	u32 i;
+
+	if (!si || !si->hdr || !base)
+		return NULL;
+
+	for (i = 0; i < le32toh(si->hdr->nfiles); i++) {
+		path  = get_str(si, si->files[i].path);
+		mname = get_str(si, si->files[i].member);
+		if (!path || !mname)
+			continue;
+
+		p = strrchr(path, '/');
+		p = p ? p + 1 : path;
+		if (strcmp(p, base))
+			continue;
+
+		if (member ? !strcmp(member, mname) : !*mname)
+			return path;
+	}
+	return NULL;
+}
@@ -0,0 +1,92 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef SYMINDEX_H
+#define SYMINDEX_H
+
+/*
+ * Symbol index: a mmap-able hash table file mapping each exported
+ * symbol of a library directory into the (file, member) that exports
+ * it, see tools/aix-symindex.c.
+ *
+ * File layout (all integers are little-endian):
+ *   struct symindex_hdr
+ *   u32 buckets[nbuckets]          (sym idx+1, 0=empty)
+ *   struct symindex_sym  syms[nsyms]
+ *   struct symindex_file files[nfiles]
+ *   char strtab[strtab_len]        (null-terminated strings, offset 0
+ *                                   is always the empty string)
+ */
+
+#include "util.h"
+
+#define SYMINDEX_MAGIC    "AIXSYMI1"
+#define SYMINDEX_MAGICLEN 8
+
+/* File header. */
+struct symindex_hdr {
+	char magic[SYMINDEX_MAGICLEN];
+	u32  nbuckets;     /* Power of 2.               */
+	u32  nsyms;        /* Amount of symbols.        */
+	u32  nfiles;       /* Amount of (file, member). */
+	u32  strtab_len;   /* String table length.      */
+};
+
+/* Symbol entry. */
+struct symindex_sym {
+	u32 hash;          /* Symbol name hash (FNV-1a).         */
+	u32 name;          /* Symbol name (strtab offset).       */
+	u32 file;          /* Index into files.                  */
+	u32 next;          /* Next in hash chain (idx+1, 0=end). */
+	u8  smclass;       /* Storage class (XMC_*).             */
+	u8  pad[3];
+};
+
+/* Module entry: file, and member (if archive). */
+struct symindex_file {
+	u32 path;          /* Absolute file path (strtab offset). */
+	u32 member;        /* Member name (strtab offset), or 0.  */
+};
+
+/**
+ * Opened (mmap'ed) symbol index.
+ */
+struct symindex {
+	int fd;
+	const char *buff;
+	size_t size;
+	const struct symindex_hdr  *hdr;
+	const u32                  *buckets;
+	const struct symindex_sym  *syms;
+	const struct symindex_file *files;
+	const char *strtab;
+};
+
+/**
+ * Module to be written into a new index, see symindex_write().
+ */
+struct symindex_wfile {
+	const char *path;     /* File path.                    */
+	const char *member;   /* Member name, or NULL.         */
+	const char **syms;    /* Exported symbols.             */
+	const u8   *classes;  /* Storage class of each symbol. */
+	u32  nsyms;
+};
+
+extern int  symindex_write(const char *out, const struct symindex_wfile *files,
+	u32 nfiles);
+extern int  symindex_open(const char *file, struct symindex *si);
+extern void symindex_close(struct symindex *si);
+extern const struct symindex_sym *
+symindex_find(const struct symindex *si, const char *sym,
+	const struct symindex_sym *prev);
+extern void symindex_get_file(const struct symindex *si,
+	const struct symindex_sym *s, const char **path, const char **member);
+extern const char *
+symindex_find_file(const struct symindex *si, const char *base,
+	const char *member);
+
+#endif /* SYMINDEX_H */
@@ -4,6 +4,7 @@
  * Made by Theldus, 2025
  */
 
+#include <stdlib.h>
 #include <unistd.h>
 #include "syscalls.h"
 
@@ -13,12 +14,16 @@
  * Handles the AIX _exit syscall, which terminates the process immediately
  * without cleanup. This is the same as POSIX _exit(2).
  *
+ * Note: the guest's own cleanup already happened at this point, so
+ * exit(3) is used on the host side, in order to also run the atexit(3)
+ * handlers registered by aix-user itself (statistics, reports...).
+ *
  * AIX calling convention:
  *   r3 = status (exit code)
  *
  * This function does not return.
  *
- * @return Never returns (calls _exit).
+ * @return Never returns (calls exit).
  */
 int aix__exit(uc_engine *uc)
 {
@@ -30,6 +35,6 @@ int aix__exit(uc_engine *uc)
 	exit_code = read_1st_arg();
 
 	TRACE("_exit", "%d", exit_code);
-	_exit(exit_code);
+	exit(exit_code);
 	/* NOTREACHED */
 }
@@ -4,16 +4,188 @@
  * Made by Theldus, 2025-2026
  */
 
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "syscalls.h"
 #include "unix.h"
 #include "mm.h"
+#include "stats.h"
 #include "aix_errno.h"
 
+/* Heap profile: frames kept per growth site, and sites shown. */
+#define BRK_SITE_DEPTH 4
+#define BRK_TOP_SITES  15
+
+/* Call stack that moved the break. */
+struct brk_site {
+	u32 pcs[BRK_SITE_DEPTH];  /* Call sites, innermost first. */
+	u32 depth;
+	u64 calls;
+	u64 grown;                /* Bytes added.   */
+	u64 shrunk;               /* Bytes removed. */
+};
+
 static int silence_trace;
 static u32 curr_brk = HEAP_ADDR;
 
+/* Heap profile (--heap-profile). */
+static struct {
+	uc_engine *uc;
+	FILE *f;                  /* Time series.   */
+	u64 start_ns;
+	u32 hwm;                  /* Highest break. */
+	u64 calls;
+	u64 failed;
+	struct brk_site *sites;
+	u32 nsites;
+	u32 capacity;
+} heap;
+
+/**
+ * @brief Get the site of the call stack @p pcs, creating it if needed.
+ */
+static struct brk_site *get_site(const u32 *pcs, u32 depth)
+{
+	struct brk_site *s;
+	u32 i;
+
+	for (i = 0; i < heap.nsites; i++) {
+		s = &heap.sites[i];
+		if (s->depth == depth && !memcmp(s->pcs, pcs, depth * sizeof(*pcs)))
+			return s;
+	}
+
+	if (heap.nsites == heap.capacity) {
+		heap.capacity = heap.capacity ? heap.capacity * 2 : 64;
+		heap.sites    = realloc(heap.sites,
+			heap.capacity * sizeof(*heap.sites));
+		if (!heap.sites)
+			errx(1, "Unable to allocate heap profile!\n");
+	}
+
+	s = &heap.sites[heap.nsites++];
+	memset(s, 0, sizeof(*s));
+	memcpy(s->pcs, pcs, depth * sizeof(*pcs));
+	s->depth = depth;
+	return s;
+}
+
+/**
+ * @brief Record a break change (from @p old into curr_brk, @p req
+ * bytes requested) made by the syscall @p sys, or its failure if
+ * @p ret is -1.
+ */
+static void heap_record(uc_engine *uc, const char *sys, u32 old, s64 req,
+	int ret)
+{
+	char caller[SYM_FORMAT_LEN];
+	u32 pcs[BRK_SITE_DEPTH];
+	struct brk_site *s;
+	u32 lr, depth;
+	s64 delta;
+
+	if (!heap.f)
+		return;
+
+	uc_reg_read(uc, UC_PPC_REG_LR, &lr);
+	delta = (s64)curr_brk - old;
+
+	fprintf(heap.f, "%.6f,%s,0x%08x,%u,%" PRId64 ",%s,\"%s\"\n",
+		(stats_now_ns() - heap.start_ns) / 1e9, sys, curr_brk,
+		curr_brk - HEAP_ADDR, req, (ret == -1) ? "ENOMEM" : "ok",
+		sym_format(uc, lr, caller, sizeof caller));
+
+	heap.calls++;
+	if (ret == -1) {
+		heap.failed++;
+		return;
+	}
+	if (curr_brk > heap.hwm)
+		heap.hwm = curr_brk;
+	if (!delta)
+		return;
+
+	/* LR - 4: the call site, as for the deeper frames. */
+	depth = sym_unwind(uc, lr - 4, pcs, BRK_SITE_DEPTH);
+	s = get_site(pcs, depth);
+	s->calls++;
+	if (delta > 0)
+		s->grown  += (u64)delta;
+	else
+		s->shrunk += (u64)-delta;
+}
+
+/**
+ * @brief Compare growth sites by bytes added (descending).
+ */
+static int cmp_site(const void *a, const void *b)
+{
+	const struct brk_site *sa = a, *sb = b;
+	if (sa->grown != sb->grown)
+		return (sa->grown < sb->grown) ? 1 : -1;
+	return (sa->calls < sb->calls) - (sa->calls > sb->calls);
+}
+
+/**
+ * @brief Print the heap summary and the top growth sites, called at
+ * exit.
+ */
+static void heap_report(void)
+{
+	char buff[SYM_FORMAT_LEN];
+	struct brk_site *s;
+	u32 i, j;
+
+	fclose(heap.f);
+	heap.f = NULL;
+
+	fprintf(stderr, "\n[heap] %" PRIu64 " break changes (%" PRIu64
+		" failed), break: %u KiB, high-water mark: %u KiB of %u MiB"
+		" (%.2f%%)\n", heap.calls, heap.failed,
+		(curr_brk - HEAP_ADDR) >> 10, (heap.hwm - HEAP_ADDR) >> 10,
+		HEAP_SIZE >> 20, (heap.hwm - HEAP_ADDR) * 100.0 / HEAP_SIZE);
+
+	if (!heap.nsites)
+		return;
+
+	qsort(heap.sites, heap.nsites, sizeof(*heap.sites), cmp_site);
+	fprintf(stderr, "[heap] Top growth sites:\n");
+	fprintf(stderr, "[heap]   grown(KiB)  shrunk(KiB)     calls  site\n");
+	for (i = 0; i < heap.nsites && i < BRK_TOP_SITES; i++) {
+		s = &heap.sites[i];
+		fprintf(stderr, "[heap] %12" PRIu64 " %12" PRIu64 " %9" PRIu64
+			"  %s\n", s->grown >> 10, s->shrunk >> 10, s->calls,
+			sym_format(heap.uc, s->pcs[0], buff, sizeof buff));
+		for (j = 1; j < s->depth; j++) {
+			fprintf(stderr, "[heap] %*s<- %s\n", 35, "",
+				sym_format(heap.uc, s->pcs[j], buff, sizeof buff));
+		}
+	}
+}
+
+/**
+ * @brief Enable the heap profile: every break change is saved (as CSV)
+ * into @p file, and a summary is printed at exit.
+ *
+ * @param uc   Unicorn context.
+ * @param file Output file.
+ */
+void brk_profile_init(uc_engine *uc, const char *file)
+{
+	heap.f = fopen(file, "w");
+	if (!heap.f)
+		errx(1, "Unable to open heap profile file (%s)!\n", file);
+
+	fprintf(heap.f, "time_s,syscall,brk,heap_bytes,request,result,caller\n");
+	heap.uc       = uc;
+	heap.start_ns = stats_now_ns();
+	heap.hwm      = curr_brk;
+	atexit(heap_report);
+}
+
 /**
  * @brief brk syscall handler.
  *
@@ -25,8 +197,8 @@ static u32 curr_brk = HEAP_ADDR;
  */
 int aix_brk(uc_engine *uc)
 {
-	((void)uc);
 	u32 addr = read_1st_arg();
+	u32 old  = curr_brk;
 	int ret  = -1;
 
 	/* Wrong address. */
@@ -39,6 +211,7 @@ int aix_brk(uc_engine *uc)
 	curr_brk = addr;
 	ret = 0;
 out:
+	heap_record(uc, "brk", old, (s64)addr - old, ret);
 	TRACE("brk", "0x%x", addr);
 	return ret;
 }
@@ -55,8 +228,8 @@ out:
  */
 int aix_sbrk(uc_engine *uc)
 {
-	((void)uc);
 	s32 incr = read_1st_arg();
+	u32 old  = curr_brk;
 	u32 decr;
 	int ret  = (int)curr_brk;
 
@@ -80,6 +253,7 @@ int aix_sbrk(uc_engine *uc)
 	}
 
 out:
+	heap_record(uc, silence_trace ? "__libc_sbrk" : "sbrk", old, incr, ret);
 	if (!silence_trace)
 		TRACE("sbrk", "%d", incr);
 	return ret;
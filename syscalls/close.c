@@ -26,7 +26,9 @@ int aix_close(uc_engine *uc)
 	int ret;
 	u32 fd = read_1st_arg();
 
+	OVH_BEGIN(OVH_HOST);
 	ret = close(fd);
+	OVH_END();
 	if (ret < 0)
 		unix_set_conv_errno(errno);
 
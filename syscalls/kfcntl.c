@@ -40,7 +40,9 @@ int aix_kfcntl(uc_engine *uc)
 
 	switch (cmd) {
 		case F_GETFL:
+			OVH_BEGIN(OVH_HOST);
 			lnx_ret = fcntl(fd, cmd);
+			OVH_END();
 			break;
 		default:
 			warn("kfcntl: unknown command: %d\n", cmd);
@@ -40,8 +40,10 @@ int aix_kioctl(uc_engine *uc)
 	int ret = -1;
 
 	if (cmd & TXISATTY) {
+		OVH_BEGIN(OVH_HOST);
 		if (isatty(fd))
 			ret = 0;
+		OVH_END();
 	}
 
 	if (o_errno != errno)
@@ -106,7 +106,9 @@ int aix_kopen(uc_engine *uc)
 	if (flags & AIX_O_SYNC)      lflags |= O_SYNC;
 	if (flags & AIX_O_TRUNC)     lflags |= O_TRUNC;
 
+	OVH_BEGIN(OVH_HOST);
 	ret = open(opath, lflags, mode);
+	OVH_END();
 	if (ret < 0) {
 		unix_set_conv_errno(errno);
 		goto out;
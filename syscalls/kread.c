@@ -43,14 +43,16 @@ int aix_kread(uc_engine *uc)
 
 	/* Read FD on Linux and copy to our local buffer, before copying to the VM
 	 * memory. */
+	OVH_BEGIN(OVH_HOST);
 	ret = read(vm_fd, h_buff, vm_count);
+	OVH_END();
 	if (ret < 0) {
 		unix_set_conv_errno(errno);
 		goto out;
 	}
 
-	/* Copy data from host to VM memory. */
-	if (uc_mem_write(uc, vm_buff, h_buff, vm_count)) {
+	/* Copy the data read (if any) from host to VM memory. */
+	if (ret > 0 && sys_mem_write(uc, vm_buff, h_buff, ret)) {
 		unix_set_errno(AIX_EFAULT);
 		warn("kread: failed to write to VM address 0x%x\n", vm_buff);
 		free(h_buff);
@@ -49,7 +49,9 @@ int aix_kwrite(uc_engine *uc)
 	}
 
 	/* Perform the actual write on the host. */
+	OVH_BEGIN(OVH_HOST);
 	ret = write(vm_fd, h_buff, vm_count);
+	OVH_END();
 
 	TRACE("kwrite", "%d, %x, %d", vm_fd, vm_buff, vm_count);
 	free(h_buff);
@@ -283,6 +283,7 @@ static int do_stat(uc_engine *uc, int have_fd)
 	}
 
 	/* Perform stat,lstat or fstat based on STX_LINK and have_fd flags. */
+	OVH_BEGIN(OVH_HOST);
 	if (!have_fd) {
 		if (cmd & STX_LINK)
 			ret = lstat(spath, &linux_st);
@@ -291,6 +292,7 @@ static int do_stat(uc_engine *uc, int have_fd)
 	}
 	else
 		ret = fstat(path_fd, &linux_st);
+	OVH_END();
 
 	if (ret < 0) {
 		unix_set_conv_errno(errno);
@@ -317,7 +319,7 @@ static int do_stat(uc_engine *uc, int have_fd)
 	}
 
 	/* Write the converted structure to destination */
-	if (uc_mem_write(uc, buff, st, length)) {
+	if (sys_mem_write(uc, buff, st, length)) {
 		unix_set_errno(AIX_EINVAL);
 		ret = -1;
 		goto out;
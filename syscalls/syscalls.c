@@ -8,12 +8,18 @@
  * AIX syscalls
  */
 
+#include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include "syscalls.h"
+#include "flightrec.h"
 #include "mm.h"
+#include "record.h"
+#include "stats.h"
+#include "timeline.h"
 #include "util.h"
 
 /**
@@ -80,6 +86,26 @@ struct unix_syscall_entry {
 struct sys_table_entry {
 	const char *name;   /* Syscall name.                    */
 	syscall_fn handler; /* Implementation function pointer. */
+	u32 flags;          /* SYS_F_* flags.                   */
+};
+
+/* Syscall flags. */
+#define SYS_F_IO   0x1  /* Returns the amount of bytes transferred.      */
+#define SYS_F_HOST 0x2  /* Touches the host: served from the log on
+                           --replay (see record.h).                    */
+#define SYS_F_OUT  0x4  /* (fd, buffer, count) output: echoed on
+                           --replay, if into stdout/stderr.            */
+
+/**
+ * Per-syscall statistics (-c), indexed as unix_syscalls[].
+ */
+struct sys_stats {
+	u64 calls;
+	u64 errors;     /* Calls that returned -1.            */
+	u64 total_ns;   /* Host time spent in the handler.    */
+	u64 min_ns;
+	u64 max_ns;
+	u64 bytes;      /* Bytes transferred (SYS_F_IO only). */
 };
 
 /* Unicorn engine instance (initialized in syscalls_init). */
@@ -94,29 +120,32 @@ static uc_hook syscall_trace;
 /* Array of all registered /unix syscalls. */
 static struct unix_syscall_entry unix_syscalls[MAX_SYSCALLS];
 
+/* Statistics for each registered /unix syscall (-c). */
+static struct sys_stats sys_stats[MAX_SYSCALLS];
+
 /**
  * Table mapping syscall names to their implementations.
  * When a /unix symbol is imported, we search this table to find
  * the corresponding implementation.
  */
 static struct sys_table_entry sys_table[] = {
-	{"kwrite",         aix_kwrite},
-	{"_exit",          aix__exit},
-	{"kioctl",         aix_kioctl},
-	{"read_sysconfig", aix_read_sysconfig},
-	{"__loadx",        aix___loadx},
-	{"kfcntl",         aix_kfcntl},
-	{"vmgetinfo",      aix_vmgetinfo},
-	{"brk",            aix_brk},
-	{"sbrk",           aix_sbrk},
-	{"__libc_sbrk",    aix___libc_sbrk},
-	{"getuidx",        aix_getuidx},
-	{"getgidx",        aix_getgidx},
-	{"statx",          aix_statx},
-	{"kopen",          aix_kopen},
-	{"close",          aix_close},
-	{"kread",          aix_kread},
-	{"fstatx",         aix_fstatx},
+	{"kwrite",         aix_kwrite,         SYS_F_IO|SYS_F_HOST|SYS_F_OUT},
+	{"_exit",          aix__exit,          0},
+	{"kioctl",         aix_kioctl,         SYS_F_HOST},
+	{"read_sysconfig", aix_read_sysconfig, 0},
+	{"__loadx",        aix___loadx,        0},
+	{"kfcntl",         aix_kfcntl,         SYS_F_HOST},
+	{"vmgetinfo",      aix_vmgetinfo,      0},
+	{"brk",            aix_brk,            0},
+	{"sbrk",           aix_sbrk,           0},
+	{"__libc_sbrk",    aix___libc_sbrk,    0},
+	{"getuidx",        aix_getuidx,        SYS_F_HOST},
+	{"getgidx",        aix_getgidx,        SYS_F_HOST},
+	{"statx",          aix_statx,          SYS_F_HOST},
+	{"kopen",          aix_kopen,          SYS_F_HOST},
+	{"close",          aix_close,          SYS_F_HOST},
+	{"kread",          aix_kread,          SYS_F_IO|SYS_F_HOST},
+	{"fstatx",         aix_fstatx,         SYS_F_HOST},
 };
 
 /**
@@ -172,6 +201,52 @@ u32 read_8th_arg(void) { return read_gpr(10); }
  */
 static void write_ret_value(u32 val) {
 	write_gpr(3, val);
+	flightrec_syscall_ret(val);
+}
+
+/**
+ * @brief Write syscall output data into the guest memory.
+ *
+ * Syscalls that touch the host must write their output via this
+ * function, so that it gets into the --record log.
+ *
+ * @param uc   Unicorn context.
+ * @param addr Guest address.
+ * @param buff Data to be written.
+ * @param len  Data length.
+ *
+ * @return Returns 0 if success, non-zero otherwise.
+ */
+int sys_mem_write(uc_engine *uc, u32 addr, const void *buff, u32 len)
+{
+	if (uc_mem_write(uc, addr, buff, len))
+		return -1;
+	if (rr_mode == RR_RECORD)
+		rr_mem_write(addr, buff, len);
+	return 0;
+}
+
+/**
+ * @brief Run the syscall @p sys, whose first 4 arguments are @p argv,
+ * honoring --record/--replay.
+ *
+ * @return Returns the syscall return value.
+ */
+static int sys_call(uc_engine *uc, const struct unix_syscall_entry *sys,
+	const u32 *argv)
+{
+	const struct sys_table_entry *e = &sys_table[sys->sys_table_idx];
+	int ret;
+
+	if (rr_mode == RR_OFF)
+		return e->handler(uc);
+
+	if (rr_mode == RR_REPLAY && (e->flags & SYS_F_HOST))
+		return rr_replay(uc, sys->sym_name, argv, e->flags & SYS_F_OUT);
+
+	rr_begin(uc, sys->sym_name, argv);
+	ret = e->handler(uc);
+	return rr_end(uc, ret);
 }
 
 /**
@@ -273,7 +348,10 @@ static void syscall_handler(uc_engine *uc, uint64_t addr, uint32_t size,
 	void *user_data)
 {
 	struct unix_syscall_entry *sys;
-	u32 sys_nr;
+	struct sys_stats *st;
+	u64 start, elapsed;
+	u32 argv[TL_MAX_ARGS];
+	u32 sys_nr, lr;
 	int ret;
 
 	(void)uc;
@@ -293,18 +371,155 @@ static void syscall_handler(uc_engine *uc, uint64_t addr, uint32_t size,
 	SYS("Syscall at 0x%" PRIx64 ", nr=%d, name='%s'\n",
 	    addr, sys_nr, sys->sym_name);
 
+	/*
+	 * Statistics: the call is accounted before dispatching, as _exit
+	 * never returns.
+	 */
+	st = &sys_stats[sys_nr];
+	if (args.syscall_stats)
+		st->calls++;
+
+	/*
+	 * Timeline, flight recorder and record/replay: arguments must be
+	 * read before r3 gets the return value.
+	 */
+	if (timeline_enabled || flightrec_enabled || rr_mode) {
+		argv[0] = read_1st_arg();
+		argv[1] = read_2nd_arg();
+		argv[2] = read_3rd_arg();
+		argv[3] = read_4th_arg();
+	}
+	if (flightrec_enabled) {
+		uc_reg_read(uc, UC_PPC_REG_LR, &lr);
+		flightrec_syscall(sys->sym_name, argv, lr);
+	}
+
 	/* Check if we have an implementation for this syscall. */
 	if (sys->sys_table_idx < 0) {
 		warn(">>> UNIMPLEMENTED SYSCALL: '%s' <<<\n", sys->sym_name);
-		write_ret_value((u32)-1);
-		return;
+		if (args.syscall_stats)
+			st->errors++;
+		ret = -1;
+		start = stats_now_ns();
+		elapsed = 0;
+		goto out;
 	}
 
 	/* Dispatch to the handler and write return value. */
-	ret = sys_table[sys->sys_table_idx].handler(uc);
+	if (!args.syscall_stats && !timeline_enabled) {
+		ret = sys_call(uc, sys, argv);
+		write_ret_value(ret);
+		return;
+	}
+
+	start   = stats_now_ns();
+	ret     = sys_call(uc, sys, argv);
+	elapsed = stats_now_ns() - start;
+
+	if (args.syscall_stats) {
+		st->total_ns += elapsed;
+		if (!st->min_ns || elapsed < st->min_ns)
+			st->min_ns = elapsed;
+		if (elapsed > st->max_ns)
+			st->max_ns = elapsed;
+		if (ret == -1)
+			st->errors++;
+		else if (sys_table[sys->sys_table_idx].flags & SYS_F_IO)
+			st->bytes += (u32)ret;
+	}
+
+out:
+	if (timeline_enabled) {
+		argv[4] = ret;
+		timeline_slice(TL_SYSCALL, sys->sym_name, NULL, start, elapsed,
+			argv, TL_MAX_ARGS);
+	}
 	write_ret_value(ret);
 }
 
+/**
+ * @brief Syscall hook: dispatches the syscall via syscall_handler(),
+ * accounting it as hook time (see overhead.h).
+ */
+static void syscall_hook(uc_engine *uc, uint64_t addr, uint32_t size,
+	void *user_data)
+{
+	OVH_HOOK(OVH_HOOK_SYSCALL);
+	syscall_handler(uc, addr, size, user_data);
+	OVH_END();
+}
+
+/**
+ * @brief Compare two syscalls (by index) by total time, then calls.
+ */
+static int cmp_sys_stats(const void *a, const void *b)
+{
+	const struct sys_stats *sa = &sys_stats[*(const int *)a];
+	const struct sys_stats *sb = &sys_stats[*(const int *)b];
+
+	if (sa->total_ns != sb->total_ns)
+		return (sa->total_ns < sb->total_ns) ? 1 : -1;
+	if (sa->calls != sb->calls)
+		return (sa->calls < sb->calls) ? 1 : -1;
+	return 0;
+}
+
+/**
+ * @brief Print the syscall statistics table (-c), sorted by the time
+ * spent on each syscall, like 'strace -c'. Called at exit.
+ */
+static void syscall_stats_report(void)
+{
+	struct sys_stats total = {0};
+	struct sys_stats *st;
+	int idx[MAX_SYSCALLS];
+	int i, n;
+
+	for (i = 0, n = 0; i < next_syscall_idx; i++) {
+		if (!sys_stats[i].calls)
+			continue;
+		idx[n++] = i;
+		total.calls    += sys_stats[i].calls;
+		total.errors   += sys_stats[i].errors;
+		total.total_ns += sys_stats[i].total_ns;
+		total.bytes    += sys_stats[i].bytes;
+	}
+	qsort(idx, n, sizeof(idx[0]), cmp_sys_stats);
+
+	fprintf(stderr,
+		"%% time     seconds  usecs/call     calls    errors   min(us)"
+		"   max(us)        bytes syscall\n"
+		"------ ----------- ----------- --------- --------- ---------"
+		" --------- ------------ ----------------\n");
+
+	for (i = 0; i < n; i++) {
+		st = &sys_stats[idx[i]];
+		fprintf(stderr,
+			"%6.2f %11.6f %11" PRIu64 " %9" PRIu64 " %9" PRIu64
+			" %9" PRIu64 " %9" PRIu64 " %12" PRIu64 " %s%s\n",
+			total.total_ns ? st->total_ns * 100.0 / total.total_ns : 0.0,
+			st->total_ns / 1e9,
+			st->total_ns / st->calls / 1000,
+			st->calls,
+			st->errors,
+			st->min_ns / 1000,
+			st->max_ns / 1000,
+			st->bytes,
+			unix_syscalls[idx[i]].sym_name,
+			(unix_syscalls[idx[i]].sys_table_idx < 0) ?
+				" (unimplemented)" : "");
+	}
+
+	fprintf(stderr,
+		"------ ----------- ----------- --------- --------- ---------"
+		" --------- ------------ ----------------\n"
+		"100.00 %11.6f %11" PRIu64 " %9" PRIu64 " %9" PRIu64
+		"                     %12" PRIu64 " total\n",
+		total.total_ns / 1e9,
+		total.calls ? total.total_ns / total.calls / 1000 : 0,
+		total.calls, total.errors, total.bytes);
+}
+
 /**
  * @brief Initialize the syscall subsystem.
  *
@@ -329,6 +544,11 @@ void syscalls_init(uc_engine *uc)
 	next_syscall_idx = 0;
 	next_desc_addr   = UNIX_DESC_ADDR;
 
+	if (args.syscall_stats)
+		atexit(syscall_stats_report);
+	if (args.heap_profile)
+		brk_profile_init(uc, args.heap_profile);
+
 	/* Map the syscall entry point page. */
 	err = uc_mem_map(uc, 0x3000, 4096, UC_PROT_ALL);
 	if (err)
@@ -344,7 +564,7 @@ void syscalls_init(uc_engine *uc)
 
 	/* Install Unicorn hook to intercept syscalls. */
 	err = uc_hook_add(g_uc, &syscall_trace, UC_HOOK_CODE,
-	                  syscall_handler, NULL, SYSCALL_ADDR, SYSCALL_ADDR);
+	                  syscall_hook, NULL, SYSCALL_ADDR, SYSCALL_ADDR);
 	if (err)
 		errx(1, "Failed to install syscall hook: %s\n",
 		     uc_strerror(err));
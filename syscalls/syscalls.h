@@ -8,15 +8,19 @@
 #define SYSCALLS_H
 
 #include "xcoff.h"
+#include "overhead.h"
+#include "sym.h"
 #include "util.h"
 #include <unicorn/unicorn.h>
 
 #define TRACE(sys,...) \
   do { \
   	u32 trace_pc; \
+  	char trace_sym[SYM_FORMAT_LEN]; \
   	if (args.trace_syscall) { \
   	  uc_reg_read(uc, UC_PPC_REG_LR, &trace_pc); \
-      fprintf(stderr, "TRACE (%08x) %s(", trace_pc, sys); \
+      fprintf(stderr, "TRACE (%s) %s(", \
+        sym_format(uc, trace_pc, trace_sym, sizeof trace_sym), sys); \
       fprintf(stderr, __VA_ARGS__); \
       fprintf(stderr, ") = 0x%x\n", ret); \
     } \
@@ -24,11 +28,15 @@
 
 extern void syscalls_init(uc_engine *uc);
 extern u32 syscall_register(const char *sym_name);
+extern void brk_profile_init(uc_engine *uc, const char *file);
 
 /* GPRs. */
 extern u32 read_gpr(u32 gpr);
 extern void write_gpr(u32 gpr, u32 val);
 
+/* Guest memory. */
+extern int sys_mem_write(uc_engine *uc, u32 addr, const void *buff, u32 len);
+
 /* Arguments. */
 u32 read_1st_arg(void);
 u32 read_2nd_arg(void);
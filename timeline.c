@@ -0,0 +1,223 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "stats.h"
+#include "timeline.h"
+
+/* Ring size (in slices), must be a power of 2. */
+#define TL_RING_SIZE (1 << 18)
+
+/* Recorded slice. */
+struct tl_event {
+	u64 start;               /* Start time (ns).                       */
+	u64 dur;                 /* Duration (ns).                         */
+	const char *name;        /* Slice name, must outlive the program.  */
+	const char *str;         /* Optional string argument, or NULL.     */
+	u32 argv[TL_MAX_ARGS];
+	u8  cat;
+	u8  nargs;
+};
+
+int timeline_enabled;
+
+static struct {
+	const char *file;        /* Output file.                           */
+	const char *program;     /* Guest program name.                    */
+	u64 start_ns;            /* timeline_init() time.                  */
+	struct tl_event *ring;
+	u64 next;                /* Total amount of slices recorded.       */
+	u64 run_start;           /* Current guest run start, or 0.         */
+	u32 run_pc;              /* Current guest run start PC.            */
+} tl;
+
+static const char *const cat_names[TL_NCATS] = {
+	"loader", "syscall", "insn_emu", "gdb", "emu"
+};
+
+/* Argument names of each category. */
+static const char *const arg_names[TL_NCATS][TL_MAX_ARGS] = {
+	[TL_LOADER]   = {NULL},
+	[TL_SYSCALL]  = {"r3", "r4", "r5", "r6", "ret"},
+	[TL_INSN_EMU] = {"pc", "insn"},
+	[TL_GDB]      = {"pc"},
+	[TL_EMU]      = {"pc"},
+};
+
+/* String argument name of each category. */
+static const char *const str_names[TL_NCATS] = {
+	[TL_LOADER] = "module",
+};
+
+/**
+ * @brief Record a new slice.
+ *
+ * @param cat   Slice category.
+ * @param name  Slice name.
+ * @param str   String argument (such as the module name), or NULL.
+ * @param start Start time, as returned by stats_now_ns().
+ * @param dur   Duration, in nanoseconds.
+ * @param argv  Numeric arguments, named after the category.
+ * @param nargs Amount of numeric arguments.
+ */
+void timeline_slice(enum tl_cat cat, const char *name, const char *str,
+	u64 start, u64 dur, const u32 *argv, int nargs)
+{
+	struct tl_event *ev;
+	int i;
+
+	ev        = &tl.ring[tl.next++ & (TL_RING_SIZE - 1)];
+	ev->start = start;
+	ev->dur   = dur;
+	ev->name  = name;
+	ev->str   = str;
+	ev->cat   = cat;
+	ev->nargs = min(nargs, TL_MAX_ARGS);
+	for (i = 0; i < ev->nargs; i++)
+		ev->argv[i] = argv[i];
+}
+
+/**
+ * @brief Signals that the guest is about to run, starting at @p pc.
+ */
+void timeline_run_begin(u32 pc)
+{
+	tl.run_pc    = pc;
+	tl.run_start = stats_now_ns();
+}
+
+/**
+ * @brief Signals that the guest stopped running, i.e., uc_emu_start()
+ * returned.
+ */
+void timeline_run_end(void)
+{
+	if (!tl.run_start)
+		return;
+	timeline_slice(TL_EMU, "emulation", NULL, tl.run_start,
+		stats_now_ns() - tl.run_start, &tl.run_pc, 1);
+	tl.run_start = 0;
+}
+
+/**
+ * @brief Print the JSON string @p s into @p f.
+ */
+static void json_str(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((u8)*s < 0x20)
+			fprintf(f, "\\u%04x", (u8)*s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+/**
+ * @brief Print the slice @p ev as a complete ('X') trace event.
+ */
+static void write_event(FILE *f, const struct tl_event *ev)
+{
+	int i;
+
+	fprintf(f, ",\n{\"name\": ");
+	json_str(f, ev->name);
+	fprintf(f, ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, "
+		"\"ts\": %.3f, \"dur\": %.3f", cat_names[ev->cat],
+		(ev->start - tl.start_ns) / 1e3, ev->dur / 1e3);
+
+	if (!ev->nargs && !ev->str) {
+		fprintf(f, "}");
+		return;
+	}
+
+	fprintf(f, ", \"args\": {");
+	for (i = 0; i < ev->nargs; i++)
+		fprintf(f, "%s\"%s\": \"0x%08x\"", i ? ", " : "",
+			arg_names[ev->cat][i], ev->argv[i]);
+	if (ev->str) {
+		fprintf(f, "%s\"%s\": ", ev->nargs ? ", " : "", str_names[ev->cat]);
+		json_str(f, ev->str);
+	}
+	fprintf(f, "}}");
+}
+
+/**
+ * @brief Save the recorded slices, called at exit.
+ */
+static void timeline_flush(void)
+{
+	u64 first, dropped, i;
+	FILE *f;
+
+	/* The guest is still running if the exit came from a syscall. */
+	timeline_run_end();
+
+	f = fopen(tl.file, "w");
+	if (!f) {
+		warn("Unable to open trace file (%s)!\n", tl.file);
+		return;
+	}
+
+	first   = (tl.next > TL_RING_SIZE) ? tl.next - TL_RING_SIZE : 0;
+	dropped = first;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ns\", \"otherData\": "
+		"{\"dropped_slices\": %" PRIu64 "}, \"traceEvents\": [\n",
+		dropped);
+	fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+		"\"args\": {\"name\": ");
+	json_str(f, tl.program);
+	fprintf(f, "}},\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+		"\"tid\": 1, \"args\": {\"name\": \"aix-user\"}}");
+
+	for (i = first; i < tl.next; i++)
+		write_event(f, &tl.ring[i & (TL_RING_SIZE - 1)]);
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	if (dropped)
+		warn("[timeline] Ring full: %" PRIu64 " oldest slices dropped\n",
+			dropped);
+
+	free(tl.ring);
+	tl.ring = NULL;
+	timeline_enabled = 0;
+}
+
+/**
+ * @brief Enable the timeline: slices are saved at exit into @p file.
+ *
+ * The loader phases are taken from the loader statistics, so those
+ * are enabled too. Must be called after stats_init(), so the
+ * timeline is saved before the statistics are released.
+ *
+ * @param file    Output file (Chrome trace-event JSON), or NULL.
+ * @param program Guest program name.
+ */
+void timeline_init(const char *file, const char *program)
+{
+	if (!file)
+		return;
+
+	tl.ring = malloc(TL_RING_SIZE * sizeof(*tl.ring));
+	if (!tl.ring)
+		errx(1, "Unable to allocate the timeline ring!\n");
+
+	tl.file          = file;
+	tl.program       = program;
+	tl.start_ns      = stats_now_ns();
+	timeline_enabled = 1;
+	stats_enabled    = 1;
+	atexit(timeline_flush);
+}
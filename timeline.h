@@ -0,0 +1,43 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+/*
+ * Timeline: records host-side work (loader phases, syscalls, emulated
+ * instructions, GDB pauses) and guest execution runs as slices into a
+ * preallocated in-memory ring, saved at exit in the Chrome trace-event
+ * format (--trace-out), to be opened with Perfetto or chrome://tracing.
+ *
+ * Once the ring is full, the oldest slices are overwritten, so the
+ * end of a long run is always kept.
+ */
+
+#include "util.h"
+
+/* Slice categories. */
+enum tl_cat {
+	TL_LOADER,      /* Loader phase, see stats.h.  */
+	TL_SYSCALL,     /* Syscall handler.            */
+	TL_INSN_EMU,    /* Emulated instruction trap.  */
+	TL_GDB,         /* Paused by GDB.              */
+	TL_EMU,         /* Guest execution (Unicorn).  */
+	TL_NCATS
+};
+
+/* Maximum amount of arguments of a slice. */
+#define TL_MAX_ARGS 5
+
+extern int timeline_enabled;
+
+extern void timeline_init(const char *file, const char *program);
+extern void timeline_slice(enum tl_cat cat, const char *name,
+	const char *str, u64 start, u64 dur, const u32 *argv, int nargs);
+extern void timeline_run_begin(u32 pc);
+extern void timeline_run_end(void);
+
+#endif /* TIMELINE_H */
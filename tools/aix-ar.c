@@ -4,17 +4,52 @@
  * Made by Theldus, 2025
  */
 
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <libgen.h>
 #include <unistd.h>
 
 #include "../bigar.h"
+#include "../xcoff.h"
+
+/* Single member to be extracted. */
+struct extract_job {
+	char name[256];  /* Null-terminated member name.  */
+	u64  off;        /* Member data offset, in file.  */
+	u64  size;       /* Member data size.             */
+};
 
 struct extract_data {
 	const char *output_dir;
+	const char *pattern;      /* Glob filter, NULL for all members. */
+	struct big_ar *ar;
+
+	/* Jobs, sorted by size, largest first. */
+	struct extract_job *jobs;
+	size_t njobs;
+	size_t capacity;
+
+	/* Next job to be picked by a worker. */
+	size_t next_job;
+	pthread_mutex_t lock;
+	int errors;
+};
+
+/* Members of an archive being written (-c/-r). */
+struct write_list {
+	struct ar_wmemb *membs;
+	u32 n;
+	u32 capacity;
 };
 
 /**
@@ -27,7 +62,12 @@ static void usage(void)
 		"Usage: ar <archive_file> <option>\n"
 		"Options:\n"
 		"  -l              List all members\n"
-		"  -x <output_dir> Extract all members to directory\n");
+		"  -x <output_dir> [-j <threads>] [-p <glob>]\n"
+		"                  Extract all members (or only the ones matching\n"
+		"                  <glob>) to directory, using <threads> threads\n"
+		"                  (default: number of CPUs)\n"
+		"  -c <files...>   Create archive with the given files\n"
+		"  -r <files...>   Add (or replace) files into the archive\n");
 	exit(1);
 }
 
@@ -58,77 +98,498 @@ static int create_dir_if_needed(const char *dir)
 	return 0;
 }
 
+/**
+ * @brief Copy @p size bytes from @p in_fd, at offset @p off, to the
+ * beginning of @p out_fd.
+ *
+ * Tries copy_file_range() first (no data copied to user-space, and
+ * might even share extents), then sendfile(), and then, as a last
+ * resort, plain writes from the mmap'ed archive.
+ *
+ * @param ar     Opened archive.
+ * @param out_fd Output file descriptor.
+ * @param off    Data offset in the archive.
+ * @param size   Amount of bytes to copy.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int copy_member_data(const struct big_ar *ar, int out_fd, u64 off,
+	u64 size)
+{
+	loff_t in_off;
+	off_t  sf_off;
+	ssize_t ret;
+	u64 done;
+
+	/* copy_file_range(). */
+	in_off = off;
+	done   = 0;
+	while (done < size) {
+		ret = copy_file_range(ar->fd, &in_off, out_fd, NULL, size - done, 0);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+	if (done == size)
+		return 0;
+
+	/* sendfile(): continue from where we stopped. */
+	sf_off = off + done;
+	while (done < size) {
+		ret = sendfile(out_fd, ar->fd, &sf_off, size - done);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+	if (done == size)
+		return 0;
+
+	/* Plain writes. */
+	while (done < size) {
+		ret = write(out_fd, ar->buff + off + done, size - done);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += ret;
+	}
+	return 0;
+}
+
 /**
  * @brief Extract a single AR member to the output directory.
  *
+ * @param edata Extract data, containing the output directory.
+ * @param job   Member to be extracted.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int extract_member(struct extract_data *edata,
+	const struct extract_job *job)
+{
+	char filepath[2048] = {0};
+	int fd;
+
+	/* Build output file path. */
+	if (snprintf(filepath, sizeof(filepath), "%s/%s",
+		edata->output_dir, job->name) >= (int)sizeof(filepath))
+	{
+		warn("Output path too long for member '%s'\n", job->name);
+		return -1;
+	}
+
+	fd = open(filepath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0) {
+		warn("Unable to create file '%s': %s\n", filepath,
+			strerror(errno));
+		return -1;
+	}
+
+	if (copy_member_data(edata->ar, fd, job->off, job->size) < 0) {
+		warn("Unable to write '%s': %s\n", filepath, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+	printf("Extracted: %s (%zu bytes)\n", job->name, (size_t)job->size);
+	return 0;
+}
+
+/**
+ * @brief Worker thread: extract members until there is no job left.
+ *
+ * @param arg Extract data.
+ *
+ * @return Always NULL.
+ */
+static void *extract_worker(void *arg)
+{
+	struct extract_data *edata = arg;
+	size_t idx;
+	int ret;
+
+	for (;;) {
+		pthread_mutex_lock(&edata->lock);
+		idx = edata->next_job++;
+		pthread_mutex_unlock(&edata->lock);
+
+		if (idx >= edata->njobs)
+			break;
+
+		ret = extract_member(edata, &edata->jobs[idx]);
+		if (ret < 0) {
+			pthread_mutex_lock(&edata->lock);
+			edata->errors++;
+			pthread_mutex_unlock(&edata->lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Add a single AR member to the extraction job list, if it
+ * matches the filter.
+ *
  * @param memb_name Buffer pointing to member name.
  * @param memb_data Buffer pointing to member data, with size mhdr->size.
  * @param mhdr      In-memory member header.
- * @param data      Extract data structure containing output directory.
+ * @param data      Extract data structure.
  *
- * @return Returns 0 to continue extraction, -1 on error.
+ * @return Returns 0 to continue, -1 on error.
  */
-static int extract_member(
+static int add_member_job(
 	const char *memb_name,
 	const char *memb_data,
 	const struct ar_memb_hdr_mem *mhdr, void *data)
 {
 	struct extract_data *edata = data;
-	char filepath[2048] = {0};
-	size_t written;
-	FILE *fp;
+	struct extract_job *job;
 
-	if (!edata || !edata->output_dir)
-		return -1;
-
-	/* Build output file path. */
-	if (snprintf(filepath, sizeof(filepath), "%s/%.*s",
-		edata->output_dir, (int)mhdr->namlen, memb_name) >=
-		(int)sizeof(filepath))
-	{
-		warn("Output path too long for member '%.*s'\n",
-			(int)mhdr->namlen, memb_name);
-		return 0; /* Continue with other members. */
+	if (mhdr->namlen >= sizeof(job->name)) {
+		warn("Member name too long: %.*s\n", (int)mhdr->namlen, memb_name);
+		return 0;
 	}
 
-	fp = fopen(filepath, "wb");
-	if (!fp) {
-		warn("Unable to create file '%s': %s\n", filepath,
-			strerror(errno));
-		return 0; /* Continue with other members. */
+	if (edata->njobs == edata->capacity) {
+		edata->capacity = edata->capacity ? edata->capacity * 2 : 64;
+		job = realloc(edata->jobs, edata->capacity * sizeof(*job));
+		if (!job) {
+			warn("Unable to allocate extraction job list!\n");
+			return -1;
+		}
+		edata->jobs = job;
 	}
 
-	written = fwrite(memb_data, 1, mhdr->size, fp);
-	fclose(fp);
+	job = &edata->jobs[edata->njobs];
+	memcpy(job->name, memb_name, mhdr->namlen);
+	job->name[mhdr->namlen] = '\0';
 
-	if (written != mhdr->size) {
-		warn("Warning: only wrote %zu of %zu bytes for '%s'\n",
-			written, (size_t)mhdr->size, filepath);
-	} else {
-		printf("Extracted: %.*s (%zu bytes)\n",
-			(int)mhdr->namlen, memb_name, (size_t)mhdr->size);
-	}
+	if (edata->pattern && fnmatch(edata->pattern, job->name, 0))
+		return 0;
 
+	job->off  = memb_data - edata->ar->buff;
+	job->size = mhdr->size;
+	edata->njobs++;
 	return 0;
 }
 
 /**
- * @brief Extract all members from the archive to the specified directory.
+ * @brief Compare two jobs by size (largest first), for qsort().
+ */
+static int cmp_job_size(const void *a, const void *b)
+{
+	const struct extract_job *ja = a;
+	const struct extract_job *jb = b;
+	if (ja->size > jb->size)
+		return -1;
+	return (ja->size < jb->size);
+}
+
+/**
+ * @brief Extract all members (matching @p pattern, if any) from the
+ * archive to the specified directory.
+ *
+ * Members are sorted by size (largest first) and picked by @p nthreads
+ * workers, so the big members do not end up all in the same thread.
  *
  * @param ar         Opened archive.
  * @param output_dir Directory to extract files to.
+ * @param pattern    Glob pattern, or NULL for all members.
+ * @param nthreads   Number of worker threads.
  *
  * @return Returns 0 if success, -1 otherwise.
  */
-static int extract_all_members(struct big_ar *ar, const char *output_dir)
+static int extract_all_members(struct big_ar *ar, const char *output_dir,
+	const char *pattern, int nthreads)
 {
-	struct extract_data edata;
+	struct extract_data edata = {0};
+	pthread_t *threads;
+	int i, started;
 
 	if (create_dir_if_needed(output_dir) < 0)
 		return -1;
 
 	edata.output_dir = output_dir;
-	return ar_iterate_members(ar, extract_member, &edata);
+	edata.pattern    = pattern;
+	edata.ar         = ar;
+	pthread_mutex_init(&edata.lock, NULL);
+
+	if (ar_iterate_members(ar, add_member_job, &edata) < 0)
+		goto err;
+
+	qsort(edata.jobs, edata.njobs, sizeof(*edata.jobs), cmp_job_size);
+
+	if ((size_t)nthreads > edata.njobs)
+		nthreads = edata.njobs ? edata.njobs : 1;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads)
+		goto err;
+
+	/* Run the pool, the main thread also works. */
+	for (started = 0; started < nthreads - 1; started++)
+		if (pthread_create(&threads[started], NULL, extract_worker, &edata))
+			break;
+
+	extract_worker(&edata);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	free(edata.jobs);
+	pthread_mutex_destroy(&edata.lock);
+	return (edata.errors ? -1 : 0);
+err:
+	free(edata.jobs);
+	pthread_mutex_destroy(&edata.lock);
+	return -1;
+}
+
+/**
+ * @brief Get the exported symbols of the XCOFF32 in @p buff, accordingly
+ * with its loader section, to be added to the global symbol table.
+ *
+ * @param fd    File descriptor containing the XCOFF.
+ * @param buff  XCOFF data.
+ * @param size  XCOFF size.
+ * @param m     Archive member that will hold the symbols.
+ *
+ * @return Returns 0 if success (or if not an XCOFF32), -1 otherwise.
+ */
+static int get_exports(int fd, const char *buff, u64 size,
+	struct ar_wmemb *m)
+{
+	const struct xcoff_ldr_sym_tbl_hdr32 *sym;
+	struct xcoff xcoff = {0};
+	u32 i;
+
+	m->syms  = NULL;
+	m->nsyms = 0;
+
+	/* Only XCOFF32 members with loader section export symbols. */
+	if (size < 2 || ((u8)buff[0] << 8 | (u8)buff[1]) != XCOFFF32_MAGIC)
+		return 0;
+	if (xcoff_load(fd, buff, size, &xcoff) < 0)
+		return 0;
+
+	m->syms = calloc(xcoff.ldr.hdr.l_nsyms + 1, sizeof(char *));
+	if (!m->syms)
+		return -1;
+
+	for (i = 0; i < xcoff.ldr.hdr.l_nsyms; i++) {
+		sym = &xcoff.ldr.symtbl[i];
+		if (!(sym->l_symtype & L_EXPORT) || (sym->l_symtype & L_IMPORT))
+			continue;
+		m->syms[m->nsyms] = strdup(sym->u.l_strtblname);
+		if (!m->syms[m->nsyms])
+			return -1;
+		m->nsyms++;
+	}
+	return 0;
+}
+
+/**
+ * @brief Add (or replace, if a member with the same name already exists)
+ * a member into the list of members to be written.
+ *
+ * @param wl Member list.
+ * @param m  Member to be added.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int add_write_member(struct write_list *wl, const struct ar_wmemb *m)
+{
+	struct ar_wmemb *tmp;
+	u32 i;
+
+	for (i = 0; i < wl->n; i++) {
+		if (!strcmp(wl->membs[i].name, m->name)) {
+			wl->membs[i] = *m;
+			return 0;
+		}
+	}
+
+	if (wl->n == wl->capacity) {
+		wl->capacity = wl->capacity ? wl->capacity * 2 : 64;
+		tmp = realloc(wl->membs, wl->capacity * sizeof(*tmp));
+		if (!tmp)
+			return -1;
+		wl->membs = tmp;
+	}
+	wl->membs[wl->n++] = *m;
+	return 0;
+}
+
+/**
+ * @brief Convert a file mode parsed as decimal (as done by the archive
+ * reader) back to its actual (octal) value, e.g., 644 -> 0644.
+ */
+static u32 mode_from_dec(u32 dec)
+{
+	u32 mode = 0, shift = 0;
+	for (; dec; dec /= 10, shift += 3)
+		mode |= (dec % 10) << shift;
+	return mode;
+}
+
+/**
+ * @brief Add an existing archive member into the list of members to be
+ * written.
+ *
+ * @param memb_name Buffer pointing to member name.
+ * @param memb_data Buffer pointing to member data, with size mhdr->size.
+ * @param mhdr      In-memory member header.
+ * @param data      Pointer to the archive being read.
+ *
+ * @return Returns 0 to continue, -1 on error.
+ */
+static int keep_member(
+	const char *memb_name,
+	const char *memb_data,
+	const struct ar_memb_hdr_mem *mhdr, void *data)
+{
+	struct big_ar *ar = ((void **)data)[0];
+	struct write_list *wl = ((void **)data)[1];
+	struct ar_wmemb m = {0};
+
+	m.name = strndup(memb_name, mhdr->namlen);
+	if (!m.name)
+		return -1;
+
+	m.fd   = ar->fd;
+	m.off  = memb_data - ar->buff;
+	m.size = mhdr->size;
+	m.date = mhdr->date;
+	m.uid  = mhdr->uid;
+	m.gid  = mhdr->gid;
+	m.mode = mode_from_dec(mhdr->mode);
+
+	if (get_exports(ar->fd, memb_data, mhdr->size, &m) < 0)
+		return -1;
+	if (add_write_member(wl, &m) < 0)
+		return -1;
+	return 0;
+}
+
+/**
+ * @brief Add a file into the list of members to be written. The member
+ * name is the file basename.
+ *
+ * @param wl   Member list.
+ * @param file File path.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int add_file_member(struct write_list *wl, const char *file)
+{
+	struct ar_wmemb m = {0};
+	struct stat st;
+	char *path;
+	char *buff;
+
+	m.fd = open(file, O_RDONLY);
+	if (m.fd < 0 || fstat(m.fd, &st) < 0) {
+		warn("Unable to open file '%s'\n", file);
+		return -1;
+	}
+
+	path = strdup(file);
+	if (!path)
+		return -1;
+	m.name = strdup(basename(path));
+	free(path);
+	if (!m.name)
+		return -1;
+
+	m.off  = 0;
+	m.size = st.st_size;
+	m.date = st.st_mtime;
+	m.uid  = st.st_uid;
+	m.gid  = st.st_gid;
+	m.mode = st.st_mode & 07777;
+
+	/* Data is only read for the exports, the copy uses the fd. */
+	if (st.st_size) {
+		buff = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, m.fd, 0);
+		if (buff == MAP_FAILED) {
+			warn("Unable to mmap file '%s'\n", file);
+			return -1;
+		}
+		if (get_exports(m.fd, buff, st.st_size, &m) < 0)
+			return -1;
+	}
+
+	return add_write_member(wl, &m);
+}
+
+/**
+ * @brief Create (-c) or update (-r) the archive @p archive_file with the
+ * files @p files.
+ *
+ * The archive is written into a temporary file first, and then renamed,
+ * so the old archive (if any) remains valid until the end.
+ *
+ * @param archive_file Archive path.
+ * @param files        Files to be added.
+ * @param nfiles       Amount of files.
+ * @param update       If non-zero, keep the existing archive members.
+ *
+ * @return Returns 0 if success, -1 otherwise.
+ */
+static int write_archive(const char *archive_file, char **files, int nfiles,
+	int update)
+{
+	struct write_list wl = {0};
+	char tmp_file[2048];
+	struct big_ar ar = {0};
+	void *kdata[2];
+	int have_ar = 0;
+	int ret = -1;
+	int i;
+
+	if (snprintf(tmp_file, sizeof tmp_file, "%s.tmp", archive_file) >=
+		(int)sizeof tmp_file)
+	{
+		return -1;
+	}
+
+	/* Existing members. */
+	if (update && access(archive_file, F_OK) == 0) {
+		if (ar_open(archive_file, &ar) < 0)
+			return -1;
+		have_ar  = 1;
+		kdata[0] = &ar;
+		kdata[1] = &wl;
+		if (ar_iterate_members(&ar, keep_member, kdata) < 0)
+			goto out;
+	}
+
+	for (i = 0; i < nfiles; i++)
+		if (add_file_member(&wl, files[i]) < 0)
+			goto out;
+
+	if (ar_write(tmp_file, wl.membs, wl.n) < 0)
+		goto out;
+
+	if (rename(tmp_file, archive_file) < 0) {
+		warn("Unable to rename '%s' to '%s'\n", tmp_file, archive_file);
+		unlink(tmp_file);
+		goto out;
+	}
+
+	for (i = 0; i < (int)wl.n; i++)
+		printf("Added: %s (%zu bytes, %u exports)\n", wl.membs[i].name,
+			(size_t)wl.membs[i].size, wl.membs[i].nsyms);
+	ret = 0;
+out:
+	/* Tool exits right after, no need to free each member. */
+	free(wl.membs);
+	if (have_ar)
+		ar_close(&ar);
+	return ret;
 }
 
 int main(int argc, char **argv)
@@ -136,13 +597,32 @@ int main(int argc, char **argv)
 	const char *archive_file;
 	const char *output_dir;
 	const char *option;
+	const char *pattern;
 	struct big_ar ar;
+	int nthreads;
+	int i;
 
 	if (argc < 3)
 		usage();
 
 	archive_file = argv[1];
 	option       = argv[2];
+	pattern      = NULL;
+	nthreads     = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+
+	/* Archive creation/update. */
+	if (!strcmp(option, "-c") || !strcmp(option, "-r")) {
+		if (argc < 4)
+			usage();
+		if (write_archive(archive_file, argv + 3, argc - 3,
+			option[1] == 'r') < 0)
+		{
+			errx(1, "Unable to write archive '%s'\n", archive_file);
+		}
+		return 0;
+	}
 
 	if (ar_open(archive_file, &ar) < 0)
 		errx(1, "Unable to open archive '%s'\n", archive_file);
@@ -158,7 +638,24 @@ int main(int argc, char **argv)
 			usage();
 		}
 		output_dir = argv[3];
-		if (extract_all_members(&ar, output_dir) < 0) {
+
+		/* Extraction options. */
+		for (i = 4; i < argc; i++) {
+			if (!strcmp(argv[i], "-j") && i + 1 < argc)
+				nthreads = atoi(argv[++i]);
+			else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+				pattern = argv[++i];
+			else {
+				ar_close(&ar);
+				usage();
+			}
+		}
+		if (nthreads <= 0) {
+			ar_close(&ar);
+			usage();
+		}
+
+		if (extract_all_members(&ar, output_dir, pattern, nthreads) < 0) {
 			ar_close(&ar);
 			errx(1, "Unable to extract archive members\n");
 		}
@@ -4,11 +4,58 @@
  * Made by Theldus, 2025
  */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "../xcoff.h"
+#include "../bigar.h"
+
+/*
+ * Scan mode.
+ *
+ * Every worker owns a deque of pending paths (files and directories):
+ * the owner pushes/pops at the bottom (depth-first, cache friendly),
+ * and idle workers steal from the top of the others (the oldest, and
+ * usually the largest, subtrees). Records are written as soon as they
+ * are ready, one JSON object per line.
+ */
+struct scan_deque {
+	char **items;      /* Ring buffer of paths.  */
+	u32 head;          /* Steal end (oldest).    */
+	u32 tail;          /* Owner end (newest).    */
+	u32 cap;           /* Power of 2.            */
+	pthread_mutex_t lock;
+};
+
+/* Per-worker output buffer, reused for every record. */
+struct scan_buf {
+	char  *data;
+	size_t len;
+	size_t cap;
+};
+
+static struct {
+	struct scan_deque *deques;
+	int nworkers;
+	u32 pending;       /* Paths pushed and not processed yet. */
+	int nidle;
+	pthread_mutex_t idle_lock;
+	pthread_cond_t  idle_cond;
+} scan = {
+	.idle_lock = PTHREAD_MUTEX_INITIALIZER,
+	.idle_cond = PTHREAD_COND_INITIALIZER
+};
 
 /**
  * @brief Show usage information and exit.
@@ -18,15 +65,488 @@ static void usage(void)
 	fprintf(stderr,
 		"XCOFF32 dump utility:\n"
 		"Usage: dump <xcoff_file> [option]\n"
+		"       dump --scan <dir> [-j <threads>]\n"
 		"Options:\n"
 		"  -h    Show file header only\n"
 		"  -a    Show auxiliary header only\n"
 		"  -s    Show section headers only\n"
 		"  -A    Show all information (default)\n"
-		"  -l    Show loader header\n");
+		"  -l    Show loader header\n"
+		"  --scan <dir>\n"
+		"        Scan <dir> recursively for XCOFF32/64 files and Big-AR\n"
+		"        archives, and print one JSON record (per line) for each\n"
+		"        module found, using <threads> threads (default: CPUs)\n");
 	exit(1);
 }
 
+/**
+ * @brief Make sure the output buffer @p b has room for @p n more bytes.
+ */
+static void buf_reserve(struct scan_buf *b, size_t n)
+{
+	if (b->len + n < b->cap)
+		return;
+	b->cap  = (b->len + n + 1) * 2;
+	b->data = realloc(b->data, b->cap);
+	if (!b->data)
+		errx(1, "Unable to allocate %zu bytes!\n", b->cap);
+}
+
+/**
+ * @brief Append formatted text into the output buffer @p b.
+ */
+static void buf_printf(struct scan_buf *b, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+		va_end(ap);
+		if (n < 0)
+			return;
+		if ((size_t)n < b->cap - b->len) {
+			b->len += n;
+			return;
+		}
+		buf_reserve(b, n);
+	}
+}
+
+/**
+ * @brief Append the JSON string @p s (of at most @p len bytes) into
+ * the output buffer @p b.
+ */
+static void buf_json_str(struct scan_buf *b, const char *s, size_t len)
+{
+	size_t i;
+	u8 c;
+
+	/* Worst case: every char escaped as \uXXXX. */
+	buf_reserve(b, len * 6 + 2);
+	b->data[b->len++] = '"';
+	for (i = 0; i < len && s[i]; i++) {
+		c = s[i];
+		if (c == '"' || c == '\\') {
+			b->data[b->len++] = '\\';
+			b->data[b->len++] = c;
+		} else if (c < 0x20) {
+			b->len += sprintf(b->data + b->len, "\\u%04x", c);
+		} else
+			b->data[b->len++] = c;
+	}
+	b->data[b->len++] = '"';
+}
+
+/**
+ * @brief Get the next null-terminated string from the import IDs string
+ * table, advancing @p p.
+ *
+ * @return Returns the string, or NULL if it goes past @p end.
+ */
+static const char *next_impid_str(const char **p, const char *end,
+	size_t *len)
+{
+	const char *s = *p;
+	*len = strnlen(s, end - s);
+	if (s + *len >= end)
+		return NULL;
+	*p = s + *len + 1;
+	return s;
+}
+
+/**
+ * @brief Append the import IDs of @p sum as JSON into @p b.
+ *
+ * The first import ID is the LIBPATH, the others are the (path, base,
+ * member) of each imported module.
+ */
+static void buf_json_impids(struct scan_buf *b,
+	const struct xcoff_summary *sum)
+{
+	static const char *const keys[3] = {"path", "base", "member"};
+	const char *p, *end, *v[3];
+	size_t len[3];
+	u32 i, j;
+
+	p   = sum->impids;
+	end = p + sum->impids_len;
+
+	for (i = 0; p && i < sum->nimpid; i++) {
+		for (j = 0; j < 3; j++)
+			if (!(v[j] = next_impid_str(&p, end, &len[j])))
+				break;
+		if (j < 3)
+			break;
+
+		if (i == 0) {
+			buf_printf(b, ",\"libpath\":");
+			buf_json_str(b, v[0], len[0]);
+			buf_printf(b, ",\"impids\":[");
+			continue;
+		}
+
+		buf_printf(b, "%s{", (i > 1) ? "," : "");
+		for (j = 0; j < 3; j++) {
+			buf_printf(b, "%s\"%s\":", j ? "," : "", keys[j]);
+			buf_json_str(b, v[j], len[j]);
+		}
+		buf_printf(b, "}");
+	}
+
+	if (i == 0)
+		buf_printf(b, ",\"libpath\":null,\"impids\":[]");
+	else
+		buf_printf(b, "]");
+}
+
+/**
+ * @brief Emit a JSON record for the module (@p buff, @p size), if it
+ * is an XCOFF.
+ *
+ * @param b      Output buffer.
+ * @param path   File path.
+ * @param member Archive member name (not null terminated), or NULL.
+ * @param mlen   Member name length.
+ * @param buff   Module data.
+ * @param size   Module size.
+ */
+static void scan_module(struct scan_buf *b, const char *path,
+	const char *member, size_t mlen, const char *buff, size_t size)
+{
+	struct xcoff_summary sum;
+	const struct xcoff_sec_summary *sec;
+	u32 i;
+
+	if (xcoff_summarize(buff, size, &sum) < 0)
+		return;
+
+	b->len = 0;
+	buf_printf(b, "{\"path\":");
+	buf_json_str(b, path, strlen(path));
+	buf_printf(b, ",\"member\":");
+	if (member)
+		buf_json_str(b, member, mlen);
+	else
+		buf_printf(b, "null");
+
+	buf_printf(b, ",\"format\":\"%s\",\"size\":%zu,\"flags\":%u,"
+		"\"nsections\":%u", sum.is64 ? "xcoff64" : "xcoff32", size,
+		sum.flags, sum.nscns);
+
+	/* Aux header. */
+	if (sum.has_aux) {
+		buf_printf(b, ",\"text_size\":%" PRIu64 ",\"data_size\":%" PRIu64
+			",\"bss_size\":%" PRIu64 ",\"entry\":%" PRIu64 ",\"toc\":%"
+			PRIu64, sum.tsize, sum.dsize, sum.bsize, sum.entry, sum.toc);
+	}
+
+	/* Sections. */
+	buf_printf(b, ",\"sections\":[");
+	for (i = 0; i < sum.nsecs; i++) {
+		sec = &sum.sections[i];
+		buf_printf(b, "%s{\"name\":", i ? "," : "");
+		buf_json_str(b, sec->name, strnlen(sec->name, sizeof(sec->name)));
+		buf_printf(b, ",\"vaddr\":%" PRIu64 ",\"size\":%" PRIu64
+			",\"flags\":%u,\"nreloc\":%u}", sec->vaddr, sec->size,
+			sec->flags, sec->nreloc);
+	}
+	buf_printf(b, "]");
+
+	/* Loader. */
+	buf_printf(b, ",\"relocs\":%u", sum.nrelocs);
+	if (sum.has_ldr) {
+		buf_printf(b, ",\"imports\":%u,\"exports\":%u,"
+			"\"ldr_relocs\":%u", sum.nimports, sum.nexports,
+			sum.ldr_nreloc);
+		buf_json_impids(b, &sum);
+	}
+
+	buf_printf(b, "}\n");
+
+	/* A single write per record, so records are never interleaved. */
+	fwrite(b->data, 1, b->len, stdout);
+}
+
+/* Archive member iteration context. */
+struct scan_ar_ctx {
+	struct scan_buf *b;
+	const char *path;
+};
+
+/**
+ * @brief Archive member handler: emits a record for each XCOFF member.
+ */
+static int scan_ar_member(const char *memb_name, const char *memb_data,
+	const struct ar_memb_hdr_mem *mhdr, void *data)
+{
+	struct scan_ar_ctx *ctx = data;
+	scan_module(ctx->b, ctx->path, memb_name, mhdr->namlen, memb_data,
+		mhdr->size);
+	return 0;
+}
+
+/**
+ * @brief Push @p path (owned by the deque from now on) into the
+ * bottom of the deque of worker @p id.
+ */
+static void scan_push(int id, char *path)
+{
+	struct scan_deque *dq = &scan.deques[id];
+	char **items;
+	u32 i;
+
+	__sync_fetch_and_add(&scan.pending, 1);
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail - dq->head == dq->cap) {
+		items = malloc(sizeof(*items) * dq->cap * 2);
+		if (!items)
+			errx(1, "Unable to grow scan deque!\n");
+		for (i = 0; i < dq->cap; i++)
+			items[i] = dq->items[(dq->head + i) & (dq->cap - 1)];
+		free(dq->items);
+		dq->items = items;
+		dq->tail  = dq->cap;
+		dq->head  = 0;
+		dq->cap  *= 2;
+	}
+	dq->items[dq->tail++ & (dq->cap - 1)] = path;
+	pthread_mutex_unlock(&dq->lock);
+
+	if (scan.nidle) {
+		pthread_mutex_lock(&scan.idle_lock);
+		pthread_cond_signal(&scan.idle_cond);
+		pthread_mutex_unlock(&scan.idle_lock);
+	}
+}
+
+/**
+ * @brief Get the next path for worker @p id: from the bottom of its
+ * own deque, or stolen from the top of the others.
+ *
+ * @return Returns the path, or NULL if there is nothing to do.
+ */
+static char *scan_pop(int id)
+{
+	struct scan_deque *dq;
+	char *path = NULL;
+	int i;
+
+	dq = &scan.deques[id];
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail != dq->head)
+		path = dq->items[--dq->tail & (dq->cap - 1)];
+	pthread_mutex_unlock(&dq->lock);
+
+	for (i = 1; !path && i < scan.nworkers; i++) {
+		dq = &scan.deques[(id + i) % scan.nworkers];
+		pthread_mutex_lock(&dq->lock);
+		if (dq->tail != dq->head)
+			path = dq->items[dq->head++ & (dq->cap - 1)];
+		pthread_mutex_unlock(&dq->lock);
+	}
+	return path;
+}
+
+/**
+ * @brief Push every entry of the directory @p dir (opened as @p fd)
+ * into the deque of worker @p id.
+ */
+static void scan_dir(int id, const char *path, int fd)
+{
+	struct dirent *de;
+	size_t plen, nlen;
+	char *child;
+	DIR *dir;
+
+	dir = fdopendir(fd);
+	if (!dir) {
+		warn("aix-dump: unable to read dir '%s'\n", path);
+		close(fd);
+		return;
+	}
+
+	plen = strlen(path);
+	while (plen > 1 && path[plen - 1] == '/')
+		plen--;
+
+	while ((de = readdir(dir)) != NULL) {
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		/* Symbolic links are not followed. */
+		if (de->d_type != DT_DIR && de->d_type != DT_REG &&
+			de->d_type != DT_UNKNOWN)
+			continue;
+
+		nlen  = strlen(de->d_name);
+		child = malloc(plen + nlen + 2);
+		if (!child)
+			errx(1, "Unable to allocate memory!\n");
+		memcpy(child, path, plen);
+		child[plen] = '/';
+		memcpy(child + plen + 1, de->d_name, nlen + 1);
+		scan_push(id, child);
+	}
+	closedir(dir);
+}
+
+/**
+ * @brief Process a single path: directories are expanded, XCOFF
+ * files and Big-AR archives are summarized.
+ */
+static void scan_path(int id, struct scan_buf *b, const char *path)
+{
+	struct scan_ar_ctx ctx;
+	struct big_ar ar;
+	struct stat st;
+	char *buff;
+	int fd;
+
+	fd = open(path, O_RDONLY|O_NOFOLLOW|O_NONBLOCK);
+	if (fd < 0) {
+		if (errno != ELOOP)
+			warn("aix-dump: unable to open '%s'\n", path);
+		return;
+	}
+
+	if (fstat(fd, &st) < 0)
+		goto out;
+
+	if (S_ISDIR(st.st_mode)) {
+		scan_dir(id, path, fd);
+		return;
+	}
+
+	if (!S_ISREG(st.st_mode) || st.st_size < (off_t)XCOFF_FHDR_SIZE)
+		goto out;
+
+	buff = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (buff == MAP_FAILED)
+		goto out;
+
+	if (st.st_size >= (off_t)sizeof(struct ar_fl_hdr) &&
+		!memcmp(buff, AMAGICBIG, AMAGICLEN))
+	{
+		munmap(buff, st.st_size);
+		if (ar_open(path, &ar) < 0)
+			goto out;
+		ctx.b    = b;
+		ctx.path = path;
+		ar_iterate_members(&ar, scan_ar_member, &ctx);
+		ar_close(&ar);
+		goto out;
+	}
+
+	scan_module(b, path, NULL, 0, buff, st.st_size);
+	munmap(buff, st.st_size);
+out:
+	close(fd);
+}
+
+/**
+ * @brief Scan worker: process paths until there is nothing queued
+ * nor being processed.
+ *
+ * @param arg Worker id.
+ *
+ * @return Always NULL.
+ */
+static void *scan_worker(void *arg)
+{
+	struct scan_buf b = {0};
+	struct timespec ts;
+	int id = (int)(intptr_t)arg;
+	char *path;
+
+	for (;;) {
+		path = scan_pop(id);
+		if (path) {
+			scan_path(id, &b, path);
+			free(path);
+			if (__sync_sub_and_fetch(&scan.pending, 1) == 0) {
+				pthread_mutex_lock(&scan.idle_lock);
+				pthread_cond_broadcast(&scan.idle_cond);
+				pthread_mutex_unlock(&scan.idle_lock);
+			}
+			continue;
+		}
+
+		/* Nothing to steal: wait for more work, or for the end. */
+		pthread_mutex_lock(&scan.idle_lock);
+		if (!__sync_fetch_and_add(&scan.pending, 0)) {
+			pthread_mutex_unlock(&scan.idle_lock);
+			break;
+		}
+		scan.nidle++;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 10 * 1000 * 1000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&scan.idle_cond, &scan.idle_lock, &ts);
+		scan.nidle--;
+		pthread_mutex_unlock(&scan.idle_lock);
+	}
+
+	free(b.data);
+	return NULL;
+}
+
+/**
+ * @brief Scan the tree at @p root with @p nthreads threads.
+ *
+ * @return Returns 0.
+ */
+static int scan_tree(const char *root, int nthreads)
+{
+	pthread_t *threads;
+	char *path;
+	int i, started;
+
+	scan.nworkers = nthreads;
+	scan.deques   = calloc(nthreads, sizeof(*scan.deques));
+	threads       = calloc(nthreads, sizeof(*threads));
+	if (!scan.deques || !threads)
+		errx(1, "Unable to allocate threads!\n");
+
+	for (i = 0; i < nthreads; i++) {
+		scan.deques[i].cap   = 64;
+		scan.deques[i].items = malloc(64 * sizeof(char *));
+		if (!scan.deques[i].items)
+			errx(1, "Unable to allocate memory!\n");
+		pthread_mutex_init(&scan.deques[i].lock, NULL);
+	}
+
+	path = strdup(root);
+	if (!path)
+		errx(1, "Unable to allocate memory!\n");
+	scan_push(0, path);
+
+	/* The main thread is the worker 0. */
+	for (started = 1; started < nthreads; started++) {
+		if (pthread_create(&threads[started], NULL, scan_worker,
+			(void *)(intptr_t)started))
+			break;
+	}
+
+	scan_worker((void *)(intptr_t)0);
+
+	for (i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		free(scan.deques[i].items);
+		pthread_mutex_destroy(&scan.deques[i].lock);
+	}
+	free(scan.deques);
+	free(threads);
+	fflush(stdout);
+	return 0;
+}
+
 /**
  * @brief Main entry point for the XCOFF dump utility.
  *
@@ -50,6 +570,21 @@ int main(int argc, char **argv)
 	if (argc < 2)
 		usage();
 
+	/* Scan mode. */
+	if (!strcmp(argv[1], "--scan")) {
+		if (argc != 3 && argc != 5)
+			usage();
+		i = sysconf(_SC_NPROCESSORS_ONLN);
+		if (argc == 5) {
+			if (strcmp(argv[3], "-j"))
+				usage();
+			i = atoi(argv[4]);
+		}
+		if (i <= 0)
+			i = 1;
+		return scan_tree(argv[2], i);
+	}
+
 	xcoff_file = argv[1];
 
 	/* Parse options. */
@@ -5,19 +5,66 @@
  */
 
 #include <sys/stat.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../xcoff.h"
 #include "../bigar.h"
 
-/* Linked list node for tracking seen dependencies. */
+/* Output formats. */
+#define FMT_TEXT 0
+#define FMT_JSON 1
+#define FMT_DOT  2
+
+/* Dependency graph edge: import of a module by another. */
+struct dep_edge {
+	u32 to;     /* Imported module (node index). */
+	u32 nsyms;  /* Amount of symbols imported.   */
+};
+
+/*
+ * Dependency graph node, i.e., a single (file, member) module. Nodes
+ * are also the cache of parsed import tables: each module is parsed only
+ * once, no matter how many modules import it.
+ */
 struct dep_node {
-	char path[2048];
-	struct dep_node *next;
+	char *path;              /* Dependency path, as displayed. */
+	char *file;              /* File to be opened.             */
+	char *member;            /* Archive member, or NULL.       */
+	int   is_unix;           /* /unix (kernel), not parsed.    */
+	int   missing;           /* Not found/unable to parse.     */
+	struct dep_edge *edges;  /* Imports, in import ID order.   */
+	u32   nedges;
+	u32   hash_next;         /* Next in hash chain (idx+1).    */
+};
+
+/* Dependency graph: nodes + hash set (by path) + work queue. */
+static struct {
+	struct dep_node *nodes;
+	u32 nnodes;
+	u32 capacity;
+
+	u32 *buckets;            /* Hash buckets (idx+1, 0=empty). */
+	u32 nbuckets;            /* Power of 2.                    */
+
+	u32 *queue;              /* Nodes waiting to be parsed.    */
+	u32 qhead;
+	u32 qtail;
+	u32 active;              /* Nodes being parsed right now.  */
+
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+} graph = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
 };
 
+/* Archives are shared (and lazily indexed), so accesses are serialized. */
+static pthread_mutex_t ar_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Global library path override. */
 static const char *g_lib_path = NULL;
 
@@ -31,84 +78,139 @@ static void usage(void)
 		"Usage: ldd [options] <binary_file> [archive_member]\n"
 		"Options:\n"
 		"  -L <path>  Override library search path\n"
+		"  -s <sym>   Show which archive member exports <sym>\n"
+		"  -f <fmt>   Output format: text (default), json or dot\n"
+		"  -j <n>     Parse modules with <n> threads (default: CPUs)\n"
 		"\n"
 		"Examples:\n"
 		"  ldd /path/to/binary\n"
 		"  ldd /usr/lib/libc.a shr.o\n"
-		"  ldd -L /custom/libs /path/to/binary\n");
+		"  ldd -L /custom/libs /path/to/binary\n"
+		"  ldd -f dot /path/to/binary | dot -Tsvg > deps.svg\n"
+		"  ldd -s printf /usr/lib/libc.a\n");
 	exit(1);
 }
 
 /**
- * @brief Check if a dependency has already been seen.
- *
- * @param path Dependency path to check.
- * @param seen Head of the seen dependencies linked list.
- *
- * @return Returns 1 if already seen, 0 if new.
+ * @brief Allocate memory or abort.
  */
-static int is_dep_seen(const char *path, struct dep_node *seen)
+static void *xrealloc(void *ptr, size_t size)
 {
-	struct dep_node *curr;
+	ptr = realloc(ptr, size);
+	if (!ptr)
+		errx(1, "Unable to allocate %zu bytes!\n", size);
+	return ptr;
+}
 
-	if (!path)
-		return 1;
+/**
+ * @brief Duplicate a string or abort (NULL is kept as NULL).
+ */
+static char *xstrdup(const char *s)
+{
+	char *d;
+	if (!s)
+		return NULL;
+	d = strdup(s);
+	if (!d)
+		errx(1, "Unable to allocate memory!\n");
+	return d;
+}
 
-	for (curr = seen; curr != NULL; curr = curr->next) {
-		if (!strcmp(curr->path, path))
-			return 1;
+/**
+ * @brief Hash a string (FNV-1a).
+ */
+static u32 str_hash(const char *s)
+{
+	u32 h = 2166136261u;
+	for (; *s; s++) {
+		h ^= (u8)*s;
+		h *= 16777619u;
 	}
-
-	return 0;
+	return h;
 }
 
 /**
- * @brief Add a dependency to the seen list.
+ * @brief Rebuild the hash set with twice the amount of buckets.
  *
- * @param path Dependency path to add.
- * @param seen Pointer to head of seen dependencies linked list.
+ * @note Must be called with graph.lock held.
  */
-static void add_dep(const char *path, struct dep_node **seen)
+static void grow_buckets(void)
 {
-	struct dep_node *node;
-	struct dep_node **tail;
-
-	if (!path || !seen)
-		return;
-
-	node = malloc(sizeof(struct dep_node));
-	if (!node) {
-		fprintf(stderr, "Unable to allocate memory for dependency\n");
-		exit(1);
+	u32 i, h;
+
+	graph.nbuckets = graph.nbuckets ? graph.nbuckets * 2 : 256;
+	free(graph.buckets);
+	graph.buckets = calloc(graph.nbuckets, sizeof(u32));
+	if (!graph.buckets)
+		errx(1, "Unable to allocate dependency hash set!\n");
+
+	for (i = 0; i < graph.nnodes; i++) {
+		h = str_hash(graph.nodes[i].path) & (graph.nbuckets - 1);
+		graph.nodes[i].hash_next = graph.buckets[h];
+		graph.buckets[h] = i + 1;
 	}
-
-	strncpy(node->path, path, sizeof(node->path) - 1);
-	node->path[sizeof(node->path) - 1] = '\0';
-	node->next = NULL;
-
-	/* Append to end of list. */
-	tail = seen;
-	while (*tail)
-		tail = &(*tail)->next;
-	*tail = node;
 }
 
 /**
- * @brief Free the entire dependency list.
+ * @brief Find the node for the dependency @p path, adding it (and
+ * queueing it to be parsed) if not seen yet.
  *
- * @param head Head of the dependency list to free.
+ * @param path   Dependency path.
+ * @param file   File to be opened.
+ * @param member Archive member, or NULL.
+ * @param is_unix Whether the dependency is /unix.
+ *
+ * @return Returns the node index.
+ *
+ * @note Must be called with graph.lock held.
  */
-static void free_dep_list(struct dep_node *head)
+static u32 get_node(const char *path, const char *file, const char *member,
+	int is_unix)
 {
-	struct dep_node *curr;
-	struct dep_node *next;
-
-	curr = head;
-	while (curr) {
-		next = curr->next;
-		free(curr);
-		curr = next;
+	struct dep_node *n;
+	u32 i;
+
+	if (graph.nbuckets) {
+		i = graph.buckets[str_hash(path) & (graph.nbuckets - 1)];
+		while (i) {
+			if (!strcmp(graph.nodes[i - 1].path, path))
+				return i - 1;
+			i = graph.nodes[i - 1].hash_next;
+		}
 	}
+
+	/* New node. */
+	if (graph.nnodes == graph.capacity) {
+		graph.capacity = graph.capacity ? graph.capacity * 2 : 256;
+		graph.nodes = xrealloc(graph.nodes,
+			graph.capacity * sizeof(*graph.nodes));
+		graph.queue = xrealloc(graph.queue,
+			graph.capacity * sizeof(*graph.queue));
+	}
+
+	n = &graph.nodes[graph.nnodes];
+	memset(n, 0, sizeof(*n));
+	n->path    = xstrdup(path);
+	n->file    = xstrdup(file);
+	n->member  = xstrdup(member);
+	n->is_unix = is_unix;
+	graph.nnodes++;
+
+	if (graph.nnodes * 2 > graph.nbuckets)
+		grow_buckets();
+	else {
+		i = str_hash(path) & (graph.nbuckets - 1);
+		n->hash_next = graph.buckets[i];
+		graph.buckets[i] = graph.nnodes;
+	}
+
+	/* /unix is not parsed. */
+	if (!is_unix) {
+		graph.queue[graph.qtail++] = graph.nnodes - 1;
+		pthread_cond_signal(&graph.cond);
+	}
+
+	return graph.nnodes - 1;
 }
 
 /**
@@ -123,9 +225,12 @@ static void free_dep_list(struct dep_node *head)
  * @param lib_path Custom library path (overrides impid path if set).
  * @param out      Output buffer for constructed path.
  * @param out_size Size of output buffer.
+ * @param file     Output buffer for the file part (without member).
+ * @param file_size Size of file buffer.
  */
 static void build_dep_path(const union xcoff_impid *impid,
-	const char *lib_path, char *out, size_t out_size)
+	const char *lib_path, char *out, size_t out_size, char *file,
+	size_t file_size)
 {
 	const char *path;
 	const char *base;
@@ -155,6 +260,8 @@ static void build_dep_path(const union xcoff_impid *impid,
 	if (base && base[0] != '\0')
 		strncat(out, base, out_size - strlen(out) - 1);
 
+	snprintf(file, file_size, "%s", out);
+
 	if (memb && memb[0] != '\0') {
 		strncat(out, "(", out_size - strlen(out) - 1);
 		strncat(out, memb, out_size - strlen(out) - 1);
@@ -162,55 +269,22 @@ static void build_dep_path(const union xcoff_impid *impid,
 	}
 }
 
-/**
- * @brief Verify that a file or archive exists on disk.
- *
- * For archive paths (containing parentheses), checks that the
- * archive file exists. For regular paths, checks the file directly.
- *
- * @param path Path to verify.
- *
- * @return Returns 0 if exists, -1 otherwise.
- */
-static int verify_file_exists(const char *path)
-{
-	char archive_path[2048];
-	const char *paren;
-	struct stat st;
-	size_t len;
-
-	if (!path || path[0] == '\0')
-		return -1;
-
-	/* Check if this is an archive member path. */
-	paren = strchr(path, '(');
-	if (paren) {
-		/* Extract archive path (before parenthesis). */
-		len = paren - path;
-		if (len >= sizeof(archive_path))
-			return -1;
-		strncpy(archive_path, path, len);
-		archive_path[len] = '\0';
-		return stat(archive_path, &st);
-	}
-
-	/* Regular file path. */
-	return stat(path, &st);
-}
-
 /**
  * @brief Open an XCOFF file, either standalone or from an archive.
  *
+ * Archives are obtained from the shared archive cache, so each archive
+ * is opened (and indexed) only once.
+ *
  * @param bin    Binary or archive file path.
  * @param member Archive member name (NULL for standalone binaries).
  * @param xcoff  XCOFF structure to populate.
- * @param bar    Big-AR structure to populate (only if member != NULL).
  *
  * @return Returns 0 on success, -1 on error.
  */
 static int open_xcoff_file(const char *bin, const char *member,
-	struct xcoff *xcoff, struct big_ar *bar)
+	struct xcoff *xcoff)
 {
+	struct big_ar *bar;
 	const char *buff;
 	size_t size;
 
@@ -219,7 +293,7 @@ static int open_xcoff_file(const char *bin, const char *member,
 
 	/* Standalone XCOFF binary. */
 	if (!member) {
-		if (xcoff_open(bin, xcoff) < 0) {
+		if (access(bin, F_OK) < 0 || xcoff_open(bin, xcoff) < 0) {
 			fprintf(stderr, "Unable to open XCOFF '%s'\n", bin);
 			return -1;
 		}
@@ -227,26 +301,25 @@ static int open_xcoff_file(const char *bin, const char *member,
 	}
 
 	/* Archive member. */
-	if (!bar)
-		return -1;
-
-	if (ar_open(bin, bar) < 0) {
+	pthread_mutex_lock(&ar_lock);
+	bar = ar_get(bin);
+	if (!bar) {
+		pthread_mutex_unlock(&ar_lock);
 		fprintf(stderr, "Unable to open archive '%s'\n", bin);
 		return -1;
 	}
-
 	buff = ar_extract_member(bar, member, &size);
+	pthread_mutex_unlock(&ar_lock);
+
 	if (!buff) {
 		fprintf(stderr, "Member '%s' not found in '%s'\n",
 			member, bin);
-		ar_close(bar);
 		return -1;
 	}
 
 	if (xcoff_load(bar->fd, buff, size, xcoff) < 0) {
 		fprintf(stderr, "Unable to load XCOFF from member '%s'\n",
 			member);
-		ar_close(bar);
 		return -1;
 	}
 
@@ -254,81 +327,264 @@ static int open_xcoff_file(const char *bin, const char *member,
 }
 
 /**
- * @brief Recursively process XCOFF dependencies.
- *
- * Reads the loader section import IDs, constructs full paths for each
- * dependency, and recursively processes dependencies that haven't been
- * seen yet. Special handling for /unix (kernel).
+ * @brief Parse a single module: read its import IDs, and add an edge
+ * (with the amount of imported symbols) for each of them.
  *
- * @param xcoff XCOFF structure with loader data.
- * @param seen  Pointer to head of seen dependencies list.
+ * @param idx Node index.
  */
-static void process_xcoff_deps(const struct xcoff *xcoff,
-	struct dep_node **seen)
+static void parse_node(u32 idx)
 {
+	struct xcoff_ldr_sym_tbl_hdr32 *sym;
+	struct dep_edge *edges = NULL;
+	struct xcoff xcoff = {0};
 	union xcoff_impid *impids;
-	struct xcoff_ldr_hdr32 *ldr;
-	struct big_ar bar = {0};
-	struct xcoff dep_xcoff = {0};
 	char dep_path[2048];
+	char dep_file[2048];
+	u32 *nsyms = NULL;
+	char *file, *member;
 	const char *base;
-	const char *memb;
-	int is_unix;
-	u32 i;
+	u32 i, nimpid, nedges;
+
+	pthread_mutex_lock(&graph.lock);
+	file   = graph.nodes[idx].file;
+	member = graph.nodes[idx].member;
+	pthread_mutex_unlock(&graph.lock);
 
-	if (!xcoff || !seen)
+	if (open_xcoff_file(file, member, &xcoff) < 0) {
+		pthread_mutex_lock(&graph.lock);
+		graph.nodes[idx].missing = 1;
+		pthread_mutex_unlock(&graph.lock);
 		return;
+	}
 
-	ldr = (struct xcoff_ldr_hdr32 *)&xcoff->ldr.hdr;
-	impids = xcoff->ldr.impids;
+	impids = xcoff.ldr.impids;
+	nimpid = xcoff.ldr.hdr.l_nimpid;
 
-	if (!impids)
-		return;
+	/* Imported symbols per import ID. */
+	if (nimpid > 1) {
+		nsyms = calloc(nimpid, sizeof(*nsyms));
+		edges = calloc(nimpid, sizeof(*edges));
+		if (!nsyms || !edges)
+			errx(1, "Unable to allocate memory!\n");
+	}
+	for (i = 0; nsyms && i < xcoff.ldr.hdr.l_nsyms; i++) {
+		sym = &xcoff.ldr.symtbl[i];
+		if ((sym->l_symtype & L_IMPORT) && sym->l_ifile < nimpid)
+			nsyms[sym->l_ifile]++;
+	}
 
 	/* Process each import ID (skip 0, which is LIBPATH). */
-	for (i = 1; i < ldr->l_nimpid; i++) {
-		/* Build full dependency path. */
-		build_dep_path(&impids[i], g_lib_path, dep_path,
-			sizeof(dep_path));
+	nedges = 0;
+	for (i = 1; i < nimpid; i++) {
+		build_dep_path(&impids[i], g_lib_path, dep_path, sizeof(dep_path),
+			dep_file, sizeof(dep_file));
 
-		/* Skip if already seen. */
-		if (is_dep_seen(dep_path, *seen))
-			continue;
+		base = impids[i].l_impidbase;
 
-		/* Add to seen list and print. */
-		add_dep(dep_path, seen);
-		printf("%s\n", dep_path);
+		pthread_mutex_lock(&graph.lock);
+		edges[nedges].to = get_node(dep_path, dep_file, impids[i].l_impidmem,
+			base && !strcmp(base, "unix"));
+		pthread_mutex_unlock(&graph.lock);
 
-		/* Check if this is /unix (kernel). */
-		base = impids[i].l_impidbase;
-		is_unix = (base && !strcmp(base, "unix"));
+		edges[nedges].nsyms = nsyms[i];
+		nedges++;
+	}
+
+	pthread_mutex_lock(&graph.lock);
+	graph.nodes[idx].edges  = edges;
+	graph.nodes[idx].nedges = nedges;
+	pthread_mutex_unlock(&graph.lock);
+
+	free(nsyms);
+	xcoff_free_ldr(&xcoff);
+	if (!member)
+		xcoff_close(&xcoff);
+}
+
+/**
+ * @brief Worker thread: parse queued modules until there are no more
+ * modules queued nor being parsed.
+ *
+ * @param arg Unused.
+ *
+ * @return Always NULL.
+ */
+static void *worker(void *arg)
+{
+	u32 idx;
+	((void)arg);
 
-		/* Don't recurse into /unix. */
-		if (is_unix)
+	pthread_mutex_lock(&graph.lock);
+	for (;;) {
+		while (graph.qhead == graph.qtail && graph.active)
+			pthread_cond_wait(&graph.cond, &graph.lock);
+
+		/* Nothing queued and nobody that could queue more: done. */
+		if (graph.qhead == graph.qtail)
+			break;
+
+		idx = graph.queue[graph.qhead++];
+		graph.active++;
+		pthread_mutex_unlock(&graph.lock);
+
+		parse_node(idx);
+
+		pthread_mutex_lock(&graph.lock);
+		graph.active--;
+		pthread_cond_broadcast(&graph.cond);
+	}
+	pthread_mutex_unlock(&graph.lock);
+	return NULL;
+}
+
+/**
+ * @brief Print the dependencies of @p idx (recursively), each one only
+ * once, as the traditional ldd output.
+ *
+ * @param idx     Node index.
+ * @param printed Nodes already printed.
+ */
+static void print_text(u32 idx, u8 *printed)
+{
+	struct dep_node *n = &graph.nodes[idx];
+	u32 i, to;
+
+	for (i = 0; i < n->nedges; i++) {
+		to = n->edges[i].to;
+		if (printed[to])
 			continue;
+		printed[to] = 1;
+		printf("%s\n", graph.nodes[to].path);
+		print_text(to, printed);
+	}
+}
 
-		/* Verify dependency exists. */
-		if (verify_file_exists(dep_path) < 0) {
-			fprintf(stderr, "Dependency not found: %s\n",
-				dep_path);
-			exit(1);
+/**
+ * @brief Print a JSON string (with escaping).
+ */
+static void print_json_str(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if ((u8)*s < 0x20)
+			printf("\\u%04x", (u8)*s);
+		else
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+/**
+ * @brief Print the whole dependency graph as JSON.
+ */
+static void print_json(void)
+{
+	struct dep_node *n;
+	u32 i, j;
+	int first;
+
+	printf("{\n  \"root\": ");
+	print_json_str(graph.nodes[0].path);
+	printf(",\n  \"nodes\": [\n");
+	for (i = 0; i < graph.nnodes; i++) {
+		n = &graph.nodes[i];
+		printf("    {\"id\": %u, \"path\": ", i);
+		print_json_str(n->path);
+		printf(", \"kernel\": %s, \"missing\": %s}%s\n",
+			n->is_unix ? "true" : "false",
+			n->missing ? "true" : "false",
+			(i + 1 < graph.nnodes) ? "," : "");
+	}
+
+	printf("  ],\n  \"edges\": [");
+	first = 1;
+	for (i = 0; i < graph.nnodes; i++) {
+		n = &graph.nodes[i];
+		for (j = 0; j < n->nedges; j++) {
+			printf("%s\n    {\"from\": %u, \"to\": %u, \"symbols\": %u}",
+				first ? "" : ",", i, n->edges[j].to, n->edges[j].nsyms);
+			first = 0;
 		}
+	}
+	printf("\n  ]\n}\n");
+}
 
-		/* Open and recursively process dependency. */
-		base = impids[i].l_impidbase;
-		memb = impids[i].l_impidmem;
+/**
+ * @brief Print a DOT quoted string (with escaping).
+ */
+static void print_dot_str(const char *s)
+{
+	putchar('"');
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			printf("\\%c", *s);
+		else if (*s == '\n')
+			printf("\\n");
+		else if ((u8)*s < 0x20)
+			putchar(' ');
+		else
+			putchar(*s);
+	}
+	putchar('"');
+}
 
-		if (open_xcoff_file(base, memb, &dep_xcoff, &bar) < 0)
-			continue;
+/**
+ * @brief Print the whole dependency graph as Graphviz DOT, edges are
+ * labeled with the amount of imported symbols.
+ */
+static void print_dot(void)
+{
+	struct dep_node *n;
+	u32 i, j;
+
+	printf("digraph deps {\n");
+	for (i = 0; i < graph.nnodes; i++) {
+		n = &graph.nodes[i];
+		printf("  n%u [label=", i);
+		print_dot_str(n->path);
+		printf("%s];\n", n->missing ? ", color=red" : "");
+	}
+	for (i = 0; i < graph.nnodes; i++) {
+		n = &graph.nodes[i];
+		for (j = 0; j < n->nedges; j++)
+			printf("  n%u -> n%u [label=\"%u\"];\n", i, n->edges[j].to,
+				n->edges[j].nsyms);
+	}
+	printf("}\n");
+}
+
+/**
+ * @brief Find which member of the archive @p bin exports the symbol
+ * @p sym, using the archive global symbol table only (i.e., without
+ * parsing any member).
+ *
+ * @param bin Archive file path.
+ * @param sym Symbol name.
+ *
+ * @return Returns 0 if found, 1 otherwise.
+ */
+static int find_symbol_exporter(const char *bin, const char *sym)
+{
+	const struct ar_memb_idx *m;
+	struct big_ar bar = {0};
 
-		/* Recurse. */
-		process_xcoff_deps(&dep_xcoff, seen);
+	if (ar_open(bin, &bar) < 0) {
+		fprintf(stderr, "Unable to open archive '%s'\n", bin);
+		return 1;
+	}
 
-		/* Cleanup. */
-		xcoff_close(&dep_xcoff);
-		if (memb)
-			ar_close(&bar);
+	m = ar_find_symbol(&bar, sym);
+	if (!m) {
+		fprintf(stderr, "Symbol '%s' not found in '%s'\n", sym, bin);
+		ar_close(&bar);
+		return 1;
 	}
+
+	printf("%s(%.*s)\n", bin, (int)m->hdr.namlen, m->name);
+	ar_close(&bar);
+	return 0;
 }
 
 /**
@@ -338,17 +594,47 @@ int main(int argc, char **argv)
 {
 	const char *binary_file = NULL;
 	const char *archive_member = NULL;
-	struct dep_node *seen_deps = NULL;
-	struct big_ar bar = {0};
-	struct xcoff xcoff = {0};
-	int i;
+	const char *symbol = NULL;
+	char root_path[2048];
+	pthread_t *threads;
+	int nthreads, started;
+	int format = FMT_TEXT;
+	u8 *printed;
+	int ret;
+	u32 i;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
 
 	/* Parse command line arguments. */
-	for (i = 1; i < argc; i++) {
+	for (i = 1; i < (u32)argc; i++) {
 		if (!strcmp(argv[i], "-L")) {
-			if (i + 1 >= argc)
+			if (i + 1 >= (u32)argc)
 				usage();
 			g_lib_path = argv[++i];
+		} else if (!strcmp(argv[i], "-s")) {
+			if (i + 1 >= (u32)argc)
+				usage();
+			symbol = argv[++i];
+		} else if (!strcmp(argv[i], "-j")) {
+			if (i + 1 >= (u32)argc)
+				usage();
+			nthreads = atoi(argv[++i]);
+			if (nthreads <= 0)
+				usage();
+		} else if (!strcmp(argv[i], "-f")) {
+			if (i + 1 >= (u32)argc)
+				usage();
+			i++;
+			if (!strcmp(argv[i], "text"))
+				format = FMT_TEXT;
+			else if (!strcmp(argv[i], "json"))
+				format = FMT_JSON;
+			else if (!strcmp(argv[i], "dot"))
+				format = FMT_DOT;
+			else
+				usage();
 		} else if (argv[i][0] == '-') {
 			usage();
 		} else if (!binary_file) {
@@ -363,20 +649,63 @@ int main(int argc, char **argv)
 	if (!binary_file)
 		usage();
 
-	/* Open input binary. */
-	if (open_xcoff_file(binary_file, archive_member, &xcoff, &bar) < 0) {
-		free_dep_list(seen_deps);
+	if (symbol)
+		return find_symbol_exporter(binary_file, symbol);
+
+	/* Root module. */
+	if (archive_member)
+		snprintf(root_path, sizeof root_path, "%s(%s)", binary_file,
+			archive_member);
+	else
+		snprintf(root_path, sizeof root_path, "%s", binary_file);
+
+	get_node(root_path, binary_file, archive_member, 0);
+
+	/* Resolve the graph, the main thread also works. */
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads)
+		errx(1, "Unable to allocate threads!\n");
+
+	for (started = 0; started < nthreads - 1; started++)
+		if (pthread_create(&threads[started], NULL, worker, NULL))
+			break;
+
+	worker(NULL);
+
+	for (ret = 0; ret < started; ret++)
+		pthread_join(threads[ret], NULL);
+	free(threads);
+
+	/* Unable to read the input binary. */
+	if (graph.nodes[0].missing)
 		return 1;
-	}
 
-	/* Process dependencies recursively. */
-	process_xcoff_deps(&xcoff, &seen_deps);
+	switch (format) {
+	case FMT_JSON:
+		print_json();
+		break;
+	case FMT_DOT:
+		print_dot();
+		break;
+	default:
+		printed = calloc(graph.nnodes, 1);
+		if (!printed)
+			errx(1, "Unable to allocate memory!\n");
+		printed[0] = 1;
+		print_text(0, printed);
+		free(printed);
+		break;
+	}
 
-	/* Cleanup. */
-	xcoff_close(&xcoff);
-	if (archive_member)
-		ar_close(&bar);
-	free_dep_list(seen_deps);
+	/* Missing dependencies. */
+	ret = 0;
+	for (i = 1; i < graph.nnodes; i++) {
+		if (graph.nodes[i].missing) {
+			fprintf(stderr, "Dependency not found: %s\n",
+				graph.nodes[i].path);
+			ret = 1;
+		}
+	}
 
-	return 0;
+	return ret;
 }
@@ -0,0 +1,396 @@
+/**
+ * aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+ * on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+ * Made by Theldus, 2025
+ */
+
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../xcoff.h"
+#include "../bigar.h"
+#include "../symindex.h"
+
+/* Module (XCOFF file or archive member) and its exports. */
+struct module {
+	char  *member;     /* Member name, or NULL. */
+	char **syms;
+	u8    *classes;
+	u32    nsyms;
+	u32    capacity;
+};
+
+/* Input file of the library directory. */
+struct input {
+	char *path;
+	struct module *mods;
+	u32 nmods;
+};
+
+static struct {
+	struct input *inputs;
+	u32 ninputs;
+	u32 next;          /* Next input to be picked by a worker. */
+	pthread_mutex_t lock;
+} idx = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * @brief Show usage information and exit.
+ */
+static void usage(void)
+{
+	fprintf(stderr,
+		"AIX symbol index utility:\n"
+		"Usage: symindex [-j <threads>] [-o <index>] <lib_dir>\n"
+		"       symindex -q <index> <symbol...>\n"
+		"Options:\n"
+		"  -o <index>  Output file (default: <lib_dir>/aix-symindex.db)\n"
+		"  -j <n>      Scan files with <n> threads (default: CPUs)\n"
+		"  -q <index>  Query which modules export the given symbols\n"
+		"\n"
+		"Examples:\n"
+		"  symindex /aix/usr/lib\n"
+		"  symindex -q /aix/usr/lib/aix-symindex.db printf malloc\n");
+	exit(1);
+}
+
+/**
+ * @brief Export handler: add the symbol into the module being read.
+ */
+static int add_export(const char *name, size_t len, u8 smclass, void *data)
+{
+	struct module *m = data;
+
+	if (m->nsyms == m->capacity) {
+		m->capacity = m->capacity ? m->capacity * 2 : 64;
+		m->syms     = realloc(m->syms, m->capacity * sizeof(*m->syms));
+		m->classes  = realloc(m->classes, m->capacity);
+		if (!m->syms || !m->classes)
+			errx(1, "Unable to allocate memory!\n");
+	}
+
+	m->syms[m->nsyms] = strndup(name, len);
+	if (!m->syms[m->nsyms])
+		errx(1, "Unable to allocate memory!\n");
+	m->classes[m->nsyms++] = smclass;
+	return 0;
+}
+
+/**
+ * @brief Read the exports of the module (@p buff, @p size) into a new
+ * module of @p in, if it is an XCOFF32 with exports.
+ */
+static void add_module(struct input *in, const char *member, size_t mlen,
+	const char *buff, size_t size)
+{
+	struct module m = {0};
+
+	if (xcoff_iterate_exports(buff, size, add_export, &m) <= 0) {
+		free(m.syms);
+		free(m.classes);
+		return;
+	}
+
+	if (member) {
+		m.member = strndup(member, mlen);
+		if (!m.member)
+			errx(1, "Unable to allocate memory!\n");
+	}
+
+	in->mods = realloc(in->mods, (in->nmods + 1) * sizeof(*in->mods));
+	if (!in->mods)
+		errx(1, "Unable to allocate memory!\n");
+	in->mods[in->nmods++] = m;
+}
+
+/**
+ * @brief Archive member handler: index each XCOFF member.
+ */
+static int add_ar_member(const char *memb_name, const char *memb_data,
+	const struct ar_memb_hdr_mem *mhdr, void *data)
+{
+	add_module(data, memb_name, mhdr->namlen, memb_data, mhdr->size);
+	return 0;
+}
+
+/**
+ * @brief Read all the exports of the input file @p in.
+ */
+static void read_input(struct input *in)
+{
+	struct big_ar ar;
+	struct stat st;
+	char *buff;
+	int fd;
+
+	fd = open(in->path, O_RDONLY);
+	if (fd < 0) {
+		warn("Unable to open '%s'\n", in->path);
+		return;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < AMAGICLEN)
+		goto out;
+
+	buff = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (buff == MAP_FAILED)
+		goto out;
+
+	if (!memcmp(buff, AMAGICBIG, AMAGICLEN)) {
+		munmap(buff, st.st_size);
+		if (ar_open(in->path, &ar) < 0)
+			goto out;
+		ar_iterate_members(&ar, add_ar_member, in);
+		ar_close(&ar);
+	} else {
+		add_module(in, NULL, 0, buff, st.st_size);
+		munmap(buff, st.st_size);
+	}
+out:
+	close(fd);
+}
+
+/**
+ * @brief Worker thread: read inputs until there are no more.
+ */
+static void *worker(void *arg)
+{
+	u32 i;
+	((void)arg);
+
+	for (;;) {
+		pthread_mutex_lock(&idx.lock);
+		i = idx.next++;
+		pthread_mutex_unlock(&idx.lock);
+		if (i >= idx.ninputs)
+			break;
+		read_input(&idx.inputs[i]);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Compare inputs by path, so the index does not depend on the
+ * directory order.
+ */
+static int cmp_input(const void *a, const void *b)
+{
+	const struct input *ia = a, *ib = b;
+	return strcmp(ia->path, ib->path);
+}
+
+/**
+ * @brief List all regular files of the library directory @p dir.
+ */
+static void list_inputs(const char *dir)
+{
+	struct dirent *de;
+	struct stat st;
+	u32 capacity = 0;
+	char *path;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		errx(1, "Unable to open directory '%s'\n", dir);
+
+	while ((de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+		if (asprintf(&path, "%s/%s", dir, de->d_name) < 0)
+			errx(1, "Unable to allocate memory!\n");
+		if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+			free(path);
+			continue;
+		}
+		if (idx.ninputs == capacity) {
+			capacity   = capacity ? capacity * 2 : 256;
+			idx.inputs = realloc(idx.inputs, capacity * sizeof(*idx.inputs));
+			if (!idx.inputs)
+				errx(1, "Unable to allocate memory!\n");
+		}
+		memset(&idx.inputs[idx.ninputs], 0, sizeof(*idx.inputs));
+		idx.inputs[idx.ninputs++].path = path;
+	}
+	closedir(d);
+
+	if (idx.ninputs)
+		qsort(idx.inputs, idx.ninputs, sizeof(*idx.inputs), cmp_input);
+}
+
+/**
+ * @brief Build the index for the library directory @p dir, and save
+ * it on @p out.
+ *
+ * @return Returns 0 if success, 1 otherwise.
+ */
+static int build_index(const char *dir, const char *out, int nthreads)
+{
+	struct symindex_wfile *wfiles;
+	char real_dir[PATH_MAX];
+	pthread_t *threads;
+	struct module *m;
+	u32 i, j, n, nsyms;
+	int started, ret;
+
+	if (!realpath(dir, real_dir))
+		errx(1, "Unable to resolve directory '%s'\n", dir);
+
+	list_inputs(real_dir);
+
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads)
+		errx(1, "Unable to allocate threads!\n");
+
+	/* The main thread also works. */
+	for (started = 0; started < nthreads - 1; started++)
+		if (pthread_create(&threads[started], NULL, worker, NULL))
+			break;
+	worker(NULL);
+	for (i = 0; i < (u32)started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	/* Flatten, in (path, member) order. */
+	for (i = 0, n = 0; i < idx.ninputs; i++)
+		n += idx.inputs[i].nmods;
+
+	wfiles = calloc(n ? n : 1, sizeof(*wfiles));
+	if (!wfiles)
+		errx(1, "Unable to allocate memory!\n");
+
+	nsyms = 0;
+	for (i = 0, n = 0; i < idx.ninputs; i++) {
+		for (j = 0; j < idx.inputs[i].nmods; j++, n++) {
+			m = &idx.inputs[i].mods[j];
+			wfiles[n].path    = idx.inputs[i].path;
+			wfiles[n].member  = m->member;
+			wfiles[n].syms    = (const char **)m->syms;
+			wfiles[n].classes = m->classes;
+			wfiles[n].nsyms   = m->nsyms;
+			nsyms += m->nsyms;
+		}
+	}
+
+	ret = symindex_write(out, wfiles, n);
+	if (ret < 0)
+		warn("Unable to write index '%s'\n", out);
+	else
+		printf("%s: %u symbols, %u modules\n", out, nsyms, n);
+
+	/* Cleanup. */
+	for (i = 0; i < idx.ninputs; i++) {
+		for (j = 0; j < idx.inputs[i].nmods; j++) {
+			m = &idx.inputs[i].mods[j];
+			for (n = 0; n < m->nsyms; n++)
+				free(m->syms[n]);
+			free(m->syms);
+			free(m->classes);
+			free(m->member);
+		}
+		free(idx.inputs[i].mods);
+		free(idx.inputs[i].path);
+	}
+	free(idx.inputs);
+	free(wfiles);
+	return ret < 0;
+}
+
+/**
+ * @brief Query the index @p file for the symbols @p syms.
+ *
+ * @return Returns 0 if all symbols were found, 1 otherwise.
+ */
+static int query_index(const char *file, char **syms, int nsyms)
+{
+	const struct symindex_sym *s;
+	const char *path, *member;
+	struct symindex si;
+	int i, found, ret;
+
+	if (symindex_open(file, &si) < 0)
+		errx(1, "Unable to open index '%s'\n", file);
+
+	ret = 0;
+	for (i = 0; i < nsyms; i++) {
+		found = 0;
+		for (s = symindex_find(&si, syms[i], NULL); s;
+			s = symindex_find(&si, syms[i], s))
+		{
+			symindex_get_file(&si, s, &path, &member);
+			if (!path)
+				continue;
+			if (member)
+				printf("%s: %s(%s) class=0x%x\n", syms[i], path, member,
+					s->smclass);
+			else
+				printf("%s: %s class=0x%x\n", syms[i], path, s->smclass);
+			found = 1;
+		}
+		if (!found) {
+			printf("%s: not found\n", syms[i]);
+			ret = 1;
+		}
+	}
+
+	symindex_close(&si);
+	return ret;
+}
+
+/**
+ * @brief Main entry point. =)
+ */
+int main(int argc, char **argv)
+{
+	const char *out = NULL;
+	const char *dir = NULL;
+	char def_out[PATH_MAX];
+	int nthreads;
+	int i;
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-q")) {
+			if (i + 2 >= argc)
+				usage();
+			return query_index(argv[i + 1], argv + i + 2, argc - i - 2);
+		} else if (!strcmp(argv[i], "-o")) {
+			if (i + 1 >= argc)
+				usage();
+			out = argv[++i];
+		} else if (!strcmp(argv[i], "-j")) {
+			if (i + 1 >= argc)
+				usage();
+			nthreads = atoi(argv[++i]);
+			if (nthreads <= 0)
+				usage();
+		} else if (argv[i][0] == '-' || dir) {
+			usage();
+		} else {
+			dir = argv[i];
+		}
+	}
+
+	if (!dir)
+		usage();
+
+	if (!out) {
+		snprintf(def_out, sizeof def_out, "%s/aix-symindex.db", dir);
+		out = def_out;
+	}
+
+	return build_index(dir, out, nthreads);
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env bash
+
+#
+# aix-user: a public-domain PoC/attempt to run 32-bit AIX binaries
+# on Linux via Unicorn, same idea as 'qemu-user', but for AIX+PPC
+# Made by Theldus, 2025-2026
+#
+
+#
+# Benchmark for 'aix-ar -x': generates a synthetic Big-AR archive
+# (1 GiB by default) and measures the extraction time with one thread
+# and with all CPUs.
+#
+# Usage: bench-aix-ar.sh [size_in_MiB] [work_dir]
+#
+
+CURDIR="$( cd "$(dirname "${BASH_SOURCE[0]}" )" >/dev/null 2>&1 && pwd )"
+AIXAR="${CURDIR}/aix-ar"
+SIZE_MB="${1:-1024}"
+WORKDIR="${2:-$(mktemp -d)}"
+ARCHIVE="${WORKDIR}/bench.a"
+OUTDIR="${WORKDIR}/out"
+
+# Fixed-size header fields are space-padded.
+function field() {
+	printf "%-${2}s" "$1"
+}
+
+# Member sizes: mix of big and small members, 128 KiB up to 32 MiB.
+function member_size() {
+	local sizes=(131072 1048576 4194304 33554432 262144 16777216 524288 2097152)
+	echo "${sizes[$(( $1 % ${#sizes[@]} ))]}"
+}
+
+# Generates the archive, writing every member header/data in order.
+function gen_archive() {
+	local total=$(( SIZE_MB * 1024 * 1024 ))
+	local fl_hdr_size=128
+	local names=() sizes=() offs=()
+	local off=$fl_hdr_size
+	local acc=0 i=0 n name size hlen
+
+	# Layout.
+	while [ "$acc" -lt "$total" ]; do
+		name="memb${i}.o"
+		size=$(member_size "$i")
+		if [ $(( acc + size )) -gt "$total" ]; then
+			size=$(( total - acc ))
+		fi
+		names+=("$name"); sizes+=("$size"); offs+=("$off")
+
+		hlen=$(( 112 + ${#name} ))
+		hlen=$(( hlen + (hlen & 1) + 2 + size ))
+		off=$(( off + hlen + (hlen & 1) ))
+		acc=$(( acc + size ))
+		i=$(( i + 1 ))
+	done
+	n=$i
+
+	# File header.
+	{
+		printf "<bigaf>\n"
+		field 0 20                     # Member table.
+		field 0 20                     # GST.
+		field 0 20                     # GST64.
+		field "${offs[0]}" 20          # First member.
+		field "${offs[$((n - 1))]}" 20 # Last member.
+		field 0 20                     # Free list.
+
+		# Members.
+		for (( i = 0; i < n; i++ )); do
+			name="${names[$i]}"
+			size="${sizes[$i]}"
+			field "$size" 20
+			if [ $(( i + 1 )) -lt "$n" ]; then
+				field "${offs[$((i + 1))]}" 20
+			else
+				field 0 20
+			fi
+			if [ "$i" -gt 0 ]; then
+				field "${offs[$((i - 1))]}" 20
+			else
+				field 0 20
+			fi
+			field 0 12; field 0 12; field 0 12; field 644 12
+			field "${#name}" 4
+			printf "%s" "$name"
+			if [ $(( (112 + ${#name}) & 1 )) -ne 0 ]; then
+				printf "\0"
+			fi
+			printf "\`\n"
+			head -c "$size" /dev/urandom
+			if [ $(( (112 + ${#name} + ((112 + ${#name}) & 1) + 2 + size) & 1 )) -ne 0 ]; then
+				printf "\0"
+			fi
+		done
+	} > "$ARCHIVE"
+
+	echo "Generated ${ARCHIVE}: ${n} members, ${SIZE_MB} MiB"
+}
+
+# Runs a single extraction, with cold output directory.
+function run_extract() {
+	local threads="$1"
+	local start end
+
+	rm -rf "$OUTDIR"
+	sync
+	start=$(date +%s.%N)
+	"$AIXAR" "$ARCHIVE" -x "$OUTDIR" -j "$threads" > /dev/null || exit 1
+	sync
+	end=$(date +%s.%N)
+	awk -v t="$threads" -v s="$start" -v e="$end" \
+		'BEGIN { printf "  threads=%-3s %8.3f s\n", t, e - s }'
+}
+
+if [ ! -x "$AIXAR" ]; then
+	echo "aix-ar not found, please build it first!"
+	exit 1
+fi
+
+mkdir -p "$WORKDIR"
+gen_archive
+
+echo "Extraction times:"
+run_extract 1
+run_extract "$(nproc)"
+
+rm -rf "$OUTDIR" "$ARCHIVE"
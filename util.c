@@ -5,8 +5,13 @@
  */
 
 #include <stdio.h>
+#include "flightrec.h"
+#include "sym.h"
 #include "util.h"
 
+/* Maximum amount of frames shown on the backtrace. */
+#define BACKTRACE_MAX_DEPTH 64
+
 /**/
 static const int regs_to_be_read[] = {
 	UC_PPC_REG_0,  UC_PPC_REG_1,  UC_PPC_REG_2,   UC_PPC_REG_3,
@@ -31,7 +36,8 @@ static const int regs_to_be_read[] = {
  * @brief Dump all PowerPC general-purpose and special registers.
  *
  * Reads and displays all 32 general-purpose registers (r0-r31) plus
- * special registers (PC, MSR, CR, LR, CTR, XER) in a formatted table.
+ * special registers (PC, MSR, CR, LR, CTR, XER) in a formatted table,
+ * followed by a symbolized backtrace (walking the back-chain).
  * Used for debugging and error reporting.
  *
  * @param uc Unicorn engine instance.
@@ -39,8 +45,10 @@ static const int regs_to_be_read[] = {
 void register_dump(uc_engine *uc)
 {
 	int i;
-	int j;
+	u32 j, depth;
 	void *ptr_vals[PPC_REGS_AMNT] = {0};
+	u32 pcs[BACKTRACE_MAX_DEPTH];
+	char sym[SYM_FORMAT_LEN];
 	
 	union ppc_regs {
 		u32 u32_vals[PPC_REGS_AMNT];
@@ -75,4 +83,15 @@ void register_dump(uc_engine *uc)
 		ppcregs.u32_vals[36],
 		ppcregs.u32_vals[37]
 	);
+
+	fprintf(stderr, "LR:  %s\n",
+		sym_format(uc, ppcregs.u32_vals[35], sym, sizeof sym));
+
+	depth = sym_unwind(uc, ppcregs.u32_vals[32], pcs, BACKTRACE_MAX_DEPTH);
+	fprintf(stderr, "Backtrace:\n");
+	for (j = 0; j < depth; j++)
+		fprintf(stderr, "  #%-2u %s\n", j,
+			sym_format(uc, pcs[j], sym, sizeof sym));
+
+	flightrec_dump();
 }
@@ -14,8 +14,27 @@ struct args {
 	const char *lib_path;     /* -L: library search path  */
 	int trace_syscall;        /* -s: enable syscall trace */
 	int trace_loader;         /* -l: enable loader/binder trace */
+	int syscall_stats;        /* -c: syscall statistics   */
 	int gdb_port;             /* -g: GDB server port      */
 	int enable_gdb;           /* -d: enable GDB server    */
+	int gdb_attach;           /* -a: GDB attach mode      */
+	const char *symindex;     /* -i: symbol index file    */
+	int stats;                /* --stats: loader stats    */
+	const char *stats_json;   /* --stats-json: JSON file  */
+	const char *trace_out;    /* --trace-out: timeline file */
+	const char *profile;      /* --profile: folded stacks file */
+	int profile_hz;           /* --profile-hz: sampling rate */
+	const char *bbcount;      /* --bbcount: drcov file    */
+	int ltrace;               /* --ltrace: library calls  */
+	const char *ltrace_log;   /* --ltrace-log: call log   */
+	const char *heap_profile; /* --heap-profile: brk log  */
+	int overhead;             /* --overhead: time split   */
+	const char *overhead_json; /* --overhead-json: file   */
+	int no_flightrec;         /* --no-flightrec           */
+	int flightrec_blocks;     /* --flightrec-blocks       */
+	const char *record;       /* --record: syscall log    */
+	const char *replay;       /* --replay: syscall log    */
+	int insn_stats;           /* --insn-stats             */
 };
 extern struct args args;
 
@@ -31,10 +50,15 @@ typedef  int64_t s64;
 #define min(x,y) ((x)<(y)?(x):(y))
 #define max(x,y) ((x)>(y)?(x):(y))
 
+/* Called by errx() before exiting, if linked in (see flightrec.c). */
+extern void errx_hook(void) __attribute__((weak));
+
 #define warn(...) fprintf(stderr, __VA_ARGS__)
 #define errx(code,...) \
 	do {\
 		fprintf(stderr, __VA_ARGS__);\
+		if (errx_hook)\
+			errx_hook();\
 		exit((code));\
 	} while (0)
 
@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -462,10 +463,9 @@ int xcoff_read_ldrhdr(struct xcoff *xcoff)
 		return -1;
 
 	ldr = &xcoff->ldr.hdr;
-	if (get_section(xcoff, &sec, STYP_LOADER) < 0) {
-		errx(1, "Unable to find loader section!\n");
+	/* Not fatal: plain objects do not have a loader section. */
+	if (get_section(xcoff, &sec, STYP_LOADER) < 0)
 		return -1;
-	}
 
 	/* Invalid data?. */
 	if (xcoff->file_size < sec->s_scnptr+sec->s_size)
@@ -591,6 +591,466 @@ u32 xcoff_get_entrypoint(const struct xcoff *xcoff)
 	return ds.address;
 }
 
+/* Big-endian reads from a (possibly unaligned) buffer. */
+static inline u16 rd16(const char *p) {
+	u16 v;
+	memcpy(&v, p, sizeof v);
+	return be16toh(v);
+}
+static inline u32 rd32(const char *p) {
+	u32 v;
+	memcpy(&v, p, sizeof v);
+	return be32toh(v);
+}
+static inline u64 rd64(const char *p) {
+	u64 v;
+	memcpy(&v, p, sizeof v);
+	return be64toh(v);
+}
+
+/**
+ * @brief xcoff_summarize() for XCOFF64: same as the XCOFF32 version,
+ * but with the 64-bit header layouts, and the loader symbol table at
+ * l_symoff.
+ *
+ * @param buff Buffer containing the XCOFF64 file data.
+ * @param size Size of the buffer in bytes (at least the file header).
+ * @param s    Summary to be filled (magic already set).
+ *
+ * @return Always 0.
+ */
+static int summarize64(const char *buff, size_t size, struct xcoff_summary *s)
+{
+	const struct xcoff_sec_summary *ldr_sec = NULL;
+	struct xcoff_sec_summary *sec;
+	u64 off, end, data_start = 0, entry_desc = 0;
+	u64 impoff, symoff;
+	u16 opthdr, sndata = 0;
+	const char *p;
+	u32 i, nsyms;
+	u8  type;
+
+	s->is64  = 1;
+	s->nscns = rd16(buff + 2);
+	opthdr   = rd16(buff + 16);
+	s->flags = rd16(buff + 18);
+
+	/* Auxiliary header. */
+	if (opthdr >= XCOFF64_AHDR_SIZE &&
+		size >= XCOFF64_FHDR_SIZE + XCOFF64_AHDR_SIZE)
+	{
+		p = buff + XCOFF64_FHDR_SIZE;
+		s->has_aux = 1;
+		data_start = rd64(p + 16);
+		s->toc     = rd64(p + 24);
+		sndata     = rd16(p + 36);
+		s->tsize   = rd64(p + 56);
+		s->dsize   = rd64(p + 64);
+		s->bsize   = rd64(p + 72);
+		entry_desc = rd64(p + 80);
+	}
+
+	/* Section headers. */
+	off = XCOFF64_FHDR_SIZE + opthdr;
+	for (i = 0; i < s->nscns; i++, off += XCOFF64_SHDR_SIZE) {
+		if (i >= sizeof(s->sections)/sizeof(s->sections[0]))
+			break;
+		if (off + XCOFF64_SHDR_SIZE > size)
+			break;
+
+		p   = buff + off;
+		sec = &s->sections[i];
+		memcpy(sec->name, p, sizeof(sec->name));
+		sec->vaddr  = rd64(p + 16);
+		sec->size   = rd64(p + 24);
+		sec->scnptr = rd64(p + 32);
+		sec->nreloc = rd32(p + 56);
+		sec->flags  = rd32(p + 64);
+
+		s->nsecs++;
+		s->nrelocs += sec->nreloc;
+		if (sec->flags == STYP_LOADER && !ldr_sec)
+			ldr_sec = sec;
+	}
+
+	/* Entry point: first doubleword of the entry descriptor, in .data. */
+	if (entry_desc != 0 && entry_desc != ~0ULL && sndata >= 1 &&
+		sndata <= s->nsecs && entry_desc >= data_start)
+	{
+		off = entry_desc - data_start;
+		if (off < size && s->sections[sndata - 1].scnptr < size) {
+			off += s->sections[sndata - 1].scnptr;
+			if (off + sizeof(u64) <= size)
+				s->entry = rd64(buff + off);
+		}
+	}
+
+	/* Loader section. */
+	if (!ldr_sec)
+		return 0;
+
+	off = ldr_sec->scnptr;
+	if (off >= size || size - off < XCOFF64_LHDR_SIZE)
+		return 0;
+
+	p             = buff + off;
+	nsyms         = rd32(p + 4);
+	s->ldr_nreloc = rd32(p + 8);
+	s->impids_len = rd32(p + 12);
+	s->nimpid     = rd32(p + 16);
+	impoff        = rd64(p + 24);
+	symoff        = rd64(p + 40);
+	s->has_ldr    = 1;
+
+	/* Symbols: only the symbol type matters here. */
+	if (symoff < size) {
+		end = off + symoff + (u64)nsyms * XCOFF64_LSYM_SIZE;
+		if (end <= size) {
+			p = buff + off + symoff;
+			for (i = 0; i < nsyms; i++, p += XCOFF64_LSYM_SIZE) {
+				type = p[14];
+				if (type & L_IMPORT)
+					s->nimports++;
+				else if (type & L_EXPORT)
+					s->nexports++;
+			}
+		}
+	}
+
+	/* Import IDs string table, kept as-is (mapped). */
+	if (impoff < size && s->impids_len &&
+		off + impoff + s->impids_len <= size)
+	{
+		s->impids = buff + off + impoff;
+	}
+	else
+		s->impids_len = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Summarize the XCOFF (32 or 64-bit) pointed by @p buff: headers,
+ * sections and loader counters.
+ *
+ * Contrary to xcoff_load(), nothing is allocated and nothing is fatal:
+ * every table is bounds-checked against @p size, so this is safe to
+ * use on arbitrary (and possibly broken) files.
+ *
+ * @param buff Buffer containing the XCOFF file data.
+ * @param size Size of the buffer in bytes.
+ * @param s    Summary to be filled.
+ *
+ * @return Returns 0 if success, -1 if @p buff is not a valid XCOFF.
+ */
+int xcoff_summarize(const char *buff, size_t size, struct xcoff_summary *s)
+{
+	const struct xcoff_sec_hdr32 *ldr_sec = NULL;
+	struct xcoff_file_hdr32 hdr;
+	struct xcoff_sec_hdr32 *sec;
+	const char *p;
+	u64 off, end;
+	u32 i, desc;
+	u16 opthdr;
+	u8  type;
+
+	if (!buff || !s || size < XCOFF_FHDR_SIZE)
+		return -1;
+
+	memset(s, 0, sizeof(*s));
+	memcpy(&s->magic, buff, sizeof(s->magic));
+	CONV16(s->magic);
+
+	if (s->magic == XCOFFF64_MAGIC) {
+		if (size < XCOFF64_FHDR_SIZE)
+			return -1;
+		return summarize64(buff, size, s);
+	}
+	if (s->magic != XCOFFF32_MAGIC)
+		return -1;
+
+	memcpy(&hdr, buff, sizeof(hdr));
+	CONV16(hdr.f_nscns);
+	CONV16(hdr.f_opthdr);
+	CONV16(hdr.f_flags);
+	s->nscns = hdr.f_nscns;
+	s->flags = hdr.f_flags;
+	opthdr   = hdr.f_opthdr;
+
+	/* Auxiliary header: objects (.o) may have a short one, or none. */
+	if (opthdr >= XCOFF_AHDR_SIZE && size >= XCOFF_FHDR_SIZE+XCOFF_AHDR_SIZE) {
+		s->has_aux = 1;
+		memcpy(&s->aux, buff + XCOFF_FHDR_SIZE, XCOFF_AHDR_SIZE);
+		CONV32(s->aux.o_tsize);
+		CONV32(s->aux.o_dsize);
+		CONV32(s->aux.o_bsize);
+		CONV32(s->aux.o_entry);
+		CONV32(s->aux.o_text_start);
+		CONV32(s->aux.o_data_start);
+		CONV32(s->aux.o_toc);
+		CONV16(s->aux.o_snentry);
+		CONV16(s->aux.o_sntext);
+		CONV16(s->aux.o_sndata);
+		CONV16(s->aux.o_sntoc);
+		CONV16(s->aux.o_snloader);
+		CONV16(s->aux.o_snbss);
+		s->tsize = s->aux.o_tsize;
+		s->dsize = s->aux.o_dsize;
+		s->bsize = s->aux.o_bsize;
+		s->toc   = s->aux.o_toc;
+	}
+
+	/* Section headers. */
+	off = XCOFF_FHDR_SIZE + opthdr;
+	for (i = 0; i < s->nscns; i++, off += XCOFF_SHDR_SIZE) {
+		if (i >= sizeof(s->secs)/sizeof(s->secs[0]))
+			break;
+		if (off + XCOFF_SHDR_SIZE > size)
+			break;
+
+		sec = &s->secs[i];
+		memcpy(sec, buff + off, XCOFF_SHDR_SIZE);
+		CONV32(sec->s_paddr);
+		CONV32(sec->s_vaddr);
+		CONV32(sec->s_size);
+		CONV32(sec->s_scnptr);
+		CONV32(sec->s_relptr);
+		CONV32(sec->s_lnnoptr);
+		CONV16(sec->s_nreloc);
+		CONV16(sec->s_nlnno);
+		CONV32(sec->s_flags);
+
+		memcpy(s->sections[i].name, sec->s_name, sizeof(sec->s_name));
+		s->sections[i].vaddr  = sec->s_vaddr;
+		s->sections[i].size   = sec->s_size;
+		s->sections[i].scnptr = sec->s_scnptr;
+		s->sections[i].nreloc = sec->s_nreloc;
+		s->sections[i].flags  = sec->s_flags;
+
+		s->nsecs++;
+		s->nrelocs += sec->s_nreloc;
+		if (sec->s_flags == STYP_LOADER && !ldr_sec)
+			ldr_sec = sec;
+	}
+
+	/* Entry point: first word of the entry descriptor, in .data. */
+	if (s->has_aux && s->aux.o_entry != 0 && s->aux.o_entry != 0xFFFFFFFF &&
+		s->aux.o_sndata >= 1 && s->aux.o_sndata <= s->nsecs &&
+		s->aux.o_entry >= s->aux.o_data_start)
+	{
+		off  = (u64)s->aux.o_entry - s->aux.o_data_start;
+		off += s->secs[s->aux.o_sndata - 1].s_scnptr;
+		if (off + sizeof(desc) <= size) {
+			memcpy(&desc, buff + off, sizeof(desc));
+			CONV32(desc);
+			s->entry = desc;
+		}
+	}
+
+	/* Loader section. */
+	if (!ldr_sec)
+		return 0;
+
+	off = ldr_sec->s_scnptr;
+	if (off + sizeof(s->ldr) > size)
+		return 0;
+
+	memcpy(&s->ldr, buff + off, sizeof(s->ldr));
+	CONV32(s->ldr.l_version);
+	CONV32(s->ldr.l_nsyms);
+	CONV32(s->ldr.l_nreloc);
+	CONV32(s->ldr.l_istlen);
+	CONV32(s->ldr.l_nimpid);
+	CONV32(s->ldr.l_impoff);
+	CONV32(s->ldr.l_stlen);
+	CONV32(s->ldr.l_stoff);
+	s->has_ldr    = 1;
+	s->ldr_nreloc = s->ldr.l_nreloc;
+	s->nimpid     = s->ldr.l_nimpid;
+
+	/* Symbols: only the symbol type matters here. */
+	p   = buff + off + sizeof(s->ldr);
+	end = off + sizeof(s->ldr) +
+		(u64)s->ldr.l_nsyms * sizeof(struct xcoff_ldr_sym_tbl_hdr32);
+	if (end <= size) {
+		for (i = 0; i < s->ldr.l_nsyms; i++) {
+			type = p[offsetof(struct xcoff_ldr_sym_tbl_hdr32, l_symtype)];
+			if (type & L_IMPORT)
+				s->nimports++;
+			else if (type & L_EXPORT)
+				s->nexports++;
+			p += sizeof(struct xcoff_ldr_sym_tbl_hdr32);
+		}
+	}
+
+	/* Import IDs string table, kept as-is (mapped). */
+	end = off + (u64)s->ldr.l_impoff + s->ldr.l_istlen;
+	if (s->ldr.l_istlen && end <= size) {
+		s->impids     = buff + off + s->ldr.l_impoff;
+		s->impids_len = s->ldr.l_istlen;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Iterate over all symbols exported by the XCOFF32 pointed by
+ * @p buff (re-exported imports are skipped).
+ *
+ * Like xcoff_summarize(), nothing is allocated and every access is
+ * bounds-checked, so this is safe to use on arbitrary files.
+ *
+ * @param buff Buffer containing the XCOFF file data.
+ * @param size Size of the buffer in bytes.
+ * @param fn   Function called for each exported symbol.
+ * @param data User defined pointer, passed to @p fn.
+ *
+ * @return Returns the amount of exported symbols, or -1 if @p buff
+ * is not an XCOFF32 with a loader section, or @p fn aborted.
+ */
+int xcoff_iterate_exports(const char *buff, size_t size,
+	xcoff_export_fn fn, void *data)
+{
+	struct xcoff_ldr_sym_tbl_hdr32 st;
+	const struct xcoff_sec_hdr32 *sec;
+	struct xcoff_summary sum;
+	const char *name;
+	u64 off, ldr_end;
+	size_t len;
+	u32 i, n;
+
+	if (xcoff_summarize(buff, size, &sum) < 0 || sum.is64 || !sum.has_ldr)
+		return -1;
+
+	for (i = 0; i < sum.nsecs; i++)
+		if (sum.secs[i].s_flags == STYP_LOADER)
+			break;
+	sec = &sum.secs[i];
+
+	ldr_end = min((u64)sec->s_scnptr + sec->s_size, size);
+	off     = sec->s_scnptr + sizeof(struct xcoff_ldr_hdr32);
+
+	for (i = 0, n = 0; i < sum.ldr.l_nsyms; i++, off += sizeof(st)) {
+		if (off + sizeof(st) > ldr_end)
+			return -1;
+
+		memcpy(&st, buff + off, sizeof(st));
+		if (!(st.l_symtype & L_EXPORT) || (st.l_symtype & L_IMPORT))
+			continue;
+
+		/* Inline (8 bytes, null-padded) or in the string table. */
+		if (st.u.s.zeroes) {
+			name = st.u.l_name;
+			len  = strnlen(name, 8);
+		} else {
+			CONV32(st.u.s.offset);
+			if ((u64)sec->s_scnptr + sum.ldr.l_stoff + st.u.s.offset >= ldr_end)
+				continue;
+			name = buff + sec->s_scnptr + sum.ldr.l_stoff + st.u.s.offset;
+			len  = strnlen(name, buff + ldr_end - name);
+		}
+
+		if (fn(name, len, st.l_smclass, data) < 0)
+			return -1;
+		n++;
+	}
+	return n;
+}
+
+/**
+ * @brief Iterate over all code symbols of the symbol table of the
+ * XCOFF32 pointed by @p buff, i.e., the labels (XTY_LD) and program
+ * code csects (XTY_SD, XMC_PR) on .text, including static ones.
+ *
+ * Like xcoff_iterate_exports(), nothing is allocated and every access
+ * is bounds-checked.
+ *
+ * @param buff Buffer containing the XCOFF file data.
+ * @param size Size of the buffer in bytes.
+ * @param fn   Function called for each code symbol.
+ * @param data User defined pointer, passed to @p fn.
+ *
+ * @return Returns the amount of code symbols, or -1 if @p buff is not
+ * an XCOFF32, or @p fn aborted. Stripped files have no symbols.
+ */
+int xcoff_iterate_functions(const char *buff, size_t size,
+	xcoff_func_fn fn, void *data)
+{
+	struct xcoff_file_hdr32 hdr;
+	struct xcoff_summary sum;
+	struct xcoff_syment32 se;
+	struct xcoff_csect_aux32 aux;
+	u64 off, strtab, strtab_len;
+	const char *name;
+	size_t len;
+	u32 i, n;
+
+	if (xcoff_summarize(buff, size, &sum) < 0 || sum.is64 || !sum.has_aux)
+		return -1;
+
+	memcpy(&hdr, buff, sizeof(hdr));
+	CONV32(hdr.f_symptr);
+	CONV32(hdr.f_nsyms);
+
+	if (!hdr.f_symptr || !hdr.f_nsyms)
+		return 0;
+
+	strtab = (u64)hdr.f_symptr + (u64)hdr.f_nsyms * XCOFF_SYMESZ;
+	if (strtab > size)
+		return -1;
+
+	/* String table: 4-byte length (itself included) and strings. */
+	strtab_len = 0;
+	if (strtab + 4 <= size) {
+		memcpy(&i, buff + strtab, 4);
+		strtab_len = min((u64)be32toh(i), size - strtab);
+	}
+
+	off = hdr.f_symptr;
+	for (i = 0, n = 0; i < hdr.f_nsyms; i++, off += XCOFF_SYMESZ) {
+		memcpy(&se, buff + off, sizeof(se));
+
+		/* Skip the auxiliary entries, but keep the last one. */
+		if (se.n_numaux) {
+			if (i + se.n_numaux >= hdr.f_nsyms)
+				break;
+			i   += se.n_numaux;
+			off += se.n_numaux * XCOFF_SYMESZ;
+			memcpy(&aux, buff + off, sizeof(aux));
+		}
+
+		if (se.n_sclass != C_EXT && se.n_sclass != C_HIDEXT &&
+			se.n_sclass != C_WEAKEXT)
+		{
+			continue;
+		}
+		if (!se.n_numaux || (s16)be16toh(se.n_scnum) != sum.aux.o_sntext)
+			continue;
+		if ((aux.x_smtyp & 7) != XTY_LD &&
+			((aux.x_smtyp & 7) != XTY_SD || aux.x_smclas != XMC_PR))
+		{
+			continue;
+		}
+
+		/* Inline (8 bytes, null-padded) or in the string table. */
+		if (se.u.s.zeroes) {
+			name = se.u.n_name;
+			len  = strnlen(name, 8);
+		} else {
+			CONV32(se.u.s.offset);
+			if (se.u.s.offset < 4 || se.u.s.offset >= strtab_len)
+				continue;
+			name = buff + strtab + se.u.s.offset;
+			len  = strnlen(name, strtab_len - se.u.s.offset);
+		}
+
+		if (fn(name, len, be32toh(se.n_value), data) < 0)
+			return -1;
+		n++;
+	}
+	return n;
+}
+
 /**
  * @brief Read all XCOFF headers in sequence.
  *
@@ -629,6 +1089,7 @@ int xcoff_load(int fd, const char *buff, size_t size, struct xcoff *xcoff)
 	if (!buff || !xcoff || !size || fd < 0)
 		return -1;
 
+	xcoff->fd        = fd;
 	xcoff->file_size = size;
 	xcoff->buff      = buff;
 
@@ -683,6 +1144,35 @@ int xcoff_open(const char *bin, struct xcoff *xcoff)
 	return xcoff_load(fd, buff, st.st_size, xcoff);
 }
 
+/**
+ * @brief Deallocate the loader tables (import IDs, symbol and relocation
+ * tables) read for @p xcoff, without touching its buffer.
+ *
+ * This is useful for XCOFFs loaded from archive members, whose buffer
+ * belongs to the archive.
+ *
+ * @param xcoff XCOFF structure pointer.
+ */
+void xcoff_free_ldr(struct xcoff *xcoff)
+{
+	u32 i;
+
+	if (!xcoff)
+		return;
+
+	if (xcoff->ldr.symtbl) {
+		for (i = 0; i < xcoff->ldr.hdr.l_nsyms; i++)
+			free((char *)xcoff->ldr.symtbl[i].u.l_strtblname);
+	}
+
+	free(xcoff->ldr.symtbl);
+	free(xcoff->ldr.reltbl);
+	free(xcoff->ldr.impids);
+	xcoff->ldr.symtbl = NULL;
+	xcoff->ldr.reltbl = NULL;
+	xcoff->ldr.impids = NULL;
+}
+
 /**
  * @brief Deallocate all data saved in @p xcoff
  * @param xcoff XCOFF structure pointer that will be closed/deallocated.
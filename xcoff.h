@@ -38,6 +38,15 @@
 #define XMC_TC0  0xF  /* TOC Anchor                                           */
 #define XMC_SV3264 0x12 /* Supervisor Call for 32 and 64-bit.                 */
 
+/* Symbol table storage classes (n_sclass). */
+#define C_EXT     2    /* External symbol.        */
+#define C_HIDEXT  107  /* Unnamed/static symbol.  */
+#define C_WEAKEXT 111  /* Weak external symbol.   */
+
+/* Csect symbol types (low 3 bits of x_smtyp). */
+#define XTY_SD 1       /* Csect definition.       */
+#define XTY_LD 2       /* Label, within a csect.  */
+
 /**
  * 32-bit file header
  */
@@ -203,6 +212,17 @@ union xcoff_impid {
 #define XCOFF_AHDR_SIZE sizeof(struct xcoff_aux_hdr32)
 #define XCOFF_SHDR_SIZE sizeof(struct xcoff_sec_hdr32)
 
+/*
+ * XCOFF64 header sizes. XCOFF64 files are never loaded, only
+ * summarized (see xcoff_summarize()), so their headers are read
+ * field by field instead of having structures of their own.
+ */
+#define XCOFF64_FHDR_SIZE   24
+#define XCOFF64_AHDR_SIZE  120
+#define XCOFF64_SHDR_SIZE   72
+#define XCOFF64_LHDR_SIZE   56
+#define XCOFF64_LSYM_SIZE   24
+
 
 /**
  * XCOFF32 data
@@ -224,6 +244,113 @@ struct xcoff {
 	} ldr;
 };
 
+/**
+ * 32-bit symbol table entry.
+ */
+struct xcoff_syment32 {
+	union {
+		char n_name[8];  /* Inline name, null-padded.   */
+		struct {
+			u32 zeroes;  /* 0 if the name is on strtab. */
+			u32 offset;  /* String table offset.        */
+		} s;
+	} u;
+	u32 n_value;         /* Symbol value (address).     */
+	s16 n_scnum;         /* Section number, 1-based.    */
+	u16 n_type;
+	u8  n_sclass;        /* Storage class (C_*).        */
+	u8  n_numaux;        /* Amount of auxiliary entries. */
+} __attribute__((packed));
+
+/**
+ * 32-bit csect auxiliary entry: always the last auxiliary entry of a
+ * C_EXT, C_HIDEXT or C_WEAKEXT symbol.
+ */
+struct xcoff_csect_aux32 {
+	u32 x_scnlen;        /* Csect length (or the XTY_SD symbol index) */
+	u32 x_parmhash;
+	u16 x_snhash;
+	u8  x_smtyp;         /* Symbol type (XTY_*) and alignment.        */
+	u8  x_smclas;        /* Storage mapping class (XMC_*).            */
+	u32 x_stab;
+	u16 x_snstab;
+} __attribute__((packed));
+
+#define XCOFF_SYMESZ sizeof(struct xcoff_syment32)
+
+/**
+ * Section, as summarized by xcoff_summarize() (XCOFF32 or XCOFF64).
+ */
+struct xcoff_sec_summary {
+	char name[8];  /* Not null terminated if 8 chars long. */
+	u64 vaddr;
+	u64 size;
+	u64 scnptr;
+	u32 nreloc;
+	u32 flags;
+};
+
+/**
+ * XCOFF summary, see xcoff_summarize().
+ *
+ * The fields up to 'impids_len' are valid for both XCOFF32 and XCOFF64,
+ * the raw headers that follow for XCOFF32 only.
+ */
+struct xcoff_summary {
+	u16 magic;
+	u16 nscns;
+	u16 flags;
+	int is64;
+	int has_aux;
+	u64 tsize;                       /* Auxiliary header, if has_aux.    */
+	u64 dsize;
+	u64 bsize;
+	u64 toc;
+	u64 entry;                       /* Entry point, 0 if none.          */
+	struct xcoff_sec_summary sections[16]; /* Section headers read.      */
+	u32 nsecs;
+	u32 nrelocs;                     /* Section relocation entries.      */
+	int has_ldr;
+	u32 ldr_nreloc;                  /* Loader header, if has_ldr.       */
+	u32 nimpid;
+	u32 nimports;                    /* Imported symbols.                */
+	u32 nexports;                    /* Exported symbols.                */
+	const char *impids;              /* Import IDs string table, or NULL */
+	u32 impids_len;
+
+	/* XCOFF32 only. */
+	struct xcoff_aux_hdr32 aux;      /* Auxiliary header, if has_aux.    */
+	struct xcoff_sec_hdr32 secs[16]; /* Section headers read.            */
+	struct xcoff_ldr_hdr32 ldr;      /* Loader header, if has_ldr.       */
+};
+
+/**
+ * @brief Callback for xcoff_iterate_exports().
+ *
+ * @param name    Symbol name (not null terminated).
+ * @param len     Symbol name length.
+ * @param smclass Symbol storage class (XMC_*).
+ * @param data    User defined pointer.
+ *
+ * @return Returns a negative number to abort the iteration.
+ */
+typedef int (*xcoff_export_fn)(const char *name, size_t len, u8 smclass,
+	void *data);
+
+/**
+ * @brief Callback for xcoff_iterate_functions().
+ *
+ * @param name  Symbol name (not null terminated), usually with the
+ *              leading '.' of entry points.
+ * @param len   Symbol name length.
+ * @param value Symbol address (not relocated).
+ * @param data  User defined pointer.
+ *
+ * @return Returns a negative number to abort the iteration.
+ */
+typedef int (*xcoff_func_fn)(const char *name, size_t len, u32 value,
+	void *data);
+
 /* External functions. */
 extern int  xcoff_read_filehdr(struct xcoff *xcoff);
 extern void xcoff_print_filehdr(const struct xcoff *xcoff);
@@ -239,5 +366,12 @@ extern u32  xcoff_get_entrypoint(const struct xcoff *xcoff);
 extern int xcoff_load(int fd, const char *buff, size_t size, struct xcoff *xcoff);
 extern int  xcoff_open(const char *bin, struct xcoff *xcoff);
 extern void xcoff_close(const struct xcoff *xcoff);
+extern void xcoff_free_ldr(struct xcoff *xcoff);
+extern int  xcoff_summarize(const char *buff, size_t size,
+	struct xcoff_summary *s);
+extern int  xcoff_iterate_exports(const char *buff, size_t size,
+	xcoff_export_fn fn, void *data);
+extern int  xcoff_iterate_functions(const char *buff, size_t size,
+	xcoff_func_fn fn, void *data);
 
 #endif /* AIX_COFF_H */